@@ -22,6 +22,8 @@ public:
     void setNodeUpdateEnabled(const std::string& name, bool enabled);
     void updateDatasets();
     void initializeDatasets();
+    // call on memory warnings; frees data that is recreated when needed
+    void releaseMemory();
     void initializeSliderCalculator();
     
     void setRedrawRequired();
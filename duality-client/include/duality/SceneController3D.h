@@ -18,6 +18,8 @@ public:
     void setNodeUpdateEnabled(const std::string& name, bool enabled);
     void updateDatasets();
     void initializeDatasets();
+    // call on memory warnings; frees data that is recreated when needed
+    void releaseMemory();
     
     void setRedrawRequired();
     void render();
@@ -34,4 +34,21 @@ public:
         return false;
     }
     virtual void setUseSliceIndices(bool use) {}
+
+    // maximum on-screen deviation of simplified 2D contours, 0 disables simplification
+    virtual float lineSimplificationPixels() const {
+        return 0.5f;
+    }
+    virtual void setLineSimplificationPixels(float pixels) {}
+
+    // volumes are drawn with fewer slices when they are small on screen or the frame rate drops below the target while interacting
+    virtual bool adaptiveSampling() const {
+        return true;
+    }
+    virtual void setAdaptiveSampling(bool enabled) {}
+
+    virtual float targetFrameRate() const {
+        return 30.0f;
+    }
+    virtual void setTargetFrameRate(float fps) {}
 };
\ No newline at end of file
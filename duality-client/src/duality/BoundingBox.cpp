@@ -7,3 +7,16 @@ bool operator==(const BoundingBox& lhs, const BoundingBox& rhs) {
 bool operator!=(const BoundingBox& lhs, const BoundingBox& rhs) {
     return !(lhs == rhs);
 }
+
+BoundingBox duality::transformBoundingBox(const BoundingBox& box, const IVDA::Mat4f& matrix) {
+    IVDA::Vec3f vMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    IVDA::Vec3f vMax(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; ++corner) {
+        IVDA::Vec4f pos((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z,
+                        1.0f);
+        pos = matrix * pos;
+        vMin.StoreMin(pos.xyz());
+        vMax.StoreMax(pos.xyz());
+    }
+    return BoundingBox{vMin, vMax};
+}
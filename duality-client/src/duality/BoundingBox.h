@@ -13,6 +13,8 @@ bool operator==(const BoundingBox& lhs, const BoundingBox& rhs);
 bool operator!=(const BoundingBox& lhs, const BoundingBox& rhs);
 
 namespace duality {
+BoundingBox transformBoundingBox(const BoundingBox& box, const IVDA::Mat4f& matrix);
+
 namespace impl {
 template <typename T> BoundingBox boundingBoxImpl(T obj, std::true_type) {
     return obj->boundingBox();
@@ -0,0 +1,238 @@
+#include "src/duality/Contour.h"
+
+#include "IVDA/Vectors.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+using namespace IVDA;
+
+namespace {
+struct PositionKey {
+    uint32_t bits[3];
+
+    bool operator==(const PositionKey& other) const {
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+    }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& key) const {
+        size_t hash = key.bits[0];
+        hash = hash * 0x9E3779B1u ^ key.bits[1];
+        hash = hash * 0x9E3779B1u ^ key.bits[2];
+        return hash;
+    }
+};
+
+float squaredDistanceToSegment(const Vec3f& p, const Vec3f& a, const Vec3f& b) {
+    const Vec3f ab = b - a;
+    const float sqLength = ab.sqLength();
+    const float t = sqLength > 0.0f ? std::max(0.0f, std::min(1.0f, ((p - a) ^ ab) / sqLength)) : 0.0f;
+    return (a + ab * t - p).sqLength();
+}
+}
+
+Contour::Contour(const G3D::GeometrySoA& segments) {
+    std::vector<uint32_t> weldedIndices;
+    weld(segments, weldedIndices);
+    stitch(weldedIndices);
+}
+
+void Contour::weld(const G3D::GeometrySoA& segments, std::vector<uint32_t>& weldedIndices) {
+    const uint32_t numVertices = segments.info.numberVertices;
+    std::vector<uint32_t> remap(numVertices);
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> points;
+    points.reserve(numVertices / 2);
+    for (uint32_t v = 0; v < numVertices; ++v) {
+        PositionKey key;
+        for (int i = 0; i < 3; ++i) {
+            const float coordinate = segments.positions[3 * v + i] + 0.0f; // turns -0 into +0
+            std::memcpy(&key.bits[i], &coordinate, sizeof(float));
+        }
+        auto inserted = points.emplace(key, static_cast<uint32_t>(m_positions.size() / 3));
+        if (inserted.second) {
+            m_positions.insert(end(m_positions), segments.positions + 3 * v, segments.positions + 3 * v + 3);
+            m_colors.insert(end(m_colors), segments.colors + 4 * v, segments.colors + 4 * v + 4);
+        }
+        remap[v] = inserted.first->second;
+    }
+
+    for (uint32_t i = 0; i + 1 < segments.info.numberIndices; i += 2) {
+        const uint32_t a = remap[segments.indices[i]];
+        const uint32_t b = remap[segments.indices[i + 1]];
+        if (a != b) {
+            weldedIndices.push_back(a);
+            weldedIndices.push_back(b);
+        }
+    }
+}
+
+void Contour::stitch(const std::vector<uint32_t>& weldedIndices) {
+    // segments are undirected; duplicates come from the outlines of triangles that lie in the plane
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for (size_t i = 0; i < weldedIndices.size(); i += 2) {
+        edges.emplace_back(std::min(weldedIndices[i], weldedIndices[i + 1]), std::max(weldedIndices[i], weldedIndices[i + 1]));
+    }
+    std::sort(begin(edges), end(edges));
+    edges.erase(std::unique(begin(edges), end(edges)), end(edges));
+
+    // incident edges per point
+    const size_t pointCount = numPoints();
+    std::vector<uint32_t> offsets(pointCount + 1, 0);
+    for (const auto& edge : edges) {
+        ++offsets[edge.first + 1];
+        ++offsets[edge.second + 1];
+    }
+    for (size_t p = 0; p < pointCount; ++p) {
+        offsets[p + 1] += offsets[p];
+    }
+    std::vector<uint32_t> incident(2 * edges.size());
+    std::vector<uint32_t> fill(begin(offsets), end(offsets) - 1);
+    for (uint32_t e = 0; e < edges.size(); ++e) {
+        incident[fill[edges[e].first]++] = e;
+        incident[fill[edges[e].second]++] = e;
+    }
+    auto degree = [&](uint32_t p) { return offsets[p + 1] - offsets[p]; };
+
+    std::vector<bool> used(edges.size(), false);
+    auto unusedEdge = [&](uint32_t p) {
+        for (uint32_t i = offsets[p]; i < offsets[p + 1]; ++i) {
+            if (!used[incident[i]]) {
+                return static_cast<int64_t>(incident[i]);
+            }
+        }
+        return static_cast<int64_t>(-1);
+    };
+    // follows the chain through points of degree two, starting with the given edge
+    auto walk = [&](uint32_t start, uint32_t firstEdge) {
+        Polyline polyline{{start}, false};
+        uint32_t current = start;
+        int64_t edge = firstEdge;
+        while (edge >= 0) {
+            used[edge] = true;
+            current = edges[edge].first == current ? edges[edge].second : edges[edge].first;
+            polyline.points.push_back(current);
+            if (degree(current) != 2) {
+                break;
+            }
+            edge = unusedEdge(current);
+        }
+        if (polyline.points.size() > 2 && polyline.points.back() == start) {
+            polyline.points.pop_back();
+            polyline.closed = true;
+        }
+        m_polylines.push_back(std::move(polyline));
+    };
+
+    // open chains start at end points and junctions, whatever remains afterwards are loops
+    for (uint32_t p = 0; p < pointCount; ++p) {
+        if (degree(p) != 2) {
+            for (int64_t edge = unusedEdge(p); edge >= 0; edge = unusedEdge(p)) {
+                walk(p, static_cast<uint32_t>(edge));
+            }
+        }
+    }
+    for (uint32_t e = 0; e < edges.size(); ++e) {
+        if (!used[e]) {
+            walk(edges[e].first, e);
+        }
+    }
+}
+
+std::vector<uint32_t> Contour::simplify(const Polyline& polyline, float tolerance) const {
+    std::vector<uint32_t> points = polyline.points;
+    if (polyline.closed) {
+        points.push_back(points.front());
+    }
+    const float sqTolerance = tolerance * tolerance;
+    auto position = [&](size_t i) { return Vec3f(m_positions.data() + 3 * points[i]); };
+
+    std::vector<bool> keep(points.size(), false);
+    keep.front() = true;
+    keep.back() = true;
+    std::vector<std::pair<size_t, size_t>> stack{{0, points.size() - 1}};
+    while (!stack.empty()) {
+        const auto range = stack.back();
+        stack.pop_back();
+        float maxSqDistance = 0.0f;
+        size_t farthest = range.first;
+        for (size_t i = range.first + 1; i < range.second; ++i) {
+            const float sqDistance = squaredDistanceToSegment(position(i), position(range.first), position(range.second));
+            if (sqDistance > maxSqDistance) {
+                maxSqDistance = sqDistance;
+                farthest = i;
+            }
+        }
+        if (maxSqDistance > sqTolerance) {
+            keep[farthest] = true;
+            stack.emplace_back(range.first, farthest);
+            stack.emplace_back(farthest, range.second);
+        }
+    }
+
+    std::vector<uint32_t> result;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (keep[i]) {
+            result.push_back(points[i]);
+        }
+    }
+    if (polyline.closed) {
+        result.pop_back();
+        // a loop that collapses to a line is smaller than the tolerance
+        if (result.size() < 3) {
+            result.clear();
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<const G3D::GeometrySoA> Contour::lines(float tolerance) const {
+    const int level = tolerance > 0.0f ? static_cast<int>(std::floor(std::log2(tolerance))) : INT_MIN;
+    std::lock_guard<std::mutex> lock(m_levelMutex);
+    auto it = m_levels.find(level);
+    if (it == m_levels.end()) {
+        it = m_levels.emplace(level, createLines(level == INT_MIN ? 0.0f : std::ldexp(1.0f, level))).first;
+    }
+    return it->second;
+}
+
+std::shared_ptr<const G3D::GeometrySoA> Contour::createLines(float tolerance) const {
+    std::vector<uint32_t> remap(numPoints(), UINT32_MAX);
+    std::vector<uint32_t> indices;
+    std::vector<float> positions;
+    std::vector<float> colors;
+    auto vertex = [&](uint32_t p) {
+        if (remap[p] == UINT32_MAX) {
+            remap[p] = static_cast<uint32_t>(positions.size() / 3);
+            positions.insert(end(positions), m_positions.begin() + 3 * p, m_positions.begin() + 3 * p + 3);
+            colors.insert(end(colors), m_colors.begin() + 4 * p, m_colors.begin() + 4 * p + 4);
+        }
+        return remap[p];
+    };
+
+    for (const auto& polyline : m_polylines) {
+        const std::vector<uint32_t> points = tolerance > 0.0f ? simplify(polyline, tolerance) : polyline.points;
+        if (points.size() < 2) {
+            continue;
+        }
+        const size_t numSegments = polyline.closed ? points.size() : points.size() - 1;
+        for (size_t i = 0; i < numSegments; ++i) {
+            indices.push_back(vertex(points[i]));
+            indices.push_back(vertex(points[(i + 1) % points.size()]));
+        }
+    }
+    return G3D::createLineGeometry(std::move(indices), std::move(positions), std::move(colors));
+}
+
+size_t Contour::numPoints() const {
+    return m_positions.size() / 3;
+}
+
+size_t Contour::numPolylines() const {
+    return m_polylines.size();
+}
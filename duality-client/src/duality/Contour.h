@@ -0,0 +1,40 @@
+#pragma once
+
+#include "src/duality/G3D.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// clipped line segments welded at shared end points and stitched into polylines and loops
+class Contour {
+public:
+    // the end points of segments that share an end point have to be bitwise identical, as produced by GeometryUtil::clipGeometry
+    explicit Contour(const G3D::GeometrySoA& segments);
+
+    // lines that deviate at most tolerance from the polylines (Douglas-Peucker); results are cached per power of two of the
+    // tolerance, a tolerance <= 0 returns the unsimplified polylines
+    std::shared_ptr<const G3D::GeometrySoA> lines(float tolerance) const;
+
+    size_t numPoints() const;
+    size_t numPolylines() const;
+
+private:
+    struct Polyline {
+        std::vector<uint32_t> points;
+        bool closed;
+    };
+
+    void weld(const G3D::GeometrySoA& segments, std::vector<uint32_t>& weldedIndices);
+    void stitch(const std::vector<uint32_t>& weldedIndices);
+    std::vector<uint32_t> simplify(const Polyline& polyline, float tolerance) const;
+    std::shared_ptr<const G3D::GeometrySoA> createLines(float tolerance) const;
+
+private:
+    std::vector<float> m_positions;
+    std::vector<float> m_colors;
+    std::vector<Polyline> m_polylines;
+    mutable std::mutex m_levelMutex;
+    mutable std::map<int, std::shared_ptr<const G3D::GeometrySoA>> m_levels;
+};
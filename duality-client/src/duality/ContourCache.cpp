@@ -0,0 +1,88 @@
+#include "src/duality/ContourCache.h"
+
+#include "src/duality/GeometryDataset.h"
+#include "src/duality/GeometryUtil.h"
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+
+ContourCache::ContourCache(size_t capacity)
+    : m_state(std::make_shared<State>()) {
+    m_state->capacity = capacity;
+}
+
+ContourCache::SharedContour ContourCache::contour(const GeometryDataset& dataset, const IVDA::Mat4f& modelMatrix, CoordinateAxis axis,
+                                                  float depth) {
+    Key key{dataset.generation(), modelMatrix, axis, depth};
+    std::shared_future<SharedContour> contour;
+    std::promise<SharedContour> promise;
+    if (!lookupOrInsert(*m_state, key, contour, promise)) {
+        try {
+            promise.set_value(std::make_shared<Contour>(*GeometryUtil::clipGeometry(dataset, modelMatrix, axis, depth)));
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            m_state->entries.remove_if([&](const Entry& entry) { return matches(entry.key, key); });
+        }
+    }
+    return contour.get();
+}
+
+void ContourCache::prefetch(const GeometryDataset& dataset, const IVDA::Mat4f& modelMatrix, CoordinateAxis axis,
+                            const std::vector<float>& depths) {
+    auto geometry = dataset.sharedGeometry();
+    for (float depth : depths) {
+        CoordinateAxis modelAxis;
+        float modelPosition;
+        if (!GeometryUtil::modelSpaceAxisPlane(modelMatrix, axis, depth, modelAxis, modelPosition)) {
+            return;
+        }
+        Key key{dataset.generation(), modelMatrix, axis, depth};
+        std::shared_future<SharedContour> contour;
+        auto promise = std::make_shared<std::promise<SharedContour>>();
+        if (lookupOrInsert(*m_state, key, contour, *promise)) {
+            continue;
+        }
+        // the task works on the current geometry and slice index, which stay alive and unchanged even if the dataset is updated; all
+        // triangles are clipped if the index is still being built
+        auto sliceIndex = dataset.sharedSliceIndex(modelAxis);
+        ThreadPool::instance().submit([geometry, sliceIndex, modelAxis, modelPosition, promise] {
+            try {
+                auto lines = sliceIndex ? GeometryUtil::clipGeometry(*geometry, *sliceIndex, modelAxis, modelPosition)
+                                        : GeometryUtil::clipGeometry(*geometry, modelAxis, modelPosition);
+                promise->set_value(std::make_shared<Contour>(*lines));
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+    }
+}
+
+void ContourCache::clear() {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->entries.clear();
+}
+
+bool ContourCache::matches(const Key& lhs, const Key& rhs) {
+    return lhs.generation == rhs.generation && lhs.axis == rhs.axis && lhs.depth == rhs.depth &&
+           std::equal(lhs.modelMatrix.array, lhs.modelMatrix.array + 16, rhs.modelMatrix.array);
+}
+
+bool ContourCache::lookupOrInsert(State& state, const Key& key, std::shared_future<SharedContour>& contour,
+                                  std::promise<SharedContour>& promise) {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (auto it = begin(state.entries); it != end(state.entries); ++it) {
+        if (matches(it->key, key)) {
+            state.entries.splice(begin(state.entries), state.entries, it);
+            contour = state.entries.front().contour;
+            return true;
+        }
+    }
+    contour = promise.get_future().share();
+    state.entries.push_front(Entry{key, contour});
+    while (state.entries.size() > state.capacity) {
+        state.entries.pop_back();
+    }
+    return false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "duality/CoordinateSystem.h"
+#include "src/duality/Contour.h"
+
+#include "IVDA/Vectors.h"
+
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class GeometryDataset;
+
+// least recently used cache of the contours that result from clipping a geometry instance against a slice plane
+class ContourCache {
+public:
+    using SharedContour = std::shared_ptr<const Contour>;
+
+    explicit ContourCache(size_t capacity = 64);
+
+    SharedContour contour(const GeometryDataset& dataset, const IVDA::Mat4f& modelMatrix, CoordinateAxis axis, float depth);
+    // clips the given depths on the thread pool unless they are cached already; only axis aligned instances are prefetched
+    void prefetch(const GeometryDataset& dataset, const IVDA::Mat4f& modelMatrix, CoordinateAxis axis, const std::vector<float>& depths);
+    void clear();
+
+private:
+    struct Key {
+        uint64_t generation;
+        IVDA::Mat4f modelMatrix;
+        CoordinateAxis axis;
+        float depth;
+    };
+    struct Entry {
+        Key key;
+        std::shared_future<SharedContour> contour;
+    };
+    // shared with background tasks, which may outlive the cache
+    struct State {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        size_t capacity;
+    };
+
+    static bool matches(const Key& lhs, const Key& rhs);
+    // returns the pending or finished contour if the key is cached, otherwise inserts promise's future for it
+    static bool lookupOrInsert(State& state, const Key& key, std::shared_future<SharedContour>& contour,
+                               std::promise<SharedContour>& promise);
+
+private:
+    std::shared_ptr<State> m_state;
+};
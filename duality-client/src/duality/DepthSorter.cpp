@@ -0,0 +1,141 @@
+#include "src/duality/DepthSorter.h"
+
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+using namespace IVDA;
+
+namespace {
+const size_t radixBits = 8;
+const size_t radixSize = 1 << radixBits;
+const size_t keysPerTask = 64 * 1024;
+const size_t minKeysPerBlock = 16 * 1024;
+}
+
+const std::vector<uint32_t>& DepthSorter::backToFront(const std::vector<Vec3f>& points, const Vec3f& refPoint) {
+    const size_t numPoints = points.size();
+    const bool coherent = m_order.size() == numPoints;
+    if (!coherent) {
+        m_order.resize(numPoints);
+        std::iota(begin(m_order), end(m_order), 0);
+    }
+    computeKeys(points, refPoint);
+    // the previous order is a good guess unless the view jumped
+    if (!coherent || !refine(numPoints / 4)) {
+        radixSort();
+    }
+    return m_order;
+}
+
+void DepthSorter::setInitialOrder(const std::vector<uint32_t>& order) {
+    m_order = order;
+}
+
+void DepthSorter::computeKeys(const std::vector<Vec3f>& points, const Vec3f& refPoint) {
+    static_assert(sizeof(Vec3f) == 3 * sizeof(float), "points are read as packed floats");
+    const size_t numPoints = points.size();
+    m_pointKeys.resize(numPoints);
+    m_keys.resize(numPoints);
+    const float* coordinates = numPoints ? &points[0].x : nullptr;
+    uint32_t* pointKeys = m_pointKeys.data();
+    ThreadPool::instance().parallelFor(0, numPoints, keysPerTask, [&](size_t begin, size_t end) {
+        // branch free so that the loop is vectorized; squared distances are non-negative, so their bit patterns order like the
+        // floats, and inverting them orders back to front
+        for (size_t i = begin; i < end; ++i) {
+            const float dx = coordinates[3 * i] - refPoint.x;
+            const float dy = coordinates[3 * i + 1] - refPoint.y;
+            const float dz = coordinates[3 * i + 2] - refPoint.z;
+            const float sqDistance = dx * dx + dy * dy + dz * dz;
+            uint32_t bits;
+            std::memcpy(&bits, &sqDistance, sizeof(bits));
+            pointKeys[i] = ~bits;
+        }
+    });
+    ThreadPool::instance().parallelFor(0, numPoints, keysPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            m_keys[i] = pointKeys[m_order[i]];
+        }
+    });
+}
+
+bool DepthSorter::refine(size_t maxMoves) {
+    size_t moves = 0;
+    for (size_t i = 1; i < m_keys.size(); ++i) {
+        const uint32_t key = m_keys[i];
+        const uint32_t index = m_order[i];
+        size_t j = i;
+        while (j > 0 && m_keys[j - 1] > key) {
+            m_keys[j] = m_keys[j - 1];
+            m_order[j] = m_order[j - 1];
+            --j;
+            if (++moves > maxMoves) {
+                // keys and order stay a consistent permutation for the radix sort
+                m_keys[j] = key;
+                m_order[j] = index;
+                return false;
+            }
+        }
+        m_keys[j] = key;
+        m_order[j] = index;
+    }
+    return true;
+}
+
+void DepthSorter::radixSort() {
+    const size_t numKeys = m_keys.size();
+    const size_t numBlocks = std::max<size_t>(1, std::min(4 * ThreadPool::instance().numThreads(), numKeys / minKeysPerBlock));
+    const size_t blockSize = (numKeys + numBlocks - 1) / numBlocks;
+    m_keysScratch.resize(numKeys);
+    m_orderScratch.resize(numKeys);
+    m_histograms.resize(numBlocks * radixSize);
+
+    for (size_t shift = 0; shift < 32; shift += radixBits) {
+        std::fill(begin(m_histograms), end(m_histograms), 0);
+        ThreadPool::instance().parallelFor(0, numBlocks, 1, [&](size_t firstBlock, size_t endBlock) {
+            for (size_t block = firstBlock; block < endBlock; ++block) {
+                size_t* histogram = &m_histograms[block * radixSize];
+                const size_t end = std::min(numKeys, (block + 1) * blockSize);
+                for (size_t i = block * blockSize; i < end; ++i) {
+                    ++histogram[(m_keys[i] >> shift) & (radixSize - 1)];
+                }
+            }
+        });
+
+        // exclusive prefix sum in digit major order keeps the sort stable; passes in which all keys share a digit are skipped,
+        // which is common for the exponent bits
+        size_t offset = 0;
+        bool trivialPass = false;
+        for (size_t digit = 0; digit < radixSize; ++digit) {
+            const size_t digitBegin = offset;
+            for (size_t block = 0; block < numBlocks; ++block) {
+                const size_t count = m_histograms[block * radixSize + digit];
+                m_histograms[block * radixSize + digit] = offset;
+                offset += count;
+            }
+            if (offset - digitBegin == numKeys) {
+                trivialPass = true;
+                break;
+            }
+        }
+        if (trivialPass) {
+            continue;
+        }
+
+        ThreadPool::instance().parallelFor(0, numBlocks, 1, [&](size_t firstBlock, size_t endBlock) {
+            for (size_t block = firstBlock; block < endBlock; ++block) {
+                size_t* offsets = &m_histograms[block * radixSize];
+                const size_t end = std::min(numKeys, (block + 1) * blockSize);
+                for (size_t i = block * blockSize; i < end; ++i) {
+                    const size_t target = offsets[(m_keys[i] >> shift) & (radixSize - 1)]++;
+                    m_keysScratch[target] = m_keys[i];
+                    m_orderScratch[target] = m_order[i];
+                }
+            }
+        });
+        m_keys.swap(m_keysScratch);
+        m_order.swap(m_orderScratch);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "IVDA/Vectors.h"
+
+#include <cstdint>
+#include <vector>
+
+// orders points by decreasing distance to a reference point; buffers and the resulting order are kept for the next call, whose input
+// is usually almost sorted already when the view changes continuously
+class DepthSorter {
+public:
+    // indices into points, back to front as seen from refPoint; the reference stays valid until the next call
+    const std::vector<uint32_t>& backToFront(const std::vector<IVDA::Vec3f>& points, const IVDA::Vec3f& refPoint);
+    // the next call to backToFront starts from this order instead of its previous result
+    void setInitialOrder(const std::vector<uint32_t>& order);
+
+private:
+    void computeKeys(const std::vector<IVDA::Vec3f>& points, const IVDA::Vec3f& refPoint);
+    // insertion sort of the previous order, gives up after maxMoves element moves
+    bool refine(size_t maxMoves);
+    // parallel LSD radix sort, 8 bits per pass
+    void radixSort();
+
+private:
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_keys;
+    std::vector<uint32_t> m_pointKeys;
+    std::vector<uint32_t> m_orderScratch;
+    std::vector<uint32_t> m_keysScratch;
+    std::vector<size_t> m_histograms;
+};
@@ -0,0 +1,49 @@
+#include "src/duality/FrameRateController.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const float maxFrameTime = 0.5f;
+// weight of a new frame time in the moving average
+const float smoothing = 0.25f;
+// frame rates within this fraction of the target are left alone, which keeps the quality from oscillating
+const float tolerance = 0.1f;
+// the quality drops faster than it rises
+const float maxDecrease = 0.8f;
+const float maxIncrease = 1.1f;
+}
+
+FrameRateController::FrameRateController(float minQuality)
+    : m_minQuality(minQuality)
+    , m_quality(1.0f)
+    , m_averageFrameTime(0.0f)
+    , m_hasLastFrame(false) {}
+
+void FrameRateController::frameRendered(float targetFrameRate) {
+    const auto now = std::chrono::steady_clock::now();
+    const float frameTime = std::chrono::duration<float>(now - m_lastFrame).count();
+    const bool counted = m_hasLastFrame && frameTime < maxFrameTime;
+    m_lastFrame = now;
+    m_hasLastFrame = true;
+    if (!counted || targetFrameRate <= 0.0f) {
+        return;
+    }
+
+    m_averageFrameTime = m_averageFrameTime > 0.0f ? (1.0f - smoothing) * m_averageFrameTime + smoothing * frameTime : frameTime;
+    // the work per frame is roughly proportional to the quality
+    const float ratio = 1.0f / (targetFrameRate * m_averageFrameTime);
+    if (std::abs(ratio - 1.0f) > tolerance) {
+        m_quality *= std::max(maxDecrease, std::min(maxIncrease, ratio));
+        m_quality = std::max(m_minQuality, std::min(1.0f, m_quality));
+    }
+}
+
+void FrameRateController::reset() {
+    m_hasLastFrame = false;
+    m_averageFrameTime = 0.0f;
+}
+
+float FrameRateController::quality() const {
+    return m_quality;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+
+// adapts a quality factor in [minQuality, 1] so that the frame rate converges on a target; the factor scales the amount of work per
+// frame, e.g. the number of volume slices
+class FrameRateController {
+public:
+    explicit FrameRateController(float minQuality);
+
+    // to be called for every rendered frame with the current target; pauses between frames that are much longer than a frame, e.g.
+    // when nothing has to be redrawn, are not counted as frame times
+    void frameRendered(float targetFrameRate);
+    void reset();
+    float quality() const;
+
+private:
+    float m_minQuality;
+    float m_quality;
+    float m_averageFrameTime;
+    bool m_hasLastFrame;
+    std::chrono::steady_clock::time_point m_lastFrame;
+};
@@ -2,7 +2,9 @@
 
 #include "duality/Error.h"
 #include "src/duality/AbstractIO.h"
+#include "src/duality/ThreadPool.h"
 
+#include <cmath>
 #include <string>
 
 std::unique_ptr<G3D::GeometrySoA> G3D::createLineGeometry(std::vector<uint32_t> indices, std::vector<float> positions,
@@ -278,44 +280,69 @@ void G3D::assignShortcutPointers(G3D::GeometrySoA& geometry) {
 }
 
 void G3D::applyTransform(G3D::GeometrySoA& geometry, const IVDA::Mat4f& matrix) {
-    uint32_t numVertices = geometry.info.numberVertices;
-    {
-        if (geometry.positions != nullptr) {
-            float* positions = const_cast<float*>(geometry.positions);
-            for (uint32_t i = 0; i < numVertices; ++i, positions += 3) {
-                IVDA::Vec4f position(IVDA::Vec3f(positions), 1);
-                position = matrix * position;
-                positions[0] = position.x;
-                positions[1] = position.y;
-                positions[2] = position.z;
-            }
-        }
+    applyTransforms(geometry, {matrix});
+}
+
+namespace {
+// affine transform of an interleaved xyz stream; w is 1 for points and 0 for directions. The loop body is free of branches and
+// function calls so that the compiler can vectorize it.
+void transformStream(float* data, size_t begin, size_t end, const IVDA::Mat4f& m, float w, bool renormalize) {
+    const float m11 = m.m11, m12 = m.m12, m13 = m.m13, t1 = m.m14 * w;
+    const float m21 = m.m21, m22 = m.m22, m23 = m.m23, t2 = m.m24 * w;
+    const float m31 = m.m31, m32 = m.m32, m33 = m.m33, t3 = m.m34 * w;
+    float* __restrict v = data + 3 * begin;
+    const size_t count = end - begin;
+    for (size_t i = 0; i < count; ++i, v += 3) {
+        const float x = v[0], y = v[1], z = v[2];
+        v[0] = m11 * x + m12 * y + m13 * z + t1;
+        v[1] = m21 * x + m22 * y + m23 * z + t2;
+        v[2] = m31 * x + m32 * y + m33 * z + t3;
     }
-    {
-        if (geometry.normals != nullptr) {
-            float* normals = const_cast<float*>(geometry.normals);
-            IVDA::Mat4f normalMatrix = matrix.inverse().Transpose();
-            for (uint32_t i = 0; i < numVertices; ++i, normals += 3) {
-                IVDA::Vec4f normal(IVDA::Vec3f(normals), 0);
-                normal = normalMatrix * normal;
-                normals[0] = normal.x;
-                normals[1] = normal.y;
-                normals[2] = normal.z;
-            }
+    if (renormalize) {
+        v = data + 3 * begin;
+        for (size_t i = 0; i < count; ++i, v += 3) {
+            const float sqLength = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+            const float scale = sqLength > 0.0f ? 1.0f / std::sqrt(sqLength) : 1.0f;
+            v[0] *= scale;
+            v[1] *= scale;
+            v[2] *= scale;
         }
     }
-    {
-        if (geometry.tangents != nullptr) {
-            float* tangents = const_cast<float*>(geometry.tangents);
-            for (uint32_t i = 0; i < numVertices; ++i, tangents += 3) {
-                IVDA::Vec4f tangent(IVDA::Vec3f(tangents), 0);
-                tangent = matrix * tangent;
-                tangents[0] = tangent.x;
-                tangents[1] = tangent.y;
-                tangents[2] = tangent.z;
-            }
+}
+}
+
+void G3D::applyTransforms(G3D::GeometrySoA& geometry, const std::vector<IVDA::Mat4f>& transforms, bool renormalize) {
+    if (transforms.empty()) {
+        return;
+    }
+    const IVDA::Mat4f matrix = collapseTransforms(transforms);
+    const IVDA::Mat4f normalMatrix = matrix.inverse().Transpose();
+    float* positions = geometry.positions;
+    float* normals = geometry.normals;
+    float* tangents = geometry.tangents;
+
+    // all streams of a vertex range are transformed by the same task while the range is hot in the cache
+    const size_t grainSize = 1 << 14;
+    ThreadPool::instance().parallelFor(0, geometry.info.numberVertices, grainSize, [&](size_t begin, size_t end) {
+        if (positions != nullptr) {
+            transformStream(positions, begin, end, matrix, 1.0f, false);
+        }
+        if (normals != nullptr) {
+            transformStream(normals, begin, end, normalMatrix, 0.0f, renormalize);
         }
+        if (tangents != nullptr) {
+            transformStream(tangents, begin, end, matrix, 0.0f, renormalize);
+        }
+    });
+}
+
+IVDA::Mat4f G3D::collapseTransforms(const std::vector<IVDA::Mat4f>& transforms) {
+    // applyTransform multiplies column vectors, so every following transform is multiplied from the left
+    IVDA::Mat4f result;
+    for (const auto& transform : transforms) {
+        result = transform * result;
     }
+    return result;
 }
 
 void G3D::overrideColor(G3D::GeometrySoA& geometry, const Color& color) {
@@ -107,6 +107,9 @@ public:
     static std::unique_ptr<GeometrySoA> createLineGeometry(std::vector<uint32_t> indices, std::vector<float> positions,
                                                            std::vector<float> colors);
     static void applyTransform(G3D::GeometrySoA& geometry, const IVDA::Mat4f& matrix);
+    // collapses the transforms into a single matrix and applies it in one pass over positions, normals and tangents
+    static void applyTransforms(G3D::GeometrySoA& geometry, const std::vector<IVDA::Mat4f>& transforms, bool renormalize = false);
+    static IVDA::Mat4f collapseTransforms(const std::vector<IVDA::Mat4f>& transforms);
     static void overrideColor(G3D::GeometrySoA& geometry, const Color& color);
 
     static void write(AbstractWriter& writer, const GeometryAoS& geometry, uint32_t vertexType = AoS);
@@ -1,42 +1,110 @@
 #include "src/duality/GeometryDataset.h"
 
 #include "src/duality/AbstractIO.h"
+#include "src/duality/ThreadPool.h"
 
 #include "IVDA/Vectors.h"
 #include "duality/Error.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
 
 using namespace IVDA;
 
-GeometryDataset::GeometryDataset(std::unique_ptr<DataProvider> provider, std::vector<Mat4f> transforms, mocca::Nullable<Color> color)
+namespace {
+const uint32_t primitivesPerChunk = 4096;
+std::atomic<uint64_t> nextGeneration(1);
+const size_t primitivesPerBlock = 64 * 256;
+const std::vector<uint32_t> noIndices;
+}
+
+GeometryDataset::GeometryDataset(std::unique_ptr<DataProvider> provider, DirectionalOrders directionalOrders)
     : m_provider(std::move(provider))
     , m_initRequired(true)
-    , m_transforms(std::move(transforms))
-    , m_color(std::move(color))
-    , m_geometry(nullptr) {}
+    , m_geometry(nullptr)
+    , m_directionalOrderSettings(directionalOrders)
+    , m_sortAllPrimitives(false)
+    , m_generation(0) {}
 
-bool GeometryDataset::isTransparent() const {
-    return !m_indicesTransparent.empty();
+void GeometryDataset::requireTransparency(Transparency transparency) {
+    if (transparency == Transparency::Transparent && !m_sortAllPrimitives) {
+        m_sortAllPrimitives = true;
+        m_initRequired = true;
+    }
 }
 
-const std::vector<IVDA::Vec3f>& GeometryDataset::centroids() const {
-    return m_centroids;
+bool GeometryDataset::isTransparent(Transparency transparency) const {
+    return !indicesTransparent(transparency).empty();
+}
+
+const std::vector<IVDA::Vec3f>& GeometryDataset::centroids(Transparency transparency) const {
+    return sortData(transparency).centroids;
+}
+
+const GeometryDataset::SortData& GeometryDataset::sortData(Transparency transparency) const {
+    if (transparency == Transparency::Transparent && !m_sortAllPrimitives) {
+        throw Error("Transparency has not been required for the geometry dataset", __FILE__, __LINE__);
+    }
+    return m_sortData[static_cast<size_t>(transparency)];
+}
+
+const std::vector<uint32_t>& GeometryDataset::backToFrontOrder(const IVDA::Vec3f& refPoint, DepthSorter& sorter,
+                                                                Transparency transparency) const {
+    const SortData& data = sortData(transparency);
+    if (data.directionalOrders.empty()) {
+        return sorter.backToFront(data.centroids, refPoint);
+    }
+
+    Vec3f viewDirection = refPoint - (m_boundingBox.min + m_boundingBox.max) * 0.5f;
+    viewDirection.normalize();
+    size_t nearest = 0;
+    for (size_t i = 1; i < data.orderDirections.size(); ++i) {
+        if ((data.orderDirections[i] ^ viewDirection) > (data.orderDirections[nearest] ^ viewDirection)) {
+            nearest = i;
+        }
+    }
+    const float maxAngle = m_directionalOrderSettings.maxAngle * static_cast<float>(M_PI) / 180.0f;
+    if (!m_directionalOrderSettings.refine && (data.orderDirections[nearest] ^ viewDirection) >= std::cos(maxAngle)) {
+        return data.directionalOrders[nearest];
+    }
+    if (m_directionalOrderSettings.refine) {
+        sorter.setInitialOrder(data.directionalOrders[nearest]);
+    }
+    return sorter.backToFront(data.centroids, refPoint);
 }
 
-const std::vector<uint32_t>& GeometryDataset::indicesOpaque() const {
-    return m_indicesOpaque;
+const std::vector<uint32_t>& GeometryDataset::indicesOpaque(Transparency transparency) const {
+    switch (transparency) {
+    case Transparency::Opaque:
+        return m_geometry->indices;
+    case Transparency::Transparent:
+        return noIndices;
+    default:
+        return m_indicesOpaque;
+    }
 }
 
-const std::vector<uint32_t>& GeometryDataset::indicesTransparent() const {
-    return m_indicesTransparent;
+const std::vector<uint32_t>& GeometryDataset::indicesTransparent(Transparency transparency) const {
+    switch (transparency) {
+    case Transparency::Opaque:
+        return noIndices;
+    case Transparency::Transparent:
+        return m_geometry->indices;
+    default:
+        return m_indicesTransparent;
+    }
 }
 
 void GeometryDataset::updateDataset() {
     auto data = m_provider->fetch();
     if (data != nullptr) {
         ReaderFromMemory reader(reinterpret_cast<const char*>(data->data()), data->size());
-        m_geometry = std::make_unique<G3D::GeometrySoA>();
+        m_geometry = std::make_shared<G3D::GeometrySoA>();
         G3D::readSoA(reader, *m_geometry);
         m_initRequired = true;
     }
@@ -46,68 +114,257 @@ void GeometryDataset::initializeDataset() {
     if (!m_initRequired) {
         return;
     }
-    
-    for (const auto& transform : m_transforms) {
-        G3D::applyTransform(*m_geometry, transform);
+
+    presortIndices();
+    computeBounds();
+    computeCentroids(m_indicesTransparent, m_sortData[static_cast<size_t>(Transparency::VertexColors)]);
+    computeDirectionalOrders(m_sortData[static_cast<size_t>(Transparency::VertexColors)]);
+    if (m_sortAllPrimitives) {
+        computeCentroids(m_geometry->indices, m_sortData[static_cast<size_t>(Transparency::Transparent)]);
+        computeDirectionalOrders(m_sortData[static_cast<size_t>(Transparency::Transparent)]);
     }
-    if (!m_color.isNull()) {
-        G3D::overrideColor(*m_geometry, m_color);
+    m_bvh.build(*m_geometry, static_cast<uint32_t>(duality::indicesPerPrimitive(*this)));
+    {
+        std::lock_guard<std::mutex> lock(m_sliceIndexMutex);
+        // builds that are still running keep the previous geometry alive
+        for (auto& sliceIndex : m_sliceIndices) {
+            sliceIndex = {};
+        }
     }
-    presortIndices();
-    computeCentroids();
+    m_generation = nextGeneration++;
     m_initRequired = false;
 }
 
+void GeometryDataset::computeBounds() {
+    const float* positions = m_geometry->positions;
+    const std::vector<uint32_t>& indices = m_geometry->indices;
+    const uint32_t numIndices = m_geometry->info.numberIndices;
+    const uint32_t indicesPerChunk = primitivesPerChunk * static_cast<uint32_t>(duality::indicesPerPrimitive(*this));
+    m_chunks.resize((numIndices + indicesPerChunk - 1) / indicesPerChunk);
+
+    ThreadPool::instance().parallelFor(0, m_chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t chunkIndex = begin; chunkIndex < end; ++chunkIndex) {
+            Chunk& chunk = m_chunks[chunkIndex];
+            chunk.firstIndex = static_cast<uint32_t>(chunkIndex) * indicesPerChunk;
+            chunk.endIndex = std::min(numIndices, chunk.firstIndex + indicesPerChunk);
+            Vec3f vMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+            Vec3f vMax(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+            for (uint32_t i = chunk.firstIndex; i < chunk.endIndex; ++i) {
+                Vec3f pos(positions + 3 * indices[i]);
+                vMin.StoreMin(pos);
+                vMax.StoreMax(pos);
+            }
+            chunk.bounds = BoundingBox{vMin, vMax};
+        }
+    });
+
+    m_boundingBox = BoundingBox();
+    if (!m_chunks.empty()) {
+        m_boundingBox = m_chunks.front().bounds;
+        for (const auto& chunk : m_chunks) {
+            m_boundingBox.min.StoreMin(chunk.bounds.min);
+            m_boundingBox.max.StoreMax(chunk.bounds.max);
+        }
+    }
+}
+
 void GeometryDataset::presortIndices() {
-    m_indicesOpaque.clear();
-    m_indicesTransparent.clear();
+    // primitives are classified in blocks of whole 64 bit mask words; a prefix sum over the per-block counts gives the offsets into
+    // the compact opaque and transparent index arrays, which are then written by the same blocks in parallel
+    const std::vector<uint32_t>& indices = m_geometry->indices;
+    const size_t ipp = duality::indicesPerPrimitive(*this);
+    const size_t numPrimitives = indices.size() / ipp;
+    const size_t numBlocks = (numPrimitives + primitivesPerBlock - 1) / primitivesPerBlock;
+    auto& pool = ThreadPool::instance();
+
+    const float* colors = m_geometry->colors;
+    m_vertexTransparent.resize(m_geometry->info.numberVertices);
+    pool.parallelFor(0, m_vertexTransparent.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            m_vertexTransparent[i] = colors != nullptr && colors[4 * i + 3] <= duality::maxTransparentAlpha;
+        }
+    });
 
-    if (m_geometry->info.primitiveType == G3D::Point) {
-        presortIndices<1>();
-    } else if (m_geometry->info.primitiveType == G3D::Line) {
-        presortIndices<2>();
-    } else if (m_geometry->info.primitiveType == G3D::Triangle) {
-        presortIndices<3>();
+    m_primitiveTransparent.resize((numPrimitives + 63) / 64);
+    m_blockOffsets.resize(numBlocks + 1);
+    pool.parallelFor(0, numBlocks, 1, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+            const size_t first = block * primitivesPerBlock;
+            const size_t last = std::min(numPrimitives, first + primitivesPerBlock);
+            size_t numTransparent = 0;
+            for (size_t word = first / 64; word * 64 < last; ++word) {
+                uint64_t mask = 0;
+                const size_t wordEnd = std::min(last, (word + 1) * 64);
+                for (size_t primitive = word * 64; primitive < wordEnd; ++primitive) {
+                    uint64_t transparent = 0;
+                    for (size_t j = 0; j < ipp; ++j) {
+                        transparent |= m_vertexTransparent[indices[primitive * ipp + j]];
+                    }
+                    mask |= transparent << (primitive - word * 64);
+                    numTransparent += transparent;
+                }
+                m_primitiveTransparent[word] = mask;
+            }
+            m_blockOffsets[block + 1] = numTransparent;
+        }
+    });
+
+    m_blockOffsets[0] = 0;
+    for (size_t block = 0; block < numBlocks; ++block) {
+        m_blockOffsets[block + 1] += m_blockOffsets[block];
     }
+    const size_t numTransparent = m_blockOffsets[numBlocks];
+    m_indicesTransparent.resize(numTransparent * ipp);
+    m_indicesOpaque.resize((numPrimitives - numTransparent) * ipp);
+
+    pool.parallelFor(0, numBlocks, 1, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+            const size_t first = block * primitivesPerBlock;
+            const size_t last = std::min(numPrimitives, first + primitivesPerBlock);
+            uint32_t* transparentOut = m_indicesTransparent.data() + m_blockOffsets[block] * ipp;
+            uint32_t* opaqueOut = m_indicesOpaque.data() + (first - m_blockOffsets[block]) * ipp;
+            for (size_t primitive = first; primitive < last; ++primitive) {
+                const bool transparent = (m_primitiveTransparent[primitive / 64] >> (primitive % 64)) & 1;
+                uint32_t*& out = transparent ? transparentOut : opaqueOut;
+                for (size_t j = 0; j < ipp; ++j) {
+                    *out++ = indices[primitive * ipp + j];
+                }
+            }
+        }
+    });
 }
 
-void GeometryDataset::computeCentroids() {
-    m_centroids.clear();
-    if (m_geometry->info.primitiveType == G3D::Point) {
-        computeCentroids<1>();
-    } else if (m_geometry->info.primitiveType == G3D::Line) {
-        computeCentroids<2>();
-    } else if (m_geometry->info.primitiveType == G3D::Triangle) {
-        computeCentroids<3>();
+void GeometryDataset::computeCentroids(const std::vector<uint32_t>& indices, SortData& sortData) {
+    const size_t ipp = duality::indicesPerPrimitive(*this);
+    const float* positions = m_geometry->positions;
+    const float weight = 1.0f / static_cast<float>(ipp);
+    std::vector<Vec3f>& centroids = sortData.centroids;
+    centroids.resize(indices.size() / ipp);
+    ThreadPool::instance().parallelFor(0, centroids.size(), primitivesPerBlock, [&](size_t begin, size_t end) {
+        for (size_t primitive = begin; primitive < end; ++primitive) {
+            Vec3f centroid(0.0f, 0.0f, 0.0f);
+            for (size_t j = 0; j < ipp; ++j) {
+                centroid += Vec3f(positions + 3 * indices[primitive * ipp + j]);
+            }
+            centroids[primitive] = centroid * weight;
+        }
+    });
+}
+
+void GeometryDataset::computeDirectionalOrders(SortData& sortData) {
+    std::vector<Vec3f>& orderDirections = sortData.orderDirections;
+    std::vector<std::vector<uint32_t>>& directionalOrders = sortData.directionalOrders;
+    orderDirections.clear();
+    directionalOrders.clear();
+    const size_t numPrimitives = sortData.centroids.size();
+    int resolution = static_cast<int>(m_directionalOrderSettings.resolution);
+    auto numDirections = [](int r) {
+        const int outer = 2 * r + 1;
+        const int inner = 2 * r - 1;
+        return static_cast<size_t>(outer * outer * outer - inner * inner * inner);
+    };
+    while (resolution > 0 && numDirections(resolution) * numPrimitives * sizeof(uint32_t) > m_directionalOrderSettings.maxBytes) {
+        --resolution;
+    }
+    if (resolution == 0 || numPrimitives == 0) {
+        return;
     }
+
+    for (int x = -resolution; x <= resolution; ++x) {
+        for (int y = -resolution; y <= resolution; ++y) {
+            for (int z = -resolution; z <= resolution; ++z) {
+                if (std::max(std::abs(x), std::max(std::abs(y), std::abs(z))) == resolution) {
+                    Vec3f direction(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+                    direction.normalize();
+                    orderDirections.push_back(direction);
+                }
+            }
+        }
+    }
+
+    // seen from far away in a direction, the primitives farthest from the viewer are those with the smallest projection onto it
+    directionalOrders.resize(orderDirections.size());
+    ThreadPool::instance().parallelFor(0, orderDirections.size(), 1, [&](size_t first, size_t last) {
+        std::vector<float> projections(numPrimitives);
+        for (size_t d = first; d < last; ++d) {
+            const Vec3f& direction = orderDirections[d];
+            for (size_t i = 0; i < numPrimitives; ++i) {
+                projections[i] = sortData.centroids[i] ^ direction;
+            }
+            auto& order = directionalOrders[d];
+            order.resize(numPrimitives);
+            std::iota(begin(order), end(order), 0);
+            std::sort(begin(order), end(order), [&](uint32_t lhs, uint32_t rhs) { return projections[lhs] < projections[rhs]; });
+        }
+    });
 }
 
 BoundingBox GeometryDataset::boundingBox() const {
-    BoundingBox boundingBox;
-    for (size_t i = 0; i < m_geometry->info.numberIndices; ++i) {
-        auto offset = 3 * m_geometry->indices[i];
-        const auto positions = m_geometry->positions;
-        IVDA::Vec3f pos(positions[offset + 0], positions[offset + 1], positions[offset + 2]);
-        boundingBox.min.StoreMin(pos);
-        boundingBox.max.StoreMax(pos);
-    }
-    return boundingBox;
-}
-
-bool GeometryDataset::intersects(const BoundingBox& box) const {
-    for (const auto& centroid : m_centroids) {
-        if (centroid.x >= box.min.x && centroid.y >= box.min.y && centroid.z >= box.min.z && centroid.x <= box.max.x &&
-            centroid.y <= box.max.y && centroid.z <= box.max.z) {
-            return true;
-        }
+    return m_boundingBox;
+}
+
+const std::vector<GeometryDataset::Chunk>& GeometryDataset::chunks() const {
+    return m_chunks;
+}
+
+const PrimitiveBVH& GeometryDataset::bvh() const {
+    return m_bvh;
+}
+
+std::shared_ptr<const TriangleSliceIndex> GeometryDataset::sharedSliceIndex(CoordinateAxis axis) const {
+    std::lock_guard<std::mutex> lock(m_sliceIndexMutex);
+    auto& sliceIndex = m_sliceIndices[axis];
+    if (!sliceIndex.valid()) {
+        std::shared_ptr<const G3D::GeometrySoA> geometry = m_geometry;
+        sliceIndex = ThreadPool::instance()
+                         .submit([geometry, axis] { return std::make_shared<const TriangleSliceIndex>(*geometry, axis); })
+                         .share();
+    }
+    if (sliceIndex.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return nullptr;
+    }
+    return sliceIndex.get();
+}
+
+uint64_t GeometryDataset::generation() const {
+    return m_generation;
+}
+
+bool GeometryDataset::intersects(const BoundingBox& box, Transparency transparency) const {
+    if (transparency == Transparency::Opaque || !duality::overlaps(m_boundingBox, box)) {
+        return false;
     }
-    return false;
+    // only transparent primitives are interleaved with volumes, so a box is intersected if it contains a transparent centroid
+    const float* positions = m_geometry->positions;
+    const uint32_t* indices = m_geometry->indices.data();
+    const size_t ipp = duality::indicesPerPrimitive(*this);
+    return m_bvh.visitOverlapping(box, [&](uint32_t primitive) {
+        if (transparency == Transparency::VertexColors && !((m_primitiveTransparent[primitive / 64] >> (primitive % 64)) & 1)) {
+            return false;
+        }
+        Vec3f centroid(0.0f, 0.0f, 0.0f);
+        for (size_t j = 0; j < ipp; ++j) {
+            centroid += Vec3f(positions + 3 * indices[primitive * ipp + j]);
+        }
+        centroid = centroid / static_cast<float>(ipp);
+        return centroid.x >= box.min.x && centroid.y >= box.min.y && centroid.z >= box.min.z && centroid.x <= box.max.x &&
+               centroid.y <= box.max.y && centroid.z <= box.max.z;
+    });
 }
 
 const G3D::GeometrySoA& GeometryDataset::geometry() const {
     return *m_geometry;
 }
 
+std::shared_ptr<const G3D::GeometrySoA> GeometryDataset::sharedGeometry() const {
+    return m_geometry;
+}
+
+bool duality::overlaps(const BoundingBox& lhs, const BoundingBox& rhs) {
+    return lhs.min.x <= rhs.max.x && lhs.max.x >= rhs.min.x && lhs.min.y <= rhs.max.y && lhs.max.y >= rhs.min.y && lhs.min.z <= rhs.max.z &&
+           lhs.max.z >= rhs.min.z;
+}
+
 size_t duality::indicesPerPrimitive(const GeometryDataset& dataset) {
     switch (dataset.geometry().info.primitiveType) {
     case G3D::PrimitiveType::Point:
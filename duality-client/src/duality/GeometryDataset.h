@@ -3,85 +3,123 @@
 #include "src/duality/G3D.h"
 
 #include "src/duality/BoundingBox.h"
-#include "src/duality/Color.h"
 #include "src/duality/DataProvider.h"
+#include "src/duality/DepthSorter.h"
+#include "src/duality/PrimitiveBVH.h"
+#include "src/duality/TriangleSliceIndex.h"
 
 #include "IVDA/GLMatrix.h"
 #include "IVDA/Vectors.h"
 
-#include "mocca/base/Nullable.h"
-
 #include <array>
-#include <numeric>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <vector>
 
 class DataProvider;
 class NodeDispatcher;
 
 class GeometryDataset {
 public:
-    GeometryDataset(std::unique_ptr<DataProvider> provider, std::vector<IVDA::Mat4f> transforms = {},
-                    mocca::Nullable<Color> color = mocca::Nullable<Color>());
+    // bounds of a contiguous range of primitives in indices()
+    struct Chunk {
+        uint32_t firstIndex;
+        uint32_t endIndex;
+        BoundingBox bounds;
+    };
+    // back to front orders precomputed for a fixed set of view directions, which replace per-frame sorting
+    struct DirectionalOrders {
+        DirectionalOrders()
+            : resolution(0)
+            , maxBytes(256 * 1024 * 1024)
+            , maxAngle(10.0f)
+            , refine(false) {}
+
+        // directions towards the integer points on the surface of the cube [-resolution, resolution]^3: 1 gives 26 directions,
+        // 2 gives 98; 0 disables the orders
+        uint32_t resolution;
+        // the resolution is lowered until the orders fit
+        size_t maxBytes;
+        // orders are used as is if the view direction is within this angle (in degrees) of the nearest precomputed direction
+        float maxAngle;
+        // sort exactly, starting from the nearest precomputed order, instead of applying maxAngle
+        bool refine;
+    };
+    // which primitives are blended: those with a transparent vertex color, or none or all of them for nodes that override the colors
+    // of the shared dataset
+    enum class Transparency { VertexColors, Opaque, Transparent };
+
+    GeometryDataset(std::unique_ptr<DataProvider> provider, DirectionalOrders directionalOrders = DirectionalOrders());
 
     void updateDataset();
     void initializeDataset();
-
-    bool isTransparent() const;
-    const std::vector<uint32_t>& indicesOpaque() const;
-    const std::vector<uint32_t>& indicesTransparent() const;
-    const std::vector<IVDA::Vec3f>& centroids() const;
+    // the sorting data for Transparency::Transparent is only computed if a node requires it
+    void requireTransparency(Transparency transparency);
+
+    bool isTransparent(Transparency transparency) const;
+    const std::vector<uint32_t>& indicesOpaque(Transparency transparency) const;
+    const std::vector<uint32_t>& indicesTransparent(Transparency transparency) const;
+    const std::vector<IVDA::Vec3f>& centroids(Transparency transparency) const;
+    // transparent primitives ordered back to front as seen from refPoint (in model space); looked up from the directional orders if
+    // enabled, otherwise sorted by the given sorter starting from its previous order. Datasets are shared between nodes and instances,
+    // so every caller keeps its own sorter, e.g. one per instance; the result is valid until the next call with the same sorter
+    const std::vector<uint32_t>& backToFrontOrder(const IVDA::Vec3f& refPoint, DepthSorter& sorter, Transparency transparency) const;
 
     BoundingBox boundingBox() const;
+    const std::vector<Chunk>& chunks() const;
+    const PrimitiveBVH& bvh() const;
     const G3D::GeometrySoA& geometry() const;
-    bool intersects(const BoundingBox& box) const;
+    // an initialized geometry and its slice indices are never modified, only replaced, so background work may keep using them
+    std::shared_ptr<const G3D::GeometrySoA> sharedGeometry() const;
+    // the slice index along an axis is built on the thread pool when it is first requested, since a 2D view usually slices along a
+    // single axis; nullptr until it is done
+    std::shared_ptr<const TriangleSliceIndex> sharedSliceIndex(CoordinateAxis axis) const;
+    bool intersects(const BoundingBox& box, Transparency transparency) const;
+
+    // changes whenever the geometry has changed and is unique among all datasets; allows to cache data derived from the geometry
+    uint64_t generation() const;
 
 private:
+    // centroids of the transparent primitives and their precomputed orders
+    struct SortData {
+        std::vector<IVDA::Vec3f> centroids;
+        std::vector<IVDA::Vec3f> orderDirections;
+        std::vector<std::vector<uint32_t>> directionalOrders;
+    };
+
+    void computeBounds();
     void presortIndices();
-    template <uint32_t size> void presortIndices() {
-        for (uint32_t i = 0; i < m_geometry->indices.size(); i += size) {
-
-            bool isTransparent = false;
-            for (int32_t j = 0; j < size; ++j) {
-                if (m_geometry->colors[(m_geometry->indices[i + j]) * 4 + 3] <= 0.95f) {
-                    isTransparent = true;
-                    break;
-                }
-            }
-
-            if (isTransparent) {
-                for (uint32_t k = 0; k < size; ++k) {
-                    m_indicesTransparent.push_back(m_geometry->indices[i + k]);
-                }
-            } else {
-                for (uint32_t k = 0; k < size; ++k) {
-                    m_indicesOpaque.push_back(m_geometry->indices[i + k]);
-                }
-            }
-        }
-    }
-
-    void computeCentroids();
-    template <int32_t size> void computeCentroids() {
-        for (size_t i = 0; i < m_indicesTransparent.size(); i += size) {
-            std::array<IVDA::Vec3f, size> pos;
-            for (int32_t j = 0; j < size; ++j) {
-                pos[j] = IVDA::Vec3f(m_geometry->positions + (m_indicesTransparent[i + j] * size));
-            }
-            IVDA::Vec3f centroid = std::accumulate(begin(pos), end(pos), IVDA::Vec3f()) / static_cast<float>(size);
-            m_centroids.push_back(centroid);
-        }
-    }
+    void computeCentroids(const std::vector<uint32_t>& indices, SortData& sortData);
+    void computeDirectionalOrders(SortData& sortData);
+    const SortData& sortData(Transparency transparency) const;
 
 private:
     std::unique_ptr<DataProvider> m_provider;
     bool m_initRequired;
-    std::unique_ptr<G3D::GeometrySoA> m_geometry;
-    std::vector<IVDA::Mat4f> m_transforms;
-    mocca::Nullable<Color> m_color;
+    std::shared_ptr<G3D::GeometrySoA> m_geometry;
     std::vector<uint32_t> m_indicesOpaque;
     std::vector<uint32_t> m_indicesTransparent;
-    std::vector<IVDA::Vec3f> m_centroids;
+    DirectionalOrders m_directionalOrderSettings;
+    bool m_sortAllPrimitives;
+    std::array<SortData, 3> m_sortData;
+    // one bit per primitive of indices()
+    std::vector<uint64_t> m_primitiveTransparent;
+    // scratch buffers of presortIndices, kept to avoid reallocations when the geometry is updated
+    std::vector<uint8_t> m_vertexTransparent;
+    std::vector<size_t> m_blockOffsets;
+    BoundingBox m_boundingBox;
+    std::vector<Chunk> m_chunks;
+    PrimitiveBVH m_bvh;
+    mutable std::array<std::shared_future<std::shared_ptr<const TriangleSliceIndex>>, 3> m_sliceIndices;
+    mutable std::mutex m_sliceIndexMutex;
+    uint64_t m_generation;
 };
 
 namespace duality {
+// colors with a lower alpha are blended
+const float maxTransparentAlpha = 0.95f;
+
 size_t indicesPerPrimitive(const GeometryDataset& dataset);
+bool overlaps(const BoundingBox& lhs, const BoundingBox& rhs);
 }
\ No newline at end of file
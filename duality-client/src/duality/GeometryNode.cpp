@@ -1,9 +1,17 @@
 #include "src/duality/GeometryNode.h"
 
-GeometryNode::GeometryNode(const std::string& name, Visibility visibility, std::unique_ptr<GeometryDataset> dataset)
+#include "duality/Error.h"
+
+GeometryNode::GeometryNode(const std::string& name, Visibility visibility, std::shared_ptr<GeometryDataset> dataset,
+                           std::vector<IVDA::Mat4f> instances, mocca::Nullable<Color> color)
     : SceneNode(name, visibility)
     , m_dataset(std::move(dataset))
-    , m_updateEnabled(true) {}
+    , m_instances(std::move(instances))
+    , m_instancesRevision(0)
+    , m_color(std::move(color))
+    , m_updateEnabled(true) {
+    m_dataset->requireTransparency(transparency());
+}
 
 void GeometryNode::render(RenderDispatcher2D& dispatcher) {
     dispatcher.dispatch(*this);
@@ -13,6 +21,14 @@ void GeometryNode::render(RenderDispatcher3D& dispatcher) {
     dispatcher.dispatch(*this);
 }
 
+void GeometryNode::render(SoftwareRenderer2D& renderer) {
+    renderer.dispatch(*this);
+}
+
+void GeometryNode::render(SoftwareRenderer3D& renderer) {
+    renderer.dispatch(*this);
+}
+
 void GeometryNode::setUpdateEnabled(bool enabled) {
     m_updateEnabled = enabled;
 }
@@ -30,17 +46,57 @@ void GeometryNode::initializeDataset() {
 }
 
 BoundingBox GeometryNode::boundingBox() const {
-    return m_dataset->boundingBox();
+    BoundingBox datasetBox = m_dataset->boundingBox();
+    BoundingBox result = duality::transformBoundingBox(datasetBox, m_instances.front());
+    for (size_t i = 1; i < m_instances.size(); ++i) {
+        BoundingBox instanceBox = duality::transformBoundingBox(datasetBox, m_instances[i]);
+        result.min.StoreMin(instanceBox.min);
+        result.max.StoreMax(instanceBox.max);
+    }
+    return result;
 }
 
 bool GeometryNode::intersects(const BoundingBox& box) const {
-    return m_dataset->intersects(box);
+    for (const auto& instance : m_instances) {
+        if (m_dataset->intersects(duality::transformBoundingBox(box, instance.inverse()), transparency())) {
+            return true;
+        }
+    }
+    return false;
 }
 
 const GeometryDataset& GeometryNode::dataset() const {
     return *m_dataset;
 }
 
+const std::vector<IVDA::Mat4f>& GeometryNode::instances() const {
+    return m_instances;
+}
+
+void GeometryNode::setInstances(std::vector<IVDA::Mat4f> instances) {
+    if (instances.empty()) {
+        throw Error("Geometry node '" + name() + "' requires at least one instance", __FILE__, __LINE__);
+    }
+    m_instances = std::move(instances);
+    ++m_instancesRevision;
+}
+
+uint64_t GeometryNode::instancesRevision() const {
+    return m_instancesRevision;
+}
+
+const mocca::Nullable<Color>& GeometryNode::color() const {
+    return m_color;
+}
+
+GeometryDataset::Transparency GeometryNode::transparency() const {
+    if (m_color.isNull()) {
+        return GeometryDataset::Transparency::VertexColors;
+    }
+    return m_color.get().alpha <= duality::maxTransparentAlpha ? GeometryDataset::Transparency::Transparent
+                                                               : GeometryDataset::Transparency::Opaque;
+}
+
 bool GeometryNode::isTransparent() const {
-    return m_dataset->isTransparent();
+    return m_dataset->isTransparent(transparency());
 }
\ No newline at end of file
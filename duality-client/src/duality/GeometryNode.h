@@ -1,18 +1,24 @@
 #pragma once
 
 #include "IVDA/GLMatrix.h"
+#include "src/duality/Color.h"
 #include "src/duality/GeometryDataset.h"
 #include "src/duality/SceneNode.h"
 #include "src/duality/View.h"
 
+#include "mocca/base/Nullable.h"
+
 #include <memory>
 
 class GeometryNode : public SceneNode {
 public:
-    GeometryNode(const std::string& name, Visibility visibility, std::unique_ptr<GeometryDataset> dataset);
+    GeometryNode(const std::string& name, Visibility visibility, std::shared_ptr<GeometryDataset> dataset,
+                 std::vector<IVDA::Mat4f> instances = {IVDA::Mat4f()}, mocca::Nullable<Color> color = mocca::Nullable<Color>());
 
     void render(RenderDispatcher2D& dispatcher) override;
     void render(RenderDispatcher3D& dispatcher) override;
+    void render(SoftwareRenderer2D& renderer) override;
+    void render(SoftwareRenderer3D& renderer) override;
     
     void setUpdateEnabled(bool enabled) override;
     void updateDataset() override;
@@ -22,9 +28,21 @@ public:
     bool intersects(const BoundingBox& box) const;
     const GeometryDataset& dataset() const;
 
+    // model matrices of all placements of the dataset; the dataset is stored only once
+    const std::vector<IVDA::Mat4f>& instances() const;
+    void setInstances(std::vector<IVDA::Mat4f> instances);
+    // changes whenever the instances are set
+    uint64_t instancesRevision() const;
+
+    // replaces the vertex colors of the dataset when rendering this node
+    const mocca::Nullable<Color>& color() const;
+    GeometryDataset::Transparency transparency() const;
     bool isTransparent() const;
     
 private:
-    std::unique_ptr<GeometryDataset> m_dataset;
+    std::shared_ptr<GeometryDataset> m_dataset;
+    std::vector<IVDA::Mat4f> m_instances;
+    uint64_t m_instancesRevision;
+    mocca::Nullable<Color> m_color;
     bool m_updateEnabled;
 };
\ No newline at end of file
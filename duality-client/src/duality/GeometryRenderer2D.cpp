@@ -2,10 +2,11 @@
 
 #include "src/IVDA/GLInclude.h"
 #include "src/IVDA/GLShader.h"
-#include "src/duality/GeometryUtil.h"
 
 #include <OpenGLES/ES3/gl.h>
 
+#include <algorithm>
+#include <cmath>
 
 GeometryRenderer2D::GeometryRenderer2D() {
     GlShaderAttributes attributes;
@@ -16,14 +17,18 @@ GeometryRenderer2D::GeometryRenderer2D() {
 
 GeometryRenderer2D::~GeometryRenderer2D() = default;
 
-void GeometryRenderer2D::render(const GeometryDataset& dataset, const GLMatrix& mvp, CoordinateAxis axis, float depth) {
-    auto lines = GeometryUtil::clipGeometry(dataset.geometry(), axis, depth);
+void GeometryRenderer2D::render(const GeometryDataset& dataset, const GLMatrix& mvp, const IVDA::Mat4f& modelMatrix, CoordinateAxis axis,
+                                float depth, float simplificationPixels, const mocca::Nullable<Color>& color) {
+    auto contour = m_contourCache.contour(dataset, modelMatrix, axis, depth);
+    auto lines = contour->lines(simplificationTolerance(mvp, simplificationPixels));
 
     if (lines->positions) {
         GL(glVertexAttribPointer(0, 3, GL_FLOAT, 0, 0, lines->positions));
         GL(glEnableVertexAttribArray(0));
     }
-    if (lines->colors) {
+    if (!color.isNull()) {
+        GL(glVertexAttrib4f(1, color.get().red, color.get().green, color.get().blue, color.get().alpha));
+    } else if (lines->colors) {
         GL(glVertexAttribPointer(1, 4, GL_FLOAT, 0, 0, lines->colors));
         GL(glEnableVertexAttribArray(1));
     }
@@ -31,7 +36,7 @@ void GeometryRenderer2D::render(const GeometryDataset& dataset, const GLMatrix&
     m_shader->Enable();
     m_shader->SetValue("mvpMatrix", static_cast<IVDA::Mat4f>(mvp));
 
-    GL(glLineWidth(5.0));
+    GL(glLineWidth(lineWidth));
     GL(glDisable(GL_DEPTH_TEST));
     GL(glEnable(GL_BLEND));
     GL(glDrawElements(GL_LINES, (GLsizei)lines->info.numberIndices, GL_UNSIGNED_INT, lines->indices.data()));
@@ -41,4 +46,31 @@ void GeometryRenderer2D::render(const GeometryDataset& dataset, const GLMatrix&
     GL(glDisableVertexAttribArray(0));
     GL(glDisableVertexAttribArray(1));
     GL(glEnable(GL_DEPTH_TEST));
+}
+
+float GeometryRenderer2D::simplificationTolerance(const GLMatrix& mvp, float pixels) {
+    GLint viewport[4];
+    GL(glGetIntegerv(GL_VIEWPORT, viewport));
+    return simplificationTolerance(mvp, pixels, IVDA::Vec2ui(std::max(0, viewport[2]), std::max(0, viewport[3])));
+}
+
+float GeometryRenderer2D::simplificationTolerance(const GLMatrix& mvp, float pixels, const IVDA::Vec2ui& viewportSize) {
+    if (pixels <= 0.0f || viewportSize.x == 0 || viewportSize.y == 0) {
+        return 0.0f;
+    }
+    // clip space units per model space unit along the screen axes (the 2D projection is orthographic)
+    float scaleX = 0.0f;
+    float scaleY = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        scaleX += mvp[i][0] * mvp[i][0];
+        scaleY += mvp[i][1] * mvp[i][1];
+    }
+    const float toleranceX = scaleX > 0.0f ? 2.0f / viewportSize.x / std::sqrt(scaleX) : 0.0f;
+    const float toleranceY = scaleY > 0.0f ? 2.0f / viewportSize.y / std::sqrt(scaleY) : 0.0f;
+    return pixels * std::min(toleranceX, toleranceY);
+}
+
+void GeometryRenderer2D::prefetch(const GeometryDataset& dataset, const IVDA::Mat4f& modelMatrix, CoordinateAxis axis,
+                                  const std::vector<float>& depths) {
+    m_contourCache.prefetch(dataset, modelMatrix, axis, depths);
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 
 #include "IVDA/GLMatrix.h"
 #include "duality/CoordinateSystem.h"
+#include "src/duality/Color.h"
+#include "src/duality/ContourCache.h"
 #include "src/duality/GeometryDataset.h"
 
+#include "mocca/base/Nullable.h"
+
 #include <memory>
 
 class GLShader;
@@ -13,8 +17,22 @@ public:
     GeometryRenderer2D();
     ~GeometryRenderer2D();
 
-    void render(const GeometryDataset& dataset, const GLMatrix& mvp, CoordinateAxis axis, float depth);
+    static constexpr float lineWidth = 5.0f;
+
+    // the contour is simplified so that it deviates at most simplificationPixels from the exact one on screen; a color replaces the
+    // vertex colors
+    void render(const GeometryDataset& dataset, const GLMatrix& mvp, const IVDA::Mat4f& modelMatrix, CoordinateAxis axis, float depth,
+                float simplificationPixels, const mocca::Nullable<Color>& color = mocca::Nullable<Color>());
+    void prefetch(const GeometryDataset& dataset, const IVDA::Mat4f& modelMatrix, CoordinateAxis axis, const std::vector<float>& depths);
+
+    // model space tolerance corresponding to the given number of pixels in a viewport of the given size
+    static float simplificationTolerance(const GLMatrix& mvp, float pixels, const IVDA::Vec2ui& viewportSize);
+
+private:
+    // the tolerance for the current viewport
+    static float simplificationTolerance(const GLMatrix& mvp, float pixels);
 
 private:
     std::unique_ptr<GLShader> m_shader;
+    ContourCache m_contourCache;
 };
\ No newline at end of file
@@ -3,9 +3,12 @@
 #include "duality/Error.h"
 #include "src/IVDA/GLInclude.h"
 #include "src/IVDA/GLShader.h"
+#include "src/duality/GeometryNode.h"
 
 #include <OpenGLES/ES3/gl.h>
 
+#include <numeric>
+
 GeometryRenderer3D::GeometryRenderer3D() {
     {
         GlShaderAttributes attributes;
@@ -64,18 +67,19 @@ GeometryRenderer3D::GeometryRenderer3D() {
 
 GeometryRenderer3D::~GeometryRenderer3D() = default;
 
-void GeometryRenderer3D::renderOpaque(const GeometryDataset& dataset, const MVP3D& mvp) {
-    auto& shader = determineActiveShader(dataset);
+void GeometryRenderer3D::renderOpaque(const GeometryNode& node, const MVP3D& mvp) {
+    const GeometryDataset& dataset = node.dataset();
+    auto& shader = determineActiveShader(node);
     shader.Enable();
 
     shader.SetValue("mvpMatrix", static_cast<IVDA::Mat4f>(mvp.mvp()));
 
     GL(glEnable(GL_DEPTH_TEST));
 
-    int attributeCount = enableAttributeArrays(dataset);
+    int attributeCount = enableAttributeArrays(node);
 
     int primitiveType = primitiveTypeGL(dataset);
-    const auto& indices = dataset.indicesOpaque();
+    const auto& indices = dataset.indicesOpaque(node.transparency());
 
     GL(glDrawElements(primitiveType, (GLsizei)indices.size(), GL_UNSIGNED_INT, indices.data()));
 
@@ -84,35 +88,36 @@ void GeometryRenderer3D::renderOpaque(const GeometryDataset& dataset, const MVP3
     }
 }
 
-void GeometryRenderer3D::renderTransparent(const GeometryDataset& dataset, const MVP3D& mvp) {
-    std::vector<IVDA::Vec3f> centroids(dataset.centroids());
-    auto permutation = duality::backToFrontPermutation(dataset.centroids(), mvp.eyePos());
+void GeometryRenderer3D::renderTransparent(const GeometryNode& node, const MVP3D& mvp, DepthSorter& sorter) {
+    const GeometryDataset& dataset = node.dataset();
+    const auto& permutation = dataset.backToFrontOrder(mvp.eyePos(), sorter, node.transparency());
 
-    const auto& indices = dataset.indicesTransparent();
-    std::vector<uint32_t> indicesSorted(indices.size());
+    const auto& indices = dataset.indicesTransparent(node.transparency());
     if (dataset.geometry().info.primitiveType == G3D::Point) {
-        duality::applyPermutation<1>(permutation, indices, indicesSorted);
+        duality::applyPermutation<1>(permutation, indices, m_sortedIndices);
     } else if (dataset.geometry().info.primitiveType == G3D::Line) {
-        duality::applyPermutation<2>(permutation, indices, indicesSorted);
+        duality::applyPermutation<2>(permutation, indices, m_sortedIndices);
     } else if (dataset.geometry().info.primitiveType == G3D::Triangle) {
-        duality::applyPermutation<3>(permutation, indices, indicesSorted);
+        duality::applyPermutation<3>(permutation, indices, m_sortedIndices);
     }
 
-    renderTransparentPartial(dataset, mvp, indicesSorted);
+    renderTransparentPartial(node, mvp, m_sortedIndices.data(), m_sortedIndices.size());
 }
 
-void GeometryRenderer3D::renderTransparentPartial(const GeometryDataset& dataset, const MVP3D& mvp, const std::vector<uint32_t>& indices) {
-    auto& shader = determineActiveShader(dataset);
+void GeometryRenderer3D::renderTransparentPartial(const GeometryNode& node, const MVP3D& mvp, const uint32_t* indices,
+                                                  size_t numIndices) {
+    const GeometryDataset& dataset = node.dataset();
+    auto& shader = determineActiveShader(node);
     shader.Enable();
     shader.SetValue("mvpMatrix", static_cast<IVDA::Mat4f>(mvp.mvp()));
     
     GL(glEnable(GL_BLEND));
     GL(glEnable(GL_DEPTH_TEST));
     
-    int attributeCount = enableAttributeArrays(dataset);
+    int attributeCount = enableAttributeArrays(node);
     int primitiveType = primitiveTypeGL(dataset);
     
-    GL(glDrawElements(primitiveType, (GLsizei)indices.size(), GL_UNSIGNED_INT, indices.data()));
+    GL(glDrawElements(primitiveType, (GLsizei)numIndices, GL_UNSIGNED_INT, indices));
     
     for (int i = 0; i < attributeCount; ++i) {
         GL(glDisableVertexAttribArray(i));
@@ -138,25 +143,28 @@ int GeometryRenderer3D::primitiveTypeGL(const GeometryDataset& dataset) {
     }
 }
 
-GLShader& GeometryRenderer3D::determineActiveShader(const GeometryDataset& dataset) const {
-    if (dataset.geometry().normals && !dataset.geometry().colors && !dataset.geometry().texcoords && !dataset.geometry().alphas)
+GLShader& GeometryRenderer3D::determineActiveShader(const GeometryNode& node) const {
+    const G3D::GeometrySoA& geometry = node.dataset().geometry();
+    const bool colors = geometry.colors || !node.color().isNull();
+    if (geometry.normals && !colors && !geometry.texcoords && !geometry.alphas)
         return *m_normShader;
-    else if (dataset.geometry().normals && !dataset.geometry().colors && !dataset.geometry().texcoords && dataset.geometry().alphas)
+    else if (geometry.normals && !colors && !geometry.texcoords && geometry.alphas)
         return *m_normAlphaShader;
-    else if (dataset.geometry().normals && !dataset.geometry().colors && dataset.geometry().texcoords && dataset.geometry().alphas)
+    else if (geometry.normals && !colors && geometry.texcoords && geometry.alphas)
         return *m_normTexAlphaShader;
-    else if (dataset.geometry().normals && dataset.geometry().colors && !dataset.geometry().texcoords && !dataset.geometry().alphas)
+    else if (geometry.normals && colors && !geometry.texcoords && !geometry.alphas)
         return *m_normColShader;
-    else if (!dataset.geometry().normals && dataset.geometry().colors && !dataset.geometry().texcoords && !dataset.geometry().alphas)
+    else if (!geometry.normals && colors && !geometry.texcoords && !geometry.alphas)
         return *m_colShader;
-    else if (dataset.geometry().normals && !dataset.geometry().colors && dataset.geometry().texcoords && !dataset.geometry().alphas)
+    else if (geometry.normals && !colors && geometry.texcoords && !geometry.alphas)
         return *m_normTexShader;
-    else if (!dataset.geometry().normals && !dataset.geometry().colors && dataset.geometry().texcoords && !dataset.geometry().alphas)
+    else if (!geometry.normals && !colors && geometry.texcoords && !geometry.alphas)
         return *m_texShader;
     throw Error("Cannot determine shader for geometry dataset", __FILE__, __LINE__);
 }
 
-int GeometryRenderer3D::enableAttributeArrays(const GeometryDataset& dataset) {
+int GeometryRenderer3D::enableAttributeArrays(const GeometryNode& node) {
+    const GeometryDataset& dataset = node.dataset();
     int attributeIndex = 0;
     if (dataset.geometry().positions) {
         GL(glVertexAttribPointer(attributeIndex, 3, GL_FLOAT, 0, 0, dataset.geometry().positions));
@@ -170,7 +178,11 @@ int GeometryRenderer3D::enableAttributeArrays(const GeometryDataset& dataset) {
         GL(glVertexAttribPointer(attributeIndex, 3, GL_FLOAT, 0, 0, dataset.geometry().tangents));
         GL(glEnableVertexAttribArray(attributeIndex++));
     }
-    if (dataset.geometry().colors) {
+    if (!node.color().isNull()) {
+        const Color& color = node.color().get();
+        GL(glDisableVertexAttribArray(attributeIndex));
+        GL(glVertexAttrib4f(attributeIndex++, color.red, color.green, color.blue, color.alpha));
+    } else if (dataset.geometry().colors) {
         GL(glVertexAttribPointer(attributeIndex, 4, GL_FLOAT, 0, 0, dataset.geometry().colors));
         GL(glEnableVertexAttribArray(attributeIndex++));
     }
@@ -190,16 +202,16 @@ int GeometryRenderer3D::enableAttributeArrays(const GeometryDataset& dataset) {
     return attributeIndex - 1;
 }
 
-std::vector<int32_t> duality::backToFrontPermutation(const std::vector<IVDA::Vec3f>& points, const IVDA::Vec3f& refPoint) {
-    auto sorter = [&](size_t index1, size_t index2) {
-        float dist1 = (points[index1] - refPoint).sqLength();
-        float dist2 = (points[index2] - refPoint).sqLength();
-        return dist1 > dist2;
-    };
+std::vector<uint32_t> duality::backToFrontPermutation(const std::vector<IVDA::Vec3f>& points, const IVDA::Vec3f& refPoint) {
+    std::vector<float> distances(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        distances[i] = (points[i] - refPoint).sqLength();
+    }
 
-    std::vector<int32_t> permutation(points.size());
+    std::vector<uint32_t> permutation(points.size());
     std::iota(begin(permutation), end(permutation), 0);
-    std::sort(begin(permutation), end(permutation), sorter);
+    std::sort(begin(permutation), end(permutation),
+              [&](uint32_t index1, uint32_t index2) { return distances[index1] > distances[index2]; });
 
     return permutation;
 }
\ No newline at end of file
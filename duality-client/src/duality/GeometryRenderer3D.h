@@ -4,22 +4,26 @@
 #include "duality/ScreenInfo.h"
 #include "src/duality/GeometryDataset.h"
 #include "src/duality/MVP3D.h"
+#include "src/duality/ThreadPool.h"
 
 class GLShader;
+class GeometryNode;
 
 class GeometryRenderer3D {
 public:
     GeometryRenderer3D();
     ~GeometryRenderer3D();
 
-    void renderOpaque(const GeometryDataset& dataset, const MVP3D& mvp);
-    void renderTransparent(const GeometryDataset& dataset, const MVP3D& mvp);
-    void renderTransparentPartial(const GeometryDataset& dataset, const MVP3D& mvp, const std::vector<uint32_t>& indices);
+    void renderOpaque(const GeometryNode& node, const MVP3D& mvp);
+    // the sorter keeps the back to front order of the instance across frames
+    void renderTransparent(const GeometryNode& node, const MVP3D& mvp, DepthSorter& sorter);
+    void renderTransparentPartial(const GeometryNode& node, const MVP3D& mvp, const uint32_t* indices, size_t numIndices);
 
 private:
     static int primitiveTypeGL(const GeometryDataset& dataset);
-    static int enableAttributeArrays(const GeometryDataset& dataset);
-    GLShader& determineActiveShader(const GeometryDataset& dataset) const;
+    // the color of the node is set as a constant attribute instead of the color array
+    static int enableAttributeArrays(const GeometryNode& node);
+    GLShader& determineActiveShader(const GeometryNode& node) const;
 
 private:
     std::unique_ptr<GLShader> m_normShader;
@@ -29,18 +33,23 @@ private:
     std::unique_ptr<GLShader> m_colShader;
     std::unique_ptr<GLShader> m_normTexShader;
     std::unique_ptr<GLShader> m_texShader;
+    // reused across frames
+    std::vector<uint32_t> m_sortedIndices;
 };
 
 namespace duality {
-std::vector<int32_t> backToFrontPermutation(const std::vector<IVDA::Vec3f>& points, const IVDA::Vec3f& refPoint);
+// for a few points; large sets are sorted by a DepthSorter that is kept across frames, see GeometryDataset::backToFrontOrder
+std::vector<uint32_t> backToFrontPermutation(const std::vector<IVDA::Vec3f>& points, const IVDA::Vec3f& refPoint);
 
 template <int stride, typename T>
-void applyPermutation(const std::vector<int32_t> permutation, const std::vector<T>& source, std::vector<T>& target) {
+void applyPermutation(const std::vector<uint32_t>& permutation, const std::vector<T>& source, std::vector<T>& target) {
     target.resize(source.size());
-    for (size_t i = 0; i < permutation.size(); ++i) {
-        for (size_t j = 0; j < stride; ++j) {
-            target[i * stride + j] = source[permutation[i] * stride + j];
+    ThreadPool::instance().parallelFor(0, permutation.size(), 16 * 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t j = 0; j < stride; ++j) {
+                target[i * stride + j] = source[permutation[i] * stride + j];
+            }
         }
-    }
+    });
 }
 }
\ No newline at end of file
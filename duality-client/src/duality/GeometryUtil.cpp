@@ -1,153 +1,335 @@
 #include "src/duality/GeometryUtil.h"
 
-std::unique_ptr<G3D::GeometrySoA> GeometryUtil::clipGeometry(const G3D::GeometrySoA& geo, CoordinateAxis axis, float position) {
-    // in planeIntersection
-    float inPositions[9]; // xyz for 3 vertices of the given triangle
-    float inColors[12];   // RGBA for 3 vertices of the given triangle
-    // out planeIntersection
-    float outPositions[9]; // max 3 lines
-    float outColors[12];   // max 3 lines
-    size_t points;         // number of intersection points
+#include "src/duality/GeometryDataset.h"
+#include "src/duality/ThreadPool.h"
+#include "src/duality/TriangleSliceIndex.h"
 
-    const std::vector<uint32_t>& is = geo.indices;
+#include <algorithm>
+
+namespace {
+const size_t trianglesPerTask = 1 << 14;
+const size_t classifyBlockSize = 256;
+
+// lines of one task, sized for the worst case of three points and three lines per touching triangle
+struct LineChunk {
+    std::vector<uint32_t> indices;
+    std::vector<float> positions;
+    std::vector<float> colors;
+    size_t numIndices = 0;
+    size_t numPoints = 0;
+};
+
+// clips the triangles [begin, end) of the list (or of the geometry if triangles is null) against the plane Axis = position. The
+// vertex distances of a block are gathered into separate arrays first, so that the touching test runs as a branch-free loop that the
+// compiler vectorizes; only touching triangles reach the scalar emission code.
+template <int Axis, bool HasColors>
+void clipRange(const G3D::GeometrySoA& geo, const uint32_t* triangles, size_t begin, size_t end, float position, LineChunk& chunk) {
     const float* ps = geo.positions;
     const float* cs = geo.colors;
+    const uint32_t* is = geo.indices.data();
+    const float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    float distA[classifyBlockSize];
+    float distB[classifyBlockSize];
+    float distC[classifyBlockSize];
+    uint8_t touching[classifyBlockSize];
+    uint32_t ids[classifyBlockSize];
 
-    // resulting lines
-    std::vector<uint32_t> clipIndices;
-    std::vector<float> clipPositions;
-    std::vector<float> clipColors;
-
-    for (int i = 0; i < geo.info.numberIndices; i += 3) {
-        // assemble in parameters for plane intersection
-        for (int j = 0; j < 3; j++) // copy all three vertices per triangle
-        {
-            size_t const ip = is[i + j] * 3;
-            size_t const j3 = j * 3;
-            inPositions[j3] = ps[ip];
-            inPositions[j3 + 1] = ps[ip + 1];
-            inPositions[j3 + 2] = ps[ip + 2];
-
-            size_t const ic = is[i + j] * 4;
-            size_t const j4 = j * 4;
-            inColors[j4] = cs[ic];
-            inColors[j4 + 1] = cs[ic + 1];
-            inColors[j4 + 2] = cs[ic + 2];
-            inColors[j4 + 3] = cs[ic + 3];
+    for (size_t blockBegin = begin; blockBegin < end; blockBegin += classifyBlockSize) {
+        const size_t count = std::min(classifyBlockSize, end - blockBegin);
+        for (size_t k = 0; k < count; ++k) {
+            const uint32_t t = triangles != nullptr ? triangles[blockBegin + k] : static_cast<uint32_t>(blockBegin + k);
+            ids[k] = t;
+            distA[k] = ps[3 * is[3 * t] + Axis] - position;
+            distB[k] = ps[3 * is[3 * t + 1] + Axis] - position;
+            distC[k] = ps[3 * is[3 * t + 2] + Axis] - position;
+        }
+        size_t numTouching = 0;
+        for (size_t k = 0; k < count; ++k) {
+            const float minDist = std::min(distA[k], std::min(distB[k], distC[k]));
+            const float maxDist = std::max(distA[k], std::max(distB[k], distC[k]));
+            touching[k] = (minDist <= 0.0f) & (maxDist >= 0.0f);
+            numTouching += touching[k];
+        }
+        if (numTouching == 0) {
+            continue;
         }
 
-        if (planeIntersection(inPositions, inColors, axis, position, outPositions, outColors, points)) {
-            if (points >= 2) {
-                for (int j = 0; j < 6; j++) // 2 vertices
-                {
-                    clipPositions.push_back(outPositions[j]);
-                }
-                for (int j = 0; j < 8; j++) // 2 colors
-                {
-                    clipColors.push_back(outColors[j]);
+        chunk.positions.resize(3 * (chunk.numPoints + 3 * numTouching));
+        chunk.colors.resize(4 * (chunk.numPoints + 3 * numTouching));
+        chunk.indices.resize(chunk.numIndices + 6 * numTouching);
+        for (size_t k = 0; k < count; ++k) {
+            if (!touching[k]) {
+                continue;
+            }
+            const uint32_t vertices[3] = {is[3 * ids[k]], is[3 * ids[k] + 1], is[3 * ids[k] + 2]};
+            const float dists[3] = {distA[k], distB[k], distC[k]};
+            const uint32_t first = static_cast<uint32_t>(chunk.numPoints);
+            float* positionOut = chunk.positions.data() + 3 * chunk.numPoints;
+            float* colorOut = chunk.colors.data() + 4 * chunk.numPoints;
+            int points = 0;
+
+            auto addVertex = [&](uint32_t v) {
+                std::copy(ps + 3 * v, ps + 3 * v + 3, positionOut + 3 * points);
+                const float* color = HasColors ? cs + 4 * v : white;
+                std::copy(color, color + 4, colorOut + 4 * points);
+                ++points;
+            };
+            auto addEdgePoint = [&](int a, int b) {
+                // interpolate from the lower vertex index, so that both triangles sharing the edge produce identical points
+                if (vertices[a] > vertices[b]) {
+                    std::swap(a, b);
                 }
-                // add indices for last two points
-                clipIndices.push_back(static_cast<uint32_t>(clipPositions.size()) / 3 - 2);
-                clipIndices.push_back(static_cast<uint32_t>(clipPositions.size()) / 3 - 1);
-
-                // add third point if the given triangle happens to lie in the plane
-                if (points == 3) {
-                    for (int j = 0; j < 3; j++) {
-                        clipPositions.push_back(outPositions[j + 6]);
-                    }
-                    for (int j = 0; j < 4; j++) {
-                        clipColors.push_back(outColors[j + 8]);
+                const float t = dists[a] / (dists[a] - dists[b]);
+                const float* pa = ps + 3 * vertices[a];
+                const float* pb = ps + 3 * vertices[b];
+                float* p = positionOut + 3 * points;
+                p[0] = pa[0] + t * (pb[0] - pa[0]);
+                p[1] = pa[1] + t * (pb[1] - pa[1]);
+                p[2] = pa[2] + t * (pb[2] - pa[2]);
+                p[Axis] = position;
+                float* c = colorOut + 4 * points;
+                if (HasColors) {
+                    const float* ca = cs + 4 * vertices[a];
+                    const float* cb = cs + 4 * vertices[b];
+                    for (int i = 0; i < 4; ++i) {
+                        c[i] = ca[i] + t * (cb[i] - ca[i]);
                     }
-                    // add the other two lines because we have a triangle and not just a line
-                    clipIndices.push_back(static_cast<uint32_t>(clipPositions.size()) / 3 - 2);
-                    clipIndices.push_back(static_cast<uint32_t>(clipPositions.size()) / 3 - 1);
-                    clipIndices.push_back(static_cast<uint32_t>(clipPositions.size()) / 3 - 3);
-                    clipIndices.push_back(static_cast<uint32_t>(clipPositions.size()) / 3 - 1);
+                } else {
+                    std::copy(white, white + 4, c);
+                }
+                ++points;
+            };
+
+            uint32_t* indexOut = chunk.indices.data() + chunk.numIndices;
+            if (dists[0] == 0.0f && dists[1] == 0.0f && dists[2] == 0.0f) {
+                // triangle lies in the plane
+                addVertex(vertices[0]);
+                addVertex(vertices[1]);
+                addVertex(vertices[2]);
+                const uint32_t outline[6] = {first, first + 1, first + 1, first + 2, first, first + 2};
+                std::copy(outline, outline + 6, indexOut);
+                chunk.numPoints += 3;
+                chunk.numIndices += 6;
+                continue;
+            }
+            // vertices on the plane and edges that strictly cross it
+            for (int i = 0; i < 3; ++i) {
+                if (dists[i] == 0.0f) {
+                    addVertex(vertices[i]);
                 }
             }
+            if (dists[0] * dists[1] < 0.0f) {
+                addEdgePoint(0, 1);
+            }
+            if (dists[0] * dists[2] < 0.0f) {
+                addEdgePoint(0, 2);
+            }
+            if (dists[1] * dists[2] < 0.0f) {
+                addEdgePoint(1, 2);
+            }
+            if (points == 2) {
+                indexOut[0] = first;
+                indexOut[1] = first + 1;
+                chunk.numPoints += 2;
+                chunk.numIndices += 2;
+            }
+        }
+    }
+}
+
+template <int Axis, bool HasColors>
+void clipTasks(const G3D::GeometrySoA& geo, const uint32_t* triangles, size_t numTriangles, float position, std::vector<LineChunk>& chunks) {
+    ThreadPool::instance().parallelFor(0, chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t task = begin; task < end; ++task) {
+            const size_t first = task * trianglesPerTask;
+            clipRange<Axis, HasColors>(geo, triangles, first, std::min(numTriangles, first + trianglesPerTask), position, chunks[task]);
         }
+    });
+}
+}
+
+std::unique_ptr<G3D::GeometrySoA> GeometryUtil::clipGeometry(const G3D::GeometrySoA& geo, CoordinateAxis axis, float position) {
+    return clipTriangles(geo, nullptr, geo.info.numberIndices / 3, axis, position);
+}
+
+std::unique_ptr<G3D::GeometrySoA> GeometryUtil::clipGeometry(const G3D::GeometrySoA& geo, const IVDA::Vec4f& plane) {
+    Lines lines;
+    for (uint32_t triangle = 0; triangle < geo.info.numberIndices / 3; ++triangle) {
+        clipTriangle(geo, triangle, plane, lines);
+    }
+    return G3D::createLineGeometry(std::move(lines.indices), std::move(lines.positions), std::move(lines.colors));
+}
+
+std::unique_ptr<G3D::GeometrySoA> GeometryUtil::clipGeometry(const GeometryDataset& dataset, const IVDA::Mat4f& modelMatrix,
+                                                             CoordinateAxis axis, float position) {
+    const G3D::GeometrySoA& geo = dataset.geometry();
+    CoordinateAxis modelAxis;
+    float modelPosition;
+    if (modelSpaceAxisPlane(modelMatrix, axis, position, modelAxis, modelPosition)) {
+        // all triangles are clipped while the slice index is being built, which gives the same lines
+        auto sliceIndex = dataset.sharedSliceIndex(modelAxis);
+        return sliceIndex ? clipGeometry(geo, *sliceIndex, modelAxis, modelPosition) : clipGeometry(geo, modelAxis, modelPosition);
+    }
+
+    // world space coordinate 'axis' of a model space point p is dot(row, p)
+    const float* row = modelMatrix.array + 4 * axis;
+    const IVDA::Vec4f plane(row[0], row[1], row[2], row[3] - position);
+    std::vector<uint32_t> candidates;
+    dataset.bvh().visitCrossing(plane, [&](uint32_t triangle) {
+        candidates.push_back(triangle);
+        return false;
+    });
+    std::sort(begin(candidates), end(candidates));
+    Lines lines;
+    for (auto triangle : candidates) {
+        clipTriangle(geo, triangle, plane, lines);
     }
-    auto lines = G3D::createLineGeometry(std::move(clipIndices), std::move(clipPositions), std::move(clipColors));
-    return lines;
+    return G3D::createLineGeometry(std::move(lines.indices), std::move(lines.positions), std::move(lines.colors));
 }
 
-bool GeometryUtil::planeIntersection(const float* triPositions, const float* triColors, CoordinateAxis axis, float axisPosition, float* linePositions, float* lineColors, size_t& numberOfPoints) {
-    bool intersection = false;
+std::unique_ptr<G3D::GeometrySoA> GeometryUtil::clipGeometry(const G3D::GeometrySoA& geo, const TriangleSliceIndex& sliceIndex,
+                                                             CoordinateAxis axis, float position) {
+    // only the triangles in the slice index bucket of the plane are visited
+    std::vector<uint32_t> candidates;
+    sliceIndex.candidates(position, candidates);
+    return clipTriangles(geo, candidates.data(), candidates.size(), axis, position);
+}
 
-    // distance clipping plane to vertices per component
-    float const distA = axisPosition - triPositions[axis];
-    float const distB = axisPosition - triPositions[axis + 3];
-    float const distC = axisPosition - triPositions[axis + 6];
+bool GeometryUtil::modelSpaceAxisPlane(const IVDA::Mat4f& modelMatrix, CoordinateAxis axis, float position, CoordinateAxis& modelAxis,
+                                       float& modelPosition) {
+    // world space coordinate 'axis' of a model space point p is dot(row, p); translated / scaled instances keep the plane axis aligned
+    const float* row = modelMatrix.array + 4 * axis;
+    int nonZero = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (row[i] != 0.0f) {
+            ++nonZero;
+            modelAxis = static_cast<CoordinateAxis>(i);
+        }
+    }
+    if (nonZero != 1) {
+        return false;
+    }
+    modelPosition = (position - row[3]) / row[modelAxis];
+    return true;
+}
 
-    int const otherAxis1 = axis == 0 ? 1 : 0;
-    int const otherAxis2 = axis == 2 ? 1 : 2;
-    numberOfPoints = distA == 0 + distB == 0 + distC == 0;
+std::unique_ptr<G3D::GeometrySoA> GeometryUtil::clipTriangles(const G3D::GeometrySoA& geo, const uint32_t* triangles, size_t numTriangles,
+                                                              CoordinateAxis axis, float position) {
+    std::vector<LineChunk> chunks((numTriangles + trianglesPerTask - 1) / trianglesPerTask);
+    const bool hasColors = geo.colors != nullptr;
+    switch (axis) {
+    case X_Axis:
+        hasColors ? clipTasks<0, true>(geo, triangles, numTriangles, position, chunks)
+                  : clipTasks<0, false>(geo, triangles, numTriangles, position, chunks);
+        break;
+    case Y_Axis:
+        hasColors ? clipTasks<1, true>(geo, triangles, numTriangles, position, chunks)
+                  : clipTasks<1, false>(geo, triangles, numTriangles, position, chunks);
+        break;
+    case Z_Axis:
+        hasColors ? clipTasks<2, true>(geo, triangles, numTriangles, position, chunks)
+                  : clipTasks<2, false>(geo, triangles, numTriangles, position, chunks);
+        break;
+    }
 
-    if (numberOfPoints == 3) {
-        for (int i = 0; i < numberOfPoints * G3D::floats(G3D::AttributeSemantic::Position); i++) {
-            linePositions[i] = triPositions[i];
+    // concatenate the task results in task order, which keeps the order of the triangles
+    size_t numPoints = 0;
+    size_t numIndices = 0;
+    for (const auto& chunk : chunks) {
+        numPoints += chunk.numPoints;
+        numIndices += chunk.numIndices;
+    }
+    std::vector<float> positions(3 * numPoints);
+    std::vector<float> colors(4 * numPoints);
+    std::vector<uint32_t> indices(numIndices);
+    size_t pointOffset = 0;
+    size_t indexOffset = 0;
+    for (const auto& chunk : chunks) {
+        std::copy(chunk.positions.begin(), chunk.positions.begin() + 3 * chunk.numPoints, positions.begin() + 3 * pointOffset);
+        std::copy(chunk.colors.begin(), chunk.colors.begin() + 4 * chunk.numPoints, colors.begin() + 4 * pointOffset);
+        for (size_t i = 0; i < chunk.numIndices; ++i) {
+            indices[indexOffset + i] = chunk.indices[i] + static_cast<uint32_t>(pointOffset);
         }
-        for (int i = 0; i < numberOfPoints * G3D::floats(G3D::AttributeSemantic::Color); i++) {
-            lineColors[i] = triColors[i];
+        pointOffset += chunk.numPoints;
+        indexOffset += chunk.numIndices;
+    }
+    return G3D::createLineGeometry(std::move(indices), std::move(positions), std::move(colors));
+}
+
+void GeometryUtil::clipTriangle(const G3D::GeometrySoA& geo, uint32_t triangle, const IVDA::Vec4f& plane, Lines& lines) {
+    const std::vector<uint32_t>& is = geo.indices;
+    const float* ps = geo.positions;
+    const float* cs = geo.colors;
+
+    std::vector<uint32_t>& clipIndices = lines.indices;
+    std::vector<float>& clipPositions = lines.positions;
+    std::vector<float>& clipColors = lines.colors;
+
+    auto signedDistance = [&](uint32_t index) {
+        const float* p = ps + 3 * index;
+        return plane.x * p[0] + plane.y * p[1] + plane.z * p[2] + plane.w;
+    };
+    auto addVertex = [&](uint32_t index) {
+        clipPositions.insert(end(clipPositions), ps + 3 * index, ps + 3 * index + 3);
+        clipColors.insert(end(clipColors), cs + 4 * index, cs + 4 * index + 4);
+    };
+    auto addEdgePoint = [&](uint32_t indexA, float distA, uint32_t indexB, float distB) {
+        // interpolate from the lower vertex index, so that both triangles sharing the edge produce identical points
+        if (indexA > indexB) {
+            std::swap(indexA, indexB);
+            std::swap(distA, distB);
         }
-        intersection = true;
-    } else {
-        float const absDistA = std::abs(distA);
-        float const absDistB = std::abs(distB);
-        float const absDistC = std::abs(distC);
-
-        // if dist 0 and other points below 0 we do not create a line
-        numberOfPoints = 0;
-        if (((distA > 0) ^ (distB > 0)) || ((distA < 0) ^ (distB < 0))) {
-            size_t const numberOfPoints3 = numberOfPoints * G3D::floats(G3D::AttributeSemantic::Position);
-            linePositions[numberOfPoints3 + axis] = axisPosition;
-            linePositions[numberOfPoints3 + otherAxis1] = triPositions[otherAxis1] + (distA / (triPositions[axis] - triPositions[axis + 3]) * (triPositions[otherAxis1] - triPositions[otherAxis1 + 3]));
-            linePositions[numberOfPoints3 + otherAxis2] = triPositions[otherAxis2] + (distA / (triPositions[axis] - triPositions[axis + 3]) * (triPositions[otherAxis2] - triPositions[otherAxis2 + 3]));
-
-            float const norm = absDistA + absDistB;
-            size_t const numberOfPoints4 = numberOfPoints * G3D::floats(G3D::AttributeSemantic::Color);
-            lineColors[numberOfPoints4] = (triColors[0] * absDistB + triColors[4] * absDistA) / norm;
-            lineColors[numberOfPoints4 + 1] = (triColors[1] * absDistB + triColors[5] * absDistA) / norm;
-            lineColors[numberOfPoints4 + 2] = (triColors[2] * absDistB + triColors[6] * absDistA) / norm;
-            lineColors[numberOfPoints4 + 3] = (triColors[3] * absDistB + triColors[7] * absDistA) / norm;
-
-            numberOfPoints++;
-            intersection = true;
+        const float t = distA / (distA - distB);
+        for (int k = 0; k < 3; ++k) {
+            clipPositions.push_back(ps[3 * indexA + k] + t * (ps[3 * indexB + k] - ps[3 * indexA + k]));
         }
-        if (((distA > 0) ^ (distC > 0)) || ((distA < 0) ^ (distC < 0))) {
-            size_t const numberOfPoints3 = numberOfPoints * G3D::floats(G3D::AttributeSemantic::Position);
-            linePositions[numberOfPoints3 + axis] = axisPosition;
-            linePositions[numberOfPoints3 + otherAxis1] = triPositions[otherAxis1] + (distA / (triPositions[axis] - triPositions[axis + 6]) * (triPositions[otherAxis1] - triPositions[otherAxis1 + 6]));
-            linePositions[numberOfPoints3 + otherAxis2] = triPositions[otherAxis2] + (distA / (triPositions[axis] - triPositions[axis + 6]) * (triPositions[otherAxis2] - triPositions[otherAxis2 + 6]));
-
-            float const norm = absDistA + absDistC;
-            size_t const numberOfPoints4 = numberOfPoints * G3D::floats(G3D::AttributeSemantic::Color);
-            lineColors[numberOfPoints4] = (triColors[0] * absDistC + triColors[8] * absDistA) / norm;
-            lineColors[numberOfPoints4 + 1] = (triColors[1] * absDistC + triColors[9] * absDistA) / norm;
-            lineColors[numberOfPoints4 + 2] = (triColors[2] * absDistC + triColors[10] * absDistA) / norm;
-            lineColors[numberOfPoints4 + 3] = (triColors[3] * absDistC + triColors[11] * absDistA) / norm;
-
-            numberOfPoints++;
-            intersection = true;
+        for (int k = 0; k < 4; ++k) {
+            clipColors.push_back(cs[4 * indexA + k] + t * (cs[4 * indexB + k] - cs[4 * indexA + k]));
         }
-        if (((distB > 0) ^ (distC > 0)) || ((distB < 0) ^ (distC < 0))) {
-            size_t const numberOfPoints3 = numberOfPoints * G3D::floats(G3D::AttributeSemantic::Position);
-            linePositions[numberOfPoints3 + axis] = axisPosition;
-            linePositions[numberOfPoints3 + otherAxis1] =
-                triPositions[otherAxis1 + 3] + (distB / (triPositions[axis + 3] - triPositions[axis + 6]) * (triPositions[otherAxis1 + 3] - triPositions[otherAxis1 + 6]));
-            linePositions[numberOfPoints3 + otherAxis2] =
-                triPositions[otherAxis2 + 3] + (distB / (triPositions[axis + 3] - triPositions[axis + 6]) * (triPositions[otherAxis2 + 3] - triPositions[otherAxis2 + 6]));
-
-            float const norm = absDistB + absDistC;
-            size_t const numberOfPoints4 = numberOfPoints * G3D::floats(G3D::AttributeSemantic::Color);
-            lineColors[numberOfPoints4] = (triColors[4] * absDistC + triColors[8] * absDistB) / norm;
-            lineColors[numberOfPoints4 + 1] = (triColors[5] * absDistC + triColors[9] * absDistB) / norm;
-            lineColors[numberOfPoints4 + 2] = (triColors[6] * absDistC + triColors[10] * absDistB) / norm;
-            lineColors[numberOfPoints4 + 3] = (triColors[7] * absDistC + triColors[11] * absDistB) / norm;
-
-            numberOfPoints++;
-            intersection = true;
+    };
+
+    const size_t i = 3 * triangle;
+    const uint32_t a = is[i], b = is[i + 1], c = is[i + 2];
+    const float distA = signedDistance(a);
+    const float distB = signedDistance(b);
+    const float distC = signedDistance(c);
+
+    const uint32_t first = static_cast<uint32_t>(clipPositions.size() / 3);
+    if (distA == 0 && distB == 0 && distC == 0) {
+        // triangle lies in the plane
+        addVertex(a);
+        addVertex(b);
+        addVertex(c);
+        clipIndices.insert(end(clipIndices), {first, first + 1, first + 1, first + 2, first, first + 2});
+        return;
+    }
+
+    // vertices on the plane and edges that strictly cross it
+    int points = 0;
+    for (const auto& vertex : {std::make_pair(a, distA), std::make_pair(b, distB), std::make_pair(c, distC)}) {
+        if (vertex.second == 0) {
+            addVertex(vertex.first);
+            ++points;
         }
     }
-    return intersection;
-}
\ No newline at end of file
+    if (distA * distB < 0) {
+        addEdgePoint(a, distA, b, distB);
+        ++points;
+    }
+    if (distA * distC < 0) {
+        addEdgePoint(a, distA, c, distC);
+        ++points;
+    }
+    if (distB * distC < 0) {
+        addEdgePoint(b, distB, c, distC);
+        ++points;
+    }
+    if (points == 2) {
+        clipIndices.push_back(first);
+        clipIndices.push_back(first + 1);
+    } else {
+        clipPositions.resize(3 * first);
+        clipColors.resize(4 * first);
+    }
+}
@@ -3,10 +3,37 @@
 #include "duality/CoordinateSystem.h"
 #include "src/duality/G3D.h"
 
+class GeometryDataset;
+class TriangleSliceIndex;
+
 class GeometryUtil {
 public:
+    // emits the lines of the triangles in their order; a triangle that lies in the plane contributes its outline, a triangle that only
+    // touches the plane in a single vertex contributes nothing
     static std::unique_ptr<G3D::GeometrySoA> clipGeometry(const G3D::GeometrySoA& geo, CoordinateAxis axis, float position);
+    // clips against the plane dot(plane.xyz, p) + plane.w = 0
+    static std::unique_ptr<G3D::GeometrySoA> clipGeometry(const G3D::GeometrySoA& geo, const IVDA::Vec4f& plane);
+    // clips a dataset that is placed into the scene by modelMatrix against the world space plane axis = position, visiting only
+    // triangles near the plane once the dataset's slice index is available; the resulting lines are in model space
+    static std::unique_ptr<G3D::GeometrySoA> clipGeometry(const GeometryDataset& dataset, const IVDA::Mat4f& modelMatrix,
+                                                          CoordinateAxis axis, float position);
+    // sliceIndex has to be built for geo and axis
+    static std::unique_ptr<G3D::GeometrySoA> clipGeometry(const G3D::GeometrySoA& geo, const TriangleSliceIndex& sliceIndex,
+                                                          CoordinateAxis axis, float position);
+
+    // the model space plane that corresponds to the world space plane axis = position, if it is axis aligned
+    static bool modelSpaceAxisPlane(const IVDA::Mat4f& modelMatrix, CoordinateAxis axis, float position, CoordinateAxis& modelAxis,
+                                    float& modelPosition);
 
 private:
-    static bool planeIntersection(const float* triPositions, const float* triColors, CoordinateAxis axis, float axisPosition, float* linePositions, float* lineColors, size_t& numberOfPoints);
+    struct Lines {
+        std::vector<uint32_t> indices;
+        std::vector<float> positions;
+        std::vector<float> colors;
+    };
+
+    // triangles lists the primitive indices to clip, nullptr clips the first numTriangles triangles of the geometry
+    static std::unique_ptr<G3D::GeometrySoA> clipTriangles(const G3D::GeometrySoA& geo, const uint32_t* triangles, size_t numTriangles,
+                                                           CoordinateAxis axis, float position);
+    static void clipTriangle(const G3D::GeometrySoA& geo, uint32_t triangle, const IVDA::Vec4f& plane, Lines& lines);
 };
\ No newline at end of file
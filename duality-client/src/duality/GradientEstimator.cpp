@@ -0,0 +1,210 @@
+#include "src/duality/GradientEstimator.h"
+
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace IVDA;
+
+bool GradientEstimator::hasGradients(const I3M::Volume& volume) {
+    return std::any_of(begin(volume.voxels), end(volume.voxels),
+                       [](const std::array<uint8_t, 4>& voxel) { return (voxel[0] | voxel[1] | voxel[2]) != 0; });
+}
+
+std::vector<uint8_t> GradientEstimator::dilatedScalars(const I3M::Volume& volume) {
+    const size_t sizeX = volume.info.size.x;
+    const size_t sizeY = volume.info.size.y;
+    const size_t sizeZ = volume.info.size.z;
+    const size_t sliceSize = sizeX * sizeY;
+    std::vector<uint8_t> dilated(volume.voxels.size());
+    std::vector<uint8_t> scratch(volume.voxels.size());
+    auto& pool = ThreadPool::instance();
+    // separable: along x into dilated, along y into scratch, along z into dilated
+    pool.parallelFor(0, sizeZ, 1, [&](size_t firstZ, size_t lastZ) {
+        for (size_t z = firstZ; z < lastZ; ++z) {
+            for (size_t y = 0; y < sizeY; ++y) {
+                const std::array<uint8_t, 4>* row = volume.voxels.data() + z * sliceSize + y * sizeX;
+                uint8_t* target = dilated.data() + z * sliceSize + y * sizeX;
+                for (size_t x = 0; x < sizeX; ++x) {
+                    target[x] = std::max({row[x > 0 ? x - 1 : x][3], row[x][3], row[std::min(x + 1, sizeX - 1)][3]});
+                }
+            }
+        }
+    });
+    pool.parallelFor(0, sizeZ, 1, [&](size_t firstZ, size_t lastZ) {
+        for (size_t z = firstZ; z < lastZ; ++z) {
+            for (size_t y = 0; y < sizeY; ++y) {
+                const uint8_t* previous = dilated.data() + z * sliceSize + (y > 0 ? y - 1 : y) * sizeX;
+                const uint8_t* current = dilated.data() + z * sliceSize + y * sizeX;
+                const uint8_t* next = dilated.data() + z * sliceSize + std::min(y + 1, sizeY - 1) * sizeX;
+                uint8_t* target = scratch.data() + z * sliceSize + y * sizeX;
+                for (size_t x = 0; x < sizeX; ++x) {
+                    target[x] = std::max({previous[x], current[x], next[x]});
+                }
+            }
+        }
+    });
+    pool.parallelFor(0, sizeZ, 1, [&](size_t firstZ, size_t lastZ) {
+        for (size_t z = firstZ; z < lastZ; ++z) {
+            const uint8_t* previous = scratch.data() + (z > 0 ? z - 1 : z) * sliceSize;
+            const uint8_t* current = scratch.data() + z * sliceSize;
+            const uint8_t* next = scratch.data() + std::min(z + 1, sizeZ - 1) * sliceSize;
+            uint8_t* target = dilated.data() + z * sliceSize;
+            for (size_t i = 0; i < sliceSize; ++i) {
+                target[i] = std::max({previous[i], current[i], next[i]});
+            }
+        }
+    });
+    return dilated;
+}
+
+void GradientEstimator::computeGradients(I3M::Volume& volume) {
+    const size_t sizeX = volume.info.size.x;
+    const size_t sizeY = volume.info.size.y;
+    const size_t sizeZ = volume.info.size.z;
+    const size_t sliceSize = sizeX * sizeY;
+    // distances between voxels, the gradients are computed in the space of the bounding box
+    const Vec3f spacing(volume.info.scale.x / sizeX, volume.info.scale.y / sizeY, volume.info.scale.z / sizeZ);
+    const std::vector<uint8_t> dilated = dilatedScalars(volume);
+
+    // one sided differences at the borders
+    std::vector<float> inverseDistanceX(sizeX);
+    for (size_t x = 0; x < sizeX; ++x) {
+        const size_t steps = std::min(x + 1, sizeX - 1) - (x > 0 ? x - 1 : x);
+        inverseDistanceX[x] = steps > 0 ? 1.0f / (steps * spacing.x) : 0.0f;
+    }
+
+    // every task writes the gradient channels of its slices and reads the scalar channel of the neighbouring ones, which are different
+    // memory locations
+    ThreadPool::instance().parallelFor(0, sizeZ, 1, [&](size_t firstZ, size_t lastZ) {
+        std::vector<float> gx(sizeX), gy(sizeX), gz(sizeX);
+        for (size_t z = firstZ; z < lastZ; ++z) {
+            const size_t previousZ = z > 0 ? z - 1 : z;
+            const size_t nextZ = std::min(z + 1, sizeZ - 1);
+            const float inverseDistanceZ = nextZ > previousZ ? 1.0f / ((nextZ - previousZ) * spacing.z) : 0.0f;
+            for (size_t y = 0; y < sizeY; ++y) {
+                const size_t previousY = y > 0 ? y - 1 : y;
+                const size_t nextY = std::min(y + 1, sizeY - 1);
+                const float inverseDistanceY = nextY > previousY ? 1.0f / ((nextY - previousY) * spacing.y) : 0.0f;
+                std::array<uint8_t, 4>* row = volume.voxels.data() + z * sliceSize + y * sizeX;
+                const std::array<uint8_t, 4>* rowY0 = volume.voxels.data() + z * sliceSize + previousY * sizeX;
+                const std::array<uint8_t, 4>* rowY1 = volume.voxels.data() + z * sliceSize + nextY * sizeX;
+                const std::array<uint8_t, 4>* rowZ0 = volume.voxels.data() + previousZ * sliceSize + y * sizeX;
+                const std::array<uint8_t, 4>* rowZ1 = volume.voxels.data() + nextZ * sliceSize + y * sizeX;
+                const uint8_t* dilatedRow = dilated.data() + z * sliceSize + y * sizeX;
+
+                // separate passes without branches, so that they are vectorized
+                gx[0] = (row[std::min<size_t>(1, sizeX - 1)][3] - row[0][3]) * inverseDistanceX[0];
+                for (size_t x = 1; x + 1 < sizeX; ++x) {
+                    gx[x] = (row[x + 1][3] - row[x - 1][3]) * inverseDistanceX[x];
+                }
+                if (sizeX > 1) {
+                    gx[sizeX - 1] = (row[sizeX - 1][3] - row[sizeX - 2][3]) * inverseDistanceX[sizeX - 1];
+                }
+                for (size_t x = 0; x < sizeX; ++x) {
+                    gy[x] = (rowY1[x][3] - rowY0[x][3]) * inverseDistanceY;
+                    gz[x] = (rowZ1[x][3] - rowZ0[x][3]) * inverseDistanceZ;
+                }
+                for (size_t x = 0; x < sizeX; ++x) {
+                    const float sqLength = gx[x] * gx[x] + gy[x] * gy[x] + gz[x] * gz[x];
+                    const float scale = sqLength > 0.0f ? 127.0f / std::sqrt(sqLength) : 0.0f;
+                    // empty neighbourhoods stay zero, all others are encoded around 128
+                    const float offset = dilatedRow[x] > 0 ? 128.5f : 0.0f;
+                    row[x][0] = static_cast<uint8_t>(offset + gx[x] * scale);
+                    row[x][1] = static_cast<uint8_t>(offset + gy[x] * scale);
+                    row[x][2] = static_cast<uint8_t>(offset + gz[x] * scale);
+                }
+            }
+        }
+    });
+}
+
+void GradientEstimator::computeSliceGradients(const I3M::Volume& volume, CoordinateAxis axis, size_t slice,
+                                              SliceStackBuilder::Texel* texels) {
+    // u and v are the axes within the slice, w is the axis of the stack
+    const Vec3ui size = volume.info.size;
+    const std::array<size_t, 3> strides = {{1, size.x, static_cast<size_t>(size.x) * size.y}};
+    const size_t axisU = axis == X_Axis ? 1 : 0;
+    const size_t axisV = axis == Z_Axis ? 1 : 2;
+    const size_t axisW = axis;
+    const size_t sizeU = size[axisU];
+    const size_t sizeV = size[axisV];
+    const size_t sizeW = size[axisW];
+    const Vec3f spacing(volume.info.scale.x / size.x, volume.info.scale.y / size.y, volume.info.scale.z / size.z);
+    auto inverseDistance = [](size_t i, size_t count, float spacing) {
+        const size_t steps = std::min(i + 1, count - 1) - (i > 0 ? i - 1 : i);
+        return steps > 0 ? 1.0f / (steps * spacing) : 0.0f;
+    };
+    std::vector<float> inverseDistanceU(sizeU);
+    for (size_t u = 0; u < sizeU; ++u) {
+        inverseDistanceU[u] = inverseDistance(u, sizeU, spacing[axisU]);
+    }
+    const float inverseDistanceW = inverseDistance(slice, sizeW, spacing[axisW]);
+
+    // differences along w and the maximum of the scalars over the neighbouring slices, then over the neighbouring texels
+    const std::array<uint8_t, 4>* previousSlice = volume.voxels.data() + (slice > 0 ? slice - 1 : slice) * strides[axisW];
+    const std::array<uint8_t, 4>* nextSlice = volume.voxels.data() + std::min(slice + 1, sizeW - 1) * strides[axisW];
+    std::vector<float> gw(sizeU * sizeV);
+    std::vector<uint8_t> dilated(sizeU * sizeV);
+    std::vector<uint8_t> scratch(sizeU * sizeV);
+    for (size_t v = 0; v < sizeV; ++v) {
+        for (size_t u = 0; u < sizeU; ++u) {
+            const size_t offset = u * strides[axisU] + v * strides[axisV];
+            const uint8_t previous = previousSlice[offset][3];
+            const uint8_t next = nextSlice[offset][3];
+            gw[v * sizeU + u] = (next - previous) * inverseDistanceW;
+            dilated[v * sizeU + u] = std::max({previous, texels[v * sizeU + u][3], next});
+        }
+    }
+    for (size_t v = 0; v < sizeV; ++v) {
+        const uint8_t* row = dilated.data() + v * sizeU;
+        for (size_t u = 0; u < sizeU; ++u) {
+            scratch[v * sizeU + u] = std::max({row[u > 0 ? u - 1 : u], row[u], row[std::min(u + 1, sizeU - 1)]});
+        }
+    }
+    for (size_t v = 0; v < sizeV; ++v) {
+        const uint8_t* previous = scratch.data() + (v > 0 ? v - 1 : v) * sizeU;
+        const uint8_t* current = scratch.data() + v * sizeU;
+        const uint8_t* next = scratch.data() + std::min(v + 1, sizeV - 1) * sizeU;
+        for (size_t u = 0; u < sizeU; ++u) {
+            dilated[v * sizeU + u] = std::max({previous[u], current[u], next[u]});
+        }
+    }
+
+    std::vector<float> gu(sizeU), gv(sizeU);
+    std::array<const float*, 3> gradient;
+    gradient[axisU] = gu.data();
+    gradient[axisV] = gv.data();
+    for (size_t v = 0; v < sizeV; ++v) {
+        const float inverseDistanceV = inverseDistance(v, sizeV, spacing[axisV]);
+        SliceStackBuilder::Texel* row = texels + v * sizeU;
+        const SliceStackBuilder::Texel* rowV0 = texels + (v > 0 ? v - 1 : v) * sizeU;
+        const SliceStackBuilder::Texel* rowV1 = texels + std::min(v + 1, sizeV - 1) * sizeU;
+        const uint8_t* dilatedRow = dilated.data() + v * sizeU;
+        gradient[axisW] = gw.data() + v * sizeU;
+
+        gu[0] = (row[std::min<size_t>(1, sizeU - 1)][3] - row[0][3]) * inverseDistanceU[0];
+        for (size_t u = 1; u + 1 < sizeU; ++u) {
+            gu[u] = (row[u + 1][3] - row[u - 1][3]) * inverseDistanceU[u];
+        }
+        if (sizeU > 1) {
+            gu[sizeU - 1] = (row[sizeU - 1][3] - row[sizeU - 2][3]) * inverseDistanceU[sizeU - 1];
+        }
+        for (size_t u = 0; u < sizeU; ++u) {
+            gv[u] = (rowV1[u][3] - rowV0[u][3]) * inverseDistanceV;
+        }
+        // encoded like computeGradients, with the components in x, y, z order
+        for (size_t u = 0; u < sizeU; ++u) {
+            const float gx = gradient[0][u];
+            const float gy = gradient[1][u];
+            const float gz = gradient[2][u];
+            const float sqLength = gx * gx + gy * gy + gz * gz;
+            const float scale = sqLength > 0.0f ? 127.0f / std::sqrt(sqLength) : 0.0f;
+            const float offset = dilatedRow[u] > 0 ? 128.5f : 0.0f;
+            row[u][0] = static_cast<uint8_t>(offset + gx * scale);
+            row[u][1] = static_cast<uint8_t>(offset + gy * scale);
+            row[u][2] = static_cast<uint8_t>(offset + gz * scale);
+        }
+    }
+}
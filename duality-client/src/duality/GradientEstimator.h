@@ -0,0 +1,22 @@
+#pragma once
+
+#include "duality/CoordinateSystem.h"
+#include "src/duality/I3M.h"
+#include "src/duality/SliceStackBuilder.h"
+
+// fills the gradient channels of volumes that only carry scalar values (alpha), as expected by the lit volume shaders: normalized
+// central differences of the scalars, encoded as 128 + 127 * n. Voxels whose 3x3x3 neighbourhood is zero keep all channels zero, so
+// that empty regions can still be stored sparsely.
+class GradientEstimator {
+public:
+    // true if any voxel has a non zero gradient channel
+    static bool hasGradients(const I3M::Volume& volume);
+    static void computeGradients(I3M::Volume& volume);
+    // the same for a single slice extracted by SliceStackBuilder from a volume without gradients, so that the gradients of a stack can
+    // be computed when it is first needed
+    static void computeSliceGradients(const I3M::Volume& volume, CoordinateAxis axis, size_t slice, SliceStackBuilder::Texel* texels);
+
+private:
+    // maximum of the scalars in the 3x3x3 neighbourhood of every voxel
+    static std::vector<uint8_t> dilatedScalars(const I3M::Volume& volume);
+};
@@ -2,7 +2,19 @@
 
 #include "duality/CoordinateSystem.h"
 #include "src/duality/GeometryDataset.h"
+#include "src/duality/GeometryNode.h"
 #include "src/duality/GeometryRenderer3D.h"
+#include "src/duality/MVP3D.h"
+#include "src/duality/ThreadPool.h"
+#include "src/duality/VolumeNode.h"
+
+#include <algorithm>
+
+namespace {
+const size_t primitivesPerBlock = 16 * 1024;
+// relative to the distance between the eye and the geometry
+const float eyeTolerance = 0.01f;
+}
 
 InterleavingRenderer3D::InterleavingRenderer3D()
     : m_geoRenderer(std::make_unique<GeometryRenderer3D>())
@@ -10,86 +22,174 @@ InterleavingRenderer3D::InterleavingRenderer3D()
 
 InterleavingRenderer3D::~InterleavingRenderer3D() = default;
 
-void InterleavingRenderer3D::render(const VolumeDataset& volumeDataset, const std::vector<const GeometryDataset*>& geometryDatasets,
-                                    const MVP3D& mvp, const TransferFunction& tf) {
+void InterleavingRenderer3D::render(const VolumeNode& volumeNode, const std::vector<GeometryInstance>& geometryInstances,
+                                    const MVP3D& mvp, size_t level, size_t stride) {
+    const VolumeDataset& volumeDataset = volumeNode.dataset();
+    std::vector<MVP3D> instanceMvps;
+    for (const auto& instance : geometryInstances) {
+        instanceMvps.push_back(mvp.instanced(instance.modelMatrix));
+    }
+
     // sort primitives in between slices
-    StackDirection stackDir = duality::determineStackDirection(static_cast<IVDA::Mat4f>(mvp.mv()));
-    std::vector<SlapAssignment> slapAssignments = calculateSlapAssignments(volumeDataset, geometryDatasets, stackDir, mvp);
+    const StackDirection& stackDir = mvp.stackDirection();
+    volumeDataset.prefetchStack(mvp.secondaryStackAxis(), level);
+    updateSlabAssignments(volumeNode, geometryInstances, instanceMvps, stackDir, level);
 
     // alternate rendering of slices and geometries between slices
-    const auto& sliceInfos = volumeDataset.sliceInfos()[stackDir.direction];
+    const auto& sliceInfos = volumeDataset.sliceInfos(level)[stackDir.direction];
     size_t numSlices = sliceInfos.size();
     for (size_t i = 0; i < numSlices; ++i) {
         const size_t sliceIndex = stackDir.reverse ? numSlices - i : i;
-        renderGeometries(geometryDatasets, mvp, sliceIndex, slapAssignments);
-        m_volRenderer->renderPartial(volumeDataset, mvp, tf, stackDir, i);
+        renderGeometries(geometryInstances, instanceMvps, sliceIndex);
+        // geometry is interleaved with the skipped slices as well, which keeps its order relative to the drawn ones
+        if (i % stride == 0) {
+            m_volRenderer->renderPartial(volumeDataset, mvp, volumeNode.transferFunction(), stackDir, i, level, stride);
+        }
     }
     // render geometries in front of  / behind last slice
     const size_t sliceIndex = stackDir.reverse ? 0 : numSlices;
-    renderGeometries(geometryDatasets, mvp, sliceIndex, slapAssignments);
+    renderGeometries(geometryInstances, instanceMvps, sliceIndex);
 }
 
-std::vector<InterleavingRenderer3D::SlapAssignment>
-InterleavingRenderer3D::calculateSlapAssignments(const VolumeDataset& volumeDataset,
-                                                 const std::vector<const GeometryDataset*>& geometryDatasets,
-                                                 const StackDirection& stackDir, const MVP3D& mvp) {
-    const auto& sliceInfos = volumeDataset.sliceInfos()[stackDir.direction];
-    float minDepth = sliceInfos[0].depth;
-    float maxDepth = sliceInfos[sliceInfos.size() - 1].depth;
-    float stackDepth = maxDepth - minDepth;
-    size_t numSlices = sliceInfos.size();
+void InterleavingRenderer3D::releaseUnusedAssignments(const std::vector<Intersection>& intersections) {
+    for (auto it = begin(m_slabAssignments); it != end(m_slabAssignments);) {
+        const SlabAssignmentKey& key = it->first;
+        const bool used = std::any_of(begin(intersections), end(intersections), [&](const Intersection& intersection) {
+            return std::get<0>(intersection) == std::get<0>(key) && std::get<1>(intersection) == std::get<1>(key) &&
+                   std::get<2>(key) < std::get<2>(intersection);
+        });
+        it = used ? std::next(it) : m_slabAssignments.erase(it);
+    }
+}
+
+bool InterleavingRenderer3D::StackState::operator==(const StackState& other) const {
+    return dataset == other.dataset && direction == other.direction && numSlices == other.numSlices && minDepth == other.minDepth &&
+           maxDepth == other.maxDepth;
+}
+
+void InterleavingRenderer3D::updateSlabAssignments(const VolumeNode& volumeNode, const std::vector<GeometryInstance>& geometryInstances,
+                                                   const std::vector<MVP3D>& instanceMvps, const StackDirection& stackDir,
+                                                   size_t level) {
+    const VolumeDataset& volumeDataset = volumeNode.dataset();
+    const auto& sliceInfos = volumeDataset.sliceInfos(level)[stackDir.direction];
+    StackState stack{&volumeDataset, stackDir.direction, sliceInfos.size(), sliceInfos.front().depth, sliceInfos.back().depth};
 
-    std::vector<SlapAssignment> slapAssignments(geometryDatasets.size());
-
-    for (size_t geoIndex = 0; geoIndex < geometryDatasets.size(); ++geoIndex) {
-        const auto& ds = *geometryDatasets[geoIndex];
-        const auto& centroids = ds.centroids();
-        const auto& indices = ds.indicesTransparent();
-
-        auto permutation = duality::backToFrontPermutation(centroids, mvp.eyePos());
-        
-        std::vector<IVDA::Vec3f> sortedCentroids;
-        duality::applyPermutation<1>(permutation, centroids, sortedCentroids);
-
-        std::vector<uint32_t> indicesSorted;
-        if (ds.geometry().info.primitiveType == G3D::Point) {
-            duality::applyPermutation<1>(permutation, indices, indicesSorted);
-        } else if (ds.geometry().info.primitiveType == G3D::Line) {
-            duality::applyPermutation<2>(permutation, indices, indicesSorted);
-        } else if (ds.geometry().info.primitiveType == G3D::Triangle) {
-            duality::applyPermutation<3>(permutation, indices, indicesSorted);
+    m_currentAssignments.clear();
+    for (size_t geoIndex = 0; geoIndex < geometryInstances.size(); ++geoIndex) {
+        const GeometryInstance& instance = geometryInstances[geoIndex];
+        const SlabAssignmentKey key(&volumeNode, instance.node, instance.index);
+        auto inserted = m_slabAssignments.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple());
+        SlabAssignment& assignment = inserted.first->second;
+        const IVDA::Vec3f eyePos = instanceMvps[geoIndex].eyePos();
+        if (inserted.second || !isUpToDate(assignment, instance, eyePos, stack)) {
+            calculateSlabAssignment(assignment, instance, eyePos, stack);
         }
+        m_currentAssignments.push_back(&assignment);
+    }
+}
+
+bool InterleavingRenderer3D::isUpToDate(const SlabAssignment& assignment, const GeometryInstance& instance, const IVDA::Vec3f& eyePos,
+                                        const StackState& stack) {
+    const auto& ds = *instance.dataset;
+    if (!(assignment.stack == stack) || assignment.generation != ds.generation() ||
+        !std::equal(instance.modelMatrix.array, instance.modelMatrix.array + 16, assignment.modelMatrix.array)) {
+        return false;
+    }
+    // the order within the slabs only changes noticeably if the eye moves relative to its distance from the geometry
+    const BoundingBox bounds = ds.boundingBox();
+    const IVDA::Vec3f center = (bounds.min + bounds.max) * 0.5f;
+    return (eyePos - assignment.eyePos).length() <= eyeTolerance * (assignment.eyePos - center).length();
+}
+
+void InterleavingRenderer3D::calculateSlabAssignment(SlabAssignment& assignment, const GeometryInstance& instance,
+                                                     const IVDA::Vec3f& eyePos, const StackState& stack) {
+    const auto& ds = *instance.dataset;
+    const auto transparency = instance.node->transparency();
+    const auto& centroids = ds.centroids(transparency);
+    const auto& indices = ds.indicesTransparent(transparency);
+    const size_t ipp = duality::indicesPerPrimitive(ds);
+    const size_t numPrimitives = centroids.size();
+    const size_t numSlabs = stack.numSlices + 1;
+    const float stackDepth = stack.maxDepth - stack.minDepth;
+    // centroids are in model space, slices in world space
+    const auto& model = instance.modelMatrix;
+    const IVDA::Vec4f depthRow(model.array[4 * stack.direction], model.array[4 * stack.direction + 1], model.array[4 * stack.direction + 2],
+                               model.array[4 * stack.direction + 3]);
+
+    const auto& permutation = ds.backToFrontOrder(eyePos, assignment.sorter, transparency);
+
+    // counting sort of the back to front order by slab, which keeps the order within each slab
+    const size_t numBlocks = std::max<size_t>(1, (numPrimitives + primitivesPerBlock - 1) / primitivesPerBlock);
+    assignment.slabs.resize(numPrimitives);
+    assignment.blockCounts.assign(numBlocks * numSlabs, 0);
+    auto& pool = ThreadPool::instance();
+    pool.parallelFor(0, numBlocks, 1, [&](size_t firstBlock, size_t endBlock) {
+        for (size_t block = firstBlock; block < endBlock; ++block) {
+            uint32_t* counts = &assignment.blockCounts[block * numSlabs];
+            const size_t end = std::min(numPrimitives, (block + 1) * primitivesPerBlock);
+            for (size_t i = block * primitivesPerBlock; i < end; ++i) {
+                const auto& centroid = centroids[permutation[i]];
+                float centroidDepth = depthRow.x * centroid.x + depthRow.y * centroid.y + depthRow.z * centroid.z + depthRow.w;
 
-        for (size_t centroidIndex = 0; centroidIndex < sortedCentroids.size(); ++centroidIndex) {
-            const auto& centroid = sortedCentroids[centroidIndex];
-            float centroidDepth = centroid[stackDir.direction];
-
-            size_t slapIndex;
-            if (centroidDepth <= minDepth) {
-                slapIndex = 0;
-            } else if (centroidDepth >= maxDepth) {
-                slapIndex = numSlices;
-            } else {
-                slapIndex = 1 + size_t(std::min<int>((int)numSlices - 1,
-                                                     std::max<int>(0, int((numSlices - 1) * (centroidDepth - minDepth) / stackDepth))));
+                size_t slabIndex;
+                if (centroidDepth <= stack.minDepth) {
+                    slabIndex = 0;
+                } else if (centroidDepth >= stack.maxDepth) {
+                    slabIndex = stack.numSlices;
+                } else {
+                    slabIndex = 1 + size_t(std::min<int>((int)stack.numSlices - 1,
+                                                         std::max<int>(0, int((stack.numSlices - 1) * (centroidDepth - stack.minDepth) /
+                                                                              stackDepth))));
+                }
+                assignment.slabs[i] = static_cast<uint32_t>(slabIndex);
+                ++counts[slabIndex];
             }
+        }
+    });
 
-            size_t ipp = duality::indicesPerPrimitive(ds);
-            auto indexStart = begin(indicesSorted) + ipp * centroidIndex;
-            auto indexEnd = indexStart + ipp;
-            std::copy(indexStart, indexEnd, std::back_inserter(slapAssignments[geoIndex][slapIndex]));
+    // slab major prefix sum: offsets of the slabs and of every block within a slab
+    assignment.offsets.resize(numSlabs + 1);
+    uint32_t offset = 0;
+    for (size_t slab = 0; slab < numSlabs; ++slab) {
+        assignment.offsets[slab] = offset * static_cast<uint32_t>(ipp);
+        for (size_t block = 0; block < numBlocks; ++block) {
+            const uint32_t count = assignment.blockCounts[block * numSlabs + slab];
+            assignment.blockCounts[block * numSlabs + slab] = offset;
+            offset += count;
         }
     }
-    return slapAssignments;
+    assignment.offsets[numSlabs] = offset * static_cast<uint32_t>(ipp);
+
+    assignment.indices.resize(numPrimitives * ipp);
+    pool.parallelFor(0, numBlocks, 1, [&](size_t firstBlock, size_t endBlock) {
+        for (size_t block = firstBlock; block < endBlock; ++block) {
+            uint32_t* offsets = &assignment.blockCounts[block * numSlabs];
+            const size_t end = std::min(numPrimitives, (block + 1) * primitivesPerBlock);
+            for (size_t i = block * primitivesPerBlock; i < end; ++i) {
+                const size_t target = offsets[assignment.slabs[i]]++ * ipp;
+                const size_t source = permutation[i] * ipp;
+                for (size_t j = 0; j < ipp; ++j) {
+                    assignment.indices[target + j] = indices[source + j];
+                }
+            }
+        }
+    });
+
+    assignment.generation = ds.generation();
+    assignment.modelMatrix = instance.modelMatrix;
+    assignment.eyePos = eyePos;
+    assignment.stack = stack;
 }
 
-void InterleavingRenderer3D::renderGeometries(const std::vector<const GeometryDataset*>& geometryDatasets, const MVP3D& mvp,
-                                              const size_t sliceIndex, const std::vector<SlapAssignment>& slapAssignments) {
-    for (size_t geoIndex = 0; geoIndex < geometryDatasets.size(); ++geoIndex) {
-        if (slapAssignments[geoIndex].count(sliceIndex)) {
-            const auto& ds = *geometryDatasets[geoIndex];
-            const std::vector<uint32_t>& indices = slapAssignments[geoIndex].find(sliceIndex)->second;
-            m_geoRenderer->renderTransparentPartial(ds, mvp, indices);
+void InterleavingRenderer3D::renderGeometries(const std::vector<GeometryInstance>& geometryInstances,
+                                              const std::vector<MVP3D>& instanceMvps, const size_t sliceIndex) {
+    for (size_t geoIndex = 0; geoIndex < geometryInstances.size(); ++geoIndex) {
+        const auto& assignment = *m_currentAssignments[geoIndex];
+        const uint32_t first = assignment.offsets[sliceIndex];
+        const uint32_t end = assignment.offsets[sliceIndex + 1];
+        if (first != end) {
+            m_geoRenderer->renderTransparentPartial(*geometryInstances[geoIndex].node, instanceMvps[geoIndex],
+                                                    assignment.indices.data() + first, end - first);
         }
     }
-}
\ No newline at end of file
+}
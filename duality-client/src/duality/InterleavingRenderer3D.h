@@ -1,35 +1,84 @@
 #pragma once
 
+#include "src/duality/DepthSorter.h"
 #include "src/duality/VolumeDataset.h"
 #include "src/duality/VolumeRenderer3D.h"
 
+#include <map>
 #include <memory>
-#include <unordered_map>
+#include <tuple>
 #include <vector>
 
 class GeometryDataset;
+class GeometryNode;
 class GeometryRenderer3D;
 class MVP3D;
-class TransferFunction;
+class VolumeNode;
+
+struct GeometryInstance {
+    const GeometryNode* node;
+    // of the instance within the node
+    size_t index;
+    const GeometryDataset* dataset;
+    IVDA::Mat4f modelMatrix;
+};
 
 class InterleavingRenderer3D {
 public:
     InterleavingRenderer3D();
     ~InterleavingRenderer3D();
 
-    void render(const VolumeDataset& volumeDataset, const std::vector<const GeometryDataset*>& geometryDatasets, const MVP3D& mvp,
-                const TransferFunction& tf);
+    void render(const VolumeNode& volumeNode, const std::vector<GeometryInstance>& geometryInstances, const MVP3D& mvp, size_t level,
+                size_t stride);
+    // (volume node, intersecting geometry node, number of instances of the geometry node)
+    using Intersection = std::tuple<const VolumeNode*, const GeometryNode*, size_t>;
+    // drops the slab assignments of all instances that are not part of one of the intersections
+    void releaseUnusedAssignments(const std::vector<Intersection>& intersections);
 
 private:
-    using SlapAssignment = std::unordered_map<size_t, std::vector<uint32_t>>;
+    struct StackState {
+        const VolumeDataset* dataset;
+        CoordinateAxis direction;
+        size_t numSlices;
+        float minDepth;
+        float maxDepth;
+
+        bool operator==(const StackState& other) const;
+    };
+    // the transparent indices of a geometry instance grouped by the slab between two slices, back to front within each slab; slab s
+    // occupies [offsets[s], offsets[s + 1]) of indices
+    struct SlabAssignment {
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> offsets;
+        // the state the assignment was calculated for
+        uint64_t generation;
+        IVDA::Mat4f modelMatrix;
+        IVDA::Vec3f eyePos;
+        StackState stack;
+        // keeps the back to front order of the instance for the next calculation
+        DepthSorter sorter;
+        // scratch buffers
+        std::vector<uint32_t> slabs;
+        std::vector<uint32_t> blockCounts;
+    };
+    // (volume node, geometry node, instance index)
+    using SlabAssignmentKey = std::tuple<const VolumeNode*, const GeometryNode*, size_t>;
 
-    std::vector<SlapAssignment> calculateSlapAssignments(const VolumeDataset& volumeDataset,
-                                                         const std::vector<const GeometryDataset*>& geometryDatasets,
-                                                         const StackDirection& stackDir, const MVP3D& mvp);
-    void renderGeometries(const std::vector<const GeometryDataset*>& geometryDatasets, const MVP3D& mvp, const size_t sliceIndex,
-                          const std::vector<SlapAssignment>& slapAssignments);
+    void updateSlabAssignments(const VolumeNode& volumeNode, const std::vector<GeometryInstance>& geometryInstances,
+                               const std::vector<MVP3D>& instanceMvps, const StackDirection& stackDir, size_t level);
+    static bool isUpToDate(const SlabAssignment& assignment, const GeometryInstance& instance, const IVDA::Vec3f& eyePos,
+                           const StackState& stack);
+    static void calculateSlabAssignment(SlabAssignment& assignment, const GeometryInstance& instance, const IVDA::Vec3f& eyePos,
+                                        const StackState& stack);
+    void renderGeometries(const std::vector<GeometryInstance>& geometryInstances, const std::vector<MVP3D>& instanceMvps,
+                          const size_t sliceIndex);
 
 private:
     std::unique_ptr<GeometryRenderer3D> m_geoRenderer;
     std::unique_ptr<VolumeRenderer3D> m_volRenderer;
+    // kept across frames per volume node and geometry instance, since every volume has its own stack; only recalculated if the stack,
+    // the geometry or the view changed noticeably
+    std::map<SlabAssignmentKey, SlabAssignment> m_slabAssignments;
+    // the assignments of the geometry instances of the current render call
+    std::vector<const SlabAssignment*> m_currentAssignments;
 };
\ No newline at end of file
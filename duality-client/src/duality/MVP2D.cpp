@@ -86,6 +86,12 @@ const GLMatrix& MVP2D::mvp() const {
     return m_mvp;
 }
 
+MVP2D MVP2D::instanced(const IVDA::Mat4f& modelMatrix) const {
+    MVP2D result(*this);
+    result.m_mvp.multiplyLeft(GLMatrix(modelMatrix.Transpose().array));
+    return result;
+}
+
 Mat3i MVP2D::getSliceViewerBasis(const Axis viewerUp, const Axis viewerFace) {
     const auto viewerUpVec = duality::axisToVector(viewerUp);     // y
     const auto viewerFaceVec = duality::axisToVector(viewerFace); // z
@@ -13,6 +13,9 @@ public:
     void updateParameters(const RenderParameters2D& parameters);
     const GLMatrix& mvp() const;
 
+    // matrix for an object that is placed into the scene by modelMatrix (column vector convention, see G3D::applyTransform)
+    MVP2D instanced(const IVDA::Mat4f& modelMatrix) const;
+
 private:
     static IVDA::Mat3i getSliceViewMatrix(const CoordinateAxis axis);
     static IVDA::Mat3i getSliceViewerBasis(const Axis viewerUp, const Axis viewerFace);
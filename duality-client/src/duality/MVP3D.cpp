@@ -1,10 +1,14 @@
 #include "src/duality/MVP3D.h"
 
+#include <algorithm>
+#include <cmath>
+
 using namespace IVDA;
 
 MVP3D::MVP3D(const ScreenInfo& screenInfo, const BoundingBox& boundingBox, const RenderParameters3D& parameters) {
     createDefaultModelView(boundingBox);
     createProjection(screenInfo);
+    m_viewportSize = Vec2f(screenInfo.width / screenInfo.standardDownSampleFactor, screenInfo.height / screenInfo.standardDownSampleFactor);
     updateParameters(parameters);
 }
 
@@ -14,6 +18,29 @@ void MVP3D::updateParameters(const RenderParameters3D& parameters) {
     m_mv.translate(parameters.transation().x, parameters.transation().y, parameters.transation().z);
     m_mvp = m_mv;
     m_mvp.multiply(m_projection);
+    updateDerived();
+}
+
+void MVP3D::updateDerived() {
+    m_mvInverse = static_cast<Mat4f>(m_mv).inverse();
+    m_mvpInverse = static_cast<Mat4f>(m_mvp).inverse();
+    // the eye sits at the origin of eye space and looks along -z
+    m_eyePos = (Vec4f(0, 0, 0, 1) * m_mvInverse).dehomo();
+    m_viewDirection = (Vec4f(0, 0, -1, 0) * m_mvInverse).xyz();
+    m_viewDirection.normalize();
+
+    // row vector convention: clip = p * mvp, so the planes are sums and differences of the columns (Gribb/Hartmann)
+    auto column = [&](int j) { return Vec4f(m_mvp[0][j], m_mvp[1][j], m_mvp[2][j], m_mvp[3][j]); };
+    const Vec4f w = column(3);
+    for (int axis = 0; axis < 3; ++axis) {
+        m_frustumPlanes[2 * axis] = w + column(axis);
+        m_frustumPlanes[2 * axis + 1] = w - column(axis);
+    }
+    m_stackDirection = duality::determineStackDirection(static_cast<Mat4f>(m_mv));
+    const int first = (m_stackDirection.direction + 1) % 3;
+    const int second = (m_stackDirection.direction + 2) % 3;
+    const bool firstDominates = std::fabs(m_viewDirection[first]) >= std::fabs(m_viewDirection[second]);
+    m_secondaryStackAxis = static_cast<CoordinateAxis>(firstDominates ? first : second);
 }
 
 const GLMatrix& MVP3D::mv() const {
@@ -45,8 +72,115 @@ void MVP3D::createProjection(const ScreenInfo& screenInfo) {
     m_projection.frustum(-frustSize, frustSize, -frustSize * aspectRatio, frustSize * aspectRatio, zNear, zFar);
 }
 
-IVDA::Vec3f MVP3D::eyePos() const {
-    Vec4f eyePos(0, 0, 0, 1);
-    eyePos = eyePos * static_cast<Mat4f>(m_mvp).inverse();
-    return eyePos.dehomo();
+MVP3D MVP3D::instanced(const IVDA::Mat4f& modelMatrix) const {
+    GLMatrix model(modelMatrix.Transpose().array);
+    MVP3D result(*this);
+    result.m_mv.multiplyLeft(model);
+    result.m_mvp.multiplyLeft(model);
+    result.updateDerived();
+    return result;
+}
+
+const IVDA::Mat4f& MVP3D::mvInverse() const {
+    return m_mvInverse;
+}
+
+const IVDA::Mat4f& MVP3D::mvpInverse() const {
+    return m_mvpInverse;
+}
+
+const IVDA::Vec3f& MVP3D::eyePos() const {
+    return m_eyePos;
+}
+
+const IVDA::Vec3f& MVP3D::viewDirection() const {
+    return m_viewDirection;
+}
+
+const std::array<IVDA::Vec4f, 6>& MVP3D::frustumPlanes() const {
+    return m_frustumPlanes;
+}
+
+bool MVP3D::intersectsFrustum(const BoundingBox& box) const {
+    // the box is outside if its corner farthest along a plane normal is behind that plane
+    for (const auto& plane : m_frustumPlanes) {
+        const Vec3f corner(plane.x >= 0 ? box.max.x : box.min.x, plane.y >= 0 ? box.max.y : box.min.y,
+                           plane.z >= 0 ? box.max.z : box.min.z);
+        if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float MVP3D::screenFootprint(const BoundingBox& box) const {
+    const Mat4f mvp = static_cast<Mat4f>(m_mvp);
+    Vec2f minNdc(1.0f, 1.0f);
+    Vec2f maxNdc(-1.0f, -1.0f);
+    for (int i = 0; i < 8; ++i) {
+        const Vec4f corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z, 1.0f);
+        const Vec4f clip = corner * mvp;
+        if (clip.w <= 0.0f) {
+            return std::max(m_viewportSize.x, m_viewportSize.y);
+        }
+        const Vec2f ndc(clip.x / clip.w, clip.y / clip.w);
+        minNdc.StoreMin(ndc);
+        maxNdc.StoreMax(ndc);
+    }
+    // clamped to the screen
+    const float width = std::max(0.0f, std::min(1.0f, maxNdc.x) - std::max(-1.0f, minNdc.x)) * 0.5f * m_viewportSize.x;
+    const float height = std::max(0.0f, std::min(1.0f, maxNdc.y) - std::max(-1.0f, minNdc.y)) * 0.5f * m_viewportSize.y;
+    return std::max(width, height);
+}
+
+const StackDirection& MVP3D::stackDirection() const {
+    return m_stackDirection;
+}
+
+CoordinateAxis MVP3D::secondaryStackAxis() const {
+    return m_secondaryStackAxis;
+}
+
+StackDirection duality::determineStackDirection(const IVDA::Mat4f& mv) {
+    Vec4f vertex0(-0.5f, -0.5f, 0.5f, 1.0f);
+    Vec4f vertex1(0.5f, -0.5f, 0.5f, 1.0f);
+    Vec4f vertex3(-0.5f, 0.5f, 0.5f, 1.0f);
+    Vec4f vertex4(-0.5f, -0.5f, -0.5f, 1.0f);
+    Vec4f vertex6(0.5f, 0.5f, -0.5f, 1.0f);
+
+    Vec3f center = ((vertex0 * mv).xyz() + (vertex6 * mv).xyz()) / 2.0f;
+    Vec3f viewDir(0, 0, -2);
+
+    vertex0 = vertex0 * mv + viewDir;
+    vertex1 = vertex1 * mv + viewDir;
+    vertex3 = vertex3 * mv + viewDir;
+    vertex4 = vertex4 * mv + viewDir;
+    vertex6 = vertex6 * mv + viewDir;
+    center = center + viewDir;
+
+    Vec3f coordFrame[3] = {(vertex0.xyz() - vertex1.xyz()),  // X
+                           (vertex0.xyz() - vertex4.xyz()),  // Y
+                           (vertex0.xyz() - vertex3.xyz())}; // Z
+
+    for (size_t i = 0; i < 3; ++i) {
+        coordFrame[i].normalize();
+    }
+
+    float cosX = center ^ coordFrame[0];
+    float cosY = center ^ coordFrame[1];
+    float cosZ = center ^ coordFrame[2];
+
+    StackDirection result{CoordinateAxis::Y_Axis, cosZ < 0};
+
+    if (fabs(cosX) > fabs(cosY) && fabs(cosX) > fabs(cosZ)) {
+        result.direction = CoordinateAxis::X_Axis;
+        result.reverse = cosX < 0;
+    } else {
+        if (fabs(cosY) > fabs(cosX) && fabs(cosY) > fabs(cosZ)) {
+            result.direction = CoordinateAxis::Z_Axis;
+            result.reverse = cosY > 0;
+        }
+    }
+    
+    return result;
 }
\ No newline at end of file
@@ -2,10 +2,23 @@
 
 #include "IVDA/GLMatrix.h"
 #include "IVDA/Vectors.h"
+#include "duality/CoordinateSystem.h"
 #include "duality/ScreenInfo.h"
 #include "src/duality/BoundingBox.h"
 #include "src/duality/RenderParameters3D.h"
 
+#include <array>
+
+struct StackDirection {
+    CoordinateAxis direction;
+    bool reverse;
+};
+
+namespace duality {
+StackDirection determineStackDirection(const IVDA::Mat4f& mv);
+}
+
+// the camera of a frame: matrices together with the quantities derived from them, which are computed once whenever the matrices change
 class MVP3D {
 public:
     MVP3D() = default;
@@ -15,15 +28,41 @@ public:
     const GLMatrix& mv() const;
     const GLMatrix& mvp() const;
 
-    IVDA::Vec3f eyePos() const;
+    const IVDA::Mat4f& mvInverse() const;
+    const IVDA::Mat4f& mvpInverse() const;
+    // in model space, like the following
+    const IVDA::Vec3f& eyePos() const;
+    const IVDA::Vec3f& viewDirection() const;
+    // left, right, bottom, top, near, far; dot(plane.xyz, p) + plane.w >= 0 inside
+    const std::array<IVDA::Vec4f, 6>& frustumPlanes() const;
+    bool intersectsFrustum(const BoundingBox& box) const;
+    // the longer side in pixels of the screen rectangle that contains the projected box; boxes that reach behind the eye cover the
+    // whole screen
+    float screenFootprint(const BoundingBox& box) const;
+    const StackDirection& stackDirection() const;
+    // the stack axis that is likely to become active next when the view keeps rotating
+    CoordinateAxis secondaryStackAxis() const;
+
+    // matrices for an object that is placed into the scene by modelMatrix (column vector convention, see G3D::applyTransform)
+    MVP3D instanced(const IVDA::Mat4f& modelMatrix) const;
     
 private:
     void createDefaultModelView(const BoundingBox& boudningBox);
     void createProjection(const ScreenInfo& screenInfo);
+    void updateDerived();
 
 private:
     GLMatrix m_defaultModelView;
     GLMatrix m_projection;
+    // of the render target
+    IVDA::Vec2f m_viewportSize;
     GLMatrix m_mv;
     GLMatrix m_mvp;
+    IVDA::Mat4f m_mvInverse;
+    IVDA::Mat4f m_mvpInverse;
+    IVDA::Vec3f m_eyePos;
+    IVDA::Vec3f m_viewDirection;
+    std::array<IVDA::Vec4f, 6> m_frustumPlanes;
+    StackDirection m_stackDirection;
+    CoordinateAxis m_secondaryStackAxis;
 };
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "src/duality/PrimitiveBVH.h"
+
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+using namespace IVDA;
+
+namespace {
+const int numBins = 16;
+const uint32_t maxLeafSize = 8;
+const uint32_t parallelBinningThreshold = 1 << 16;
+// beyond this depth nodes are split at the median, which bounds the depth of the tree and the traversal stack
+const int maxSahDepth = 64;
+
+BoundingBox emptyBox() {
+    const float inf = std::numeric_limits<float>::max();
+    return BoundingBox{Vec3f(inf, inf, inf), Vec3f(-inf, -inf, -inf)};
+}
+
+void extend(BoundingBox& box, const BoundingBox& other) {
+    box.min.StoreMin(other.min);
+    box.max.StoreMax(other.max);
+}
+
+float surfaceArea(const BoundingBox& box) {
+    const Vec3f size = box.max - box.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+struct Bin {
+    BoundingBox bounds = emptyBox();
+    uint32_t count = 0;
+};
+using Bins = std::array<Bin, numBins>;
+}
+
+void PrimitiveBVH::build(const G3D::GeometrySoA& geometry, uint32_t indicesPerPrimitive) {
+    clear();
+    const uint32_t numPrimitives = geometry.info.numberIndices / indicesPerPrimitive;
+    if (numPrimitives == 0) {
+        return;
+    }
+
+    const float* positions = geometry.positions;
+    const uint32_t* indices = geometry.indices.data();
+    m_primitiveBounds.resize(numPrimitives);
+    m_primitiveCentroids.resize(numPrimitives);
+    m_primitives.resize(numPrimitives);
+    ThreadPool::instance().parallelFor(0, numPrimitives, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t primitive = begin; primitive < end; ++primitive) {
+            BoundingBox bounds = emptyBox();
+            for (uint32_t j = 0; j < indicesPerPrimitive; ++j) {
+                const Vec3f pos(positions + 3 * indices[primitive * indicesPerPrimitive + j]);
+                bounds.min.StoreMin(pos);
+                bounds.max.StoreMax(pos);
+            }
+            m_primitiveBounds[primitive] = bounds;
+            m_primitiveCentroids[primitive] = (bounds.min + bounds.max) * 0.5f;
+            m_primitives[primitive] = static_cast<uint32_t>(primitive);
+        }
+    });
+
+    m_nodes.reserve(2 * numPrimitives / maxLeafSize + 1);
+    buildNode(0, numPrimitives, 0);
+
+    m_primitiveBounds = std::vector<BoundingBox>();
+    m_primitiveCentroids = std::vector<Vec3f>();
+}
+
+uint32_t PrimitiveBVH::buildNode(uint32_t begin, uint32_t end, int depth) {
+    const uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(Node{emptyBox(), begin, end - begin});
+
+    BoundingBox bounds = emptyBox();
+    BoundingBox centroidBounds = emptyBox();
+    for (uint32_t i = begin; i < end; ++i) {
+        extend(bounds, m_primitiveBounds[m_primitives[i]]);
+        centroidBounds.min.StoreMin(m_primitiveCentroids[m_primitives[i]]);
+        centroidBounds.max.StoreMax(m_primitiveCentroids[m_primitives[i]]);
+    }
+    m_nodes[nodeIndex].bounds = bounds;
+
+    const uint32_t count = end - begin;
+    const Vec3f extent = centroidBounds.max - centroidBounds.min;
+    const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    if (count <= maxLeafSize || extent[axis] <= 0.0f) {
+        return nodeIndex;
+    }
+
+    uint32_t mid = begin;
+    if (depth < maxSahDepth) {
+        // binned SAH along the axis with the largest centroid extent
+        const float binScale = numBins / extent[axis] * (1.0f - 1e-5f);
+        const float axisMin = centroidBounds.min[axis];
+        auto binIndex = [&](uint32_t primitive) {
+            return std::min(numBins - 1, static_cast<int>((m_primitiveCentroids[primitive][axis] - axisMin) * binScale));
+        };
+        auto fillBins = [&](uint32_t rangeBegin, uint32_t rangeEnd, Bins& bins) {
+            for (uint32_t i = rangeBegin; i < rangeEnd; ++i) {
+                Bin& bin = bins[binIndex(m_primitives[i])];
+                extend(bin.bounds, m_primitiveBounds[m_primitives[i]]);
+                ++bin.count;
+            }
+        };
+
+        Bins bins;
+        if (count >= parallelBinningThreshold) {
+            const uint32_t grainSize = parallelBinningThreshold / 4;
+            std::vector<Bins> partialBins((count + grainSize - 1) / grainSize);
+            ThreadPool::instance().parallelFor(begin, end, grainSize, [&](size_t rangeBegin, size_t rangeEnd) {
+                fillBins(static_cast<uint32_t>(rangeBegin), static_cast<uint32_t>(rangeEnd), partialBins[(rangeBegin - begin) / grainSize]);
+            });
+            for (const auto& partial : partialBins) {
+                for (int b = 0; b < numBins; ++b) {
+                    extend(bins[b].bounds, partial[b].bounds);
+                    bins[b].count += partial[b].count;
+                }
+            }
+        } else {
+            fillBins(begin, end, bins);
+        }
+
+        // sweep from the right to get the cost of every right side, then from the left to find the cheapest split
+        std::array<float, numBins> rightCost;
+        BoundingBox rightBounds = emptyBox();
+        uint32_t rightCount = 0;
+        for (int b = numBins - 1; b > 0; --b) {
+            extend(rightBounds, bins[b].bounds);
+            rightCount += bins[b].count;
+            rightCost[b] = rightCount > 0 ? rightCount * surfaceArea(rightBounds) : 0.0f;
+        }
+        BoundingBox leftBounds = emptyBox();
+        uint32_t leftCount = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        int bestSplit = -1;
+        for (int b = 1; b < numBins; ++b) {
+            extend(leftBounds, bins[b - 1].bounds);
+            leftCount += bins[b - 1].count;
+            if (leftCount == 0 || leftCount == count) {
+                continue;
+            }
+            const float cost = leftCount * surfaceArea(leftBounds) + rightCost[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        if (bestSplit < 0) {
+            return nodeIndex;
+        }
+        // a leaf is cheaper than any split
+        if (count <= 2 * maxLeafSize && bestCost >= count * surfaceArea(bounds)) {
+            return nodeIndex;
+        }
+        mid = static_cast<uint32_t>(std::partition(m_primitives.begin() + begin, m_primitives.begin() + end,
+                                                   [&](uint32_t primitive) { return binIndex(primitive) < bestSplit; }) -
+                                    m_primitives.begin());
+    }
+
+    if (mid == begin || mid == end) {
+        mid = begin + count / 2;
+        std::nth_element(m_primitives.begin() + begin, m_primitives.begin() + mid, m_primitives.begin() + end,
+                         [&](uint32_t lhs, uint32_t rhs) { return m_primitiveCentroids[lhs][axis] < m_primitiveCentroids[rhs][axis]; });
+    }
+
+    buildNode(begin, mid, depth + 1);
+    const uint32_t secondChild = buildNode(mid, end, depth + 1);
+    m_nodes[nodeIndex].offset = secondChild;
+    m_nodes[nodeIndex].count = 0;
+    return nodeIndex;
+}
+
+void PrimitiveBVH::clear() {
+    m_nodes.clear();
+    m_primitives.clear();
+}
+
+bool PrimitiveBVH::empty() const {
+    return m_nodes.empty();
+}
+
+const std::vector<PrimitiveBVH::Node>& PrimitiveBVH::nodes() const {
+    return m_nodes;
+}
+
+const std::vector<uint32_t>& PrimitiveBVH::primitives() const {
+    return m_primitives;
+}
+
+bool PrimitiveBVH::intersectRay(const G3D::GeometrySoA& geometry, const Vec3f& origin, const Vec3f& direction, float& t,
+                                uint32_t& primitive) const {
+    if (m_nodes.empty() || geometry.info.primitiveType != G3D::Triangle) {
+        return false;
+    }
+    const Vec3f invDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float closest = std::numeric_limits<float>::max();
+    bool hit = false;
+
+    auto slabTest = [&](const BoundingBox& bounds) {
+        float tNear = 0.0f;
+        float tFar = closest;
+        for (int axis = 0; axis < 3; ++axis) {
+            float t0 = (bounds.min[axis] - origin[axis]) * invDirection[axis];
+            float t1 = (bounds.max[axis] - origin[axis]) * invDirection[axis];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            tNear = std::max(tNear, t0);
+            tFar = std::min(tFar, t1);
+        }
+        return tNear <= tFar;
+    };
+    // Moeller-Trumbore
+    auto triangleTest = [&](uint32_t candidate) {
+        const float* positions = geometry.positions;
+        const uint32_t* indices = geometry.indices.data() + 3 * candidate;
+        const Vec3f v0(positions + 3 * indices[0]);
+        const Vec3f e1 = Vec3f(positions + 3 * indices[1]) - v0;
+        const Vec3f e2 = Vec3f(positions + 3 * indices[2]) - v0;
+        const Vec3f p = direction % e2;
+        const float det = e1 ^ p;
+        if (std::abs(det) < std::numeric_limits<float>::epsilon()) {
+            return false;
+        }
+        const float invDet = 1.0f / det;
+        const Vec3f s = origin - v0;
+        const float u = (s ^ p) * invDet;
+        if (u < 0.0f || u > 1.0f) {
+            return false;
+        }
+        const Vec3f q = s % e1;
+        const float v = (direction ^ q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) {
+            return false;
+        }
+        const float tHit = (e2 ^ q) * invDet;
+        if (tHit >= 0.0f && tHit < closest) {
+            closest = tHit;
+            primitive = candidate;
+            hit = true;
+        }
+        return false;
+    };
+
+    traverse(slabTest, triangleTest);
+    if (hit) {
+        t = closest;
+    }
+    return hit;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "src/duality/BoundingBox.h"
+#include "src/duality/G3D.h"
+
+#include "IVDA/Vectors.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// bounding volume hierarchy over the primitives of a geometry; primitive i consists of the indices [i * ipp, (i + 1) * ipp)
+class PrimitiveBVH {
+public:
+    struct Node {
+        BoundingBox bounds;
+        uint32_t offset; // leaf: first entry in primitives(); inner node: index of the second child, the first child follows the node
+        uint32_t count;  // number of primitives in a leaf, 0 for inner nodes
+    };
+
+    void build(const G3D::GeometrySoA& geometry, uint32_t indicesPerPrimitive);
+    void clear();
+    bool empty() const;
+
+    const std::vector<Node>& nodes() const;
+    const std::vector<uint32_t>& primitives() const;
+
+    // calls visitor(primitive) for the primitives of all leaves that overlap the box, a superset of the primitives that overlap it;
+    // stops and returns true as soon as the visitor returns true
+    template <typename Visitor> bool visitOverlapping(const BoundingBox& box, Visitor visitor) const {
+        return traverse(
+            [&](const BoundingBox& bounds) {
+                return bounds.min.x <= box.max.x && bounds.max.x >= box.min.x && bounds.min.y <= box.max.y && bounds.max.y >= box.min.y &&
+                       bounds.min.z <= box.max.z && bounds.max.z >= box.min.z;
+            },
+            visitor);
+    }
+
+    // same for the leaves that touch the plane dot(plane.xyz, p) + plane.w = 0
+    template <typename Visitor> bool visitCrossing(const IVDA::Vec4f& plane, Visitor visitor) const {
+        return traverse(
+            [&](const BoundingBox& bounds) {
+                const IVDA::Vec3f center = (bounds.min + bounds.max) * 0.5f;
+                const IVDA::Vec3f extent = (bounds.max - bounds.min) * 0.5f;
+                const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+                const float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+                return std::abs(distance) <= radius;
+            },
+            visitor);
+    }
+
+    // closest hit of the ray origin + t * direction with a triangle of the geometry the hierarchy was built for; points and lines
+    // are never hit
+    bool intersectRay(const G3D::GeometrySoA& geometry, const IVDA::Vec3f& origin, const IVDA::Vec3f& direction, float& t,
+                      uint32_t& primitive) const;
+
+private:
+    static const int maxStackSize = 128;
+
+    template <typename NodeTest, typename Visitor> bool traverse(NodeTest nodeTest, Visitor visitor) const {
+        if (m_nodes.empty()) {
+            return false;
+        }
+        uint32_t stack[maxStackSize];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const uint32_t nodeIndex = stack[--stackSize];
+            const Node& node = m_nodes[nodeIndex];
+            if (!nodeTest(node.bounds)) {
+                continue;
+            }
+            if (node.count > 0) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                    if (visitor(m_primitives[i])) {
+                        return true;
+                    }
+                }
+            } else {
+                stack[stackSize++] = node.offset;
+                stack[stackSize++] = nodeIndex + 1;
+            }
+        }
+        return false;
+    }
+
+    uint32_t buildNode(uint32_t begin, uint32_t end, int depth);
+
+private:
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_primitives;
+    // per primitive data that is only needed during the build
+    std::vector<BoundingBox> m_primitiveBounds;
+    std::vector<IVDA::Vec3f> m_primitiveCentroids;
+};
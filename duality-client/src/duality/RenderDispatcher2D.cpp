@@ -40,23 +40,34 @@ void RenderDispatcher2D::render(const std::vector<std::unique_ptr<SceneNode>>& n
 
 void RenderDispatcher2D::dispatch(GeometryNode& node) {
     float depth = m_sliderParameter.depth();
-    m_geoRenderer->render(node.dataset(), m_mvp->mvp(), m_axis, depth);
+    for (const auto& instance : node.instances()) {
+        m_geoRenderer->render(node.dataset(), m_mvp->instanced(instance).mvp(), instance, m_axis, depth,
+                              m_settings->lineSimplificationPixels(), node.color());
+        if (!m_prefetchDepths.empty()) {
+            m_geoRenderer->prefetch(node.dataset(), instance, m_axis, m_prefetchDepths);
+        }
+    }
 }
 
 void RenderDispatcher2D::dispatch(VolumeNode& node) {
-    int slice;
-    if (m_sliderParameter.hasSlice()) {
-        slice = m_sliderParameter.slice();
-    } else {
-        BoundingBox bb = node.boundingBox();
-        int numSlices = static_cast<int>(node.dataset().sliceInfos()[m_axis].size());
-        float range = std::abs(bb.max[m_axis] - bb.min[m_axis]);
-        slice = std::min<int>((m_sliderParameter.depth() - bb.min[m_axis]) / range * numSlices, numSlices - 1);
-        if (slice < 0 || slice >= numSlices) {
-            return;
-        }
+    const int slice = sliceIndex(node, m_axis, m_sliderParameter);
+    if (slice >= 0) {
+        m_volRenderer->render(node.dataset(), m_mvp->mvp(), node.transferFunction(), m_axis, slice);
     }
-    m_volRenderer->render(node.dataset(), m_mvp->mvp(), node.transferFunction(), m_axis, slice);
+}
+
+int RenderDispatcher2D::sliceIndex(const VolumeNode& node, CoordinateAxis axis, const SliderParameter& sliderParameter) {
+    if (sliderParameter.hasSlice()) {
+        return sliderParameter.slice();
+    }
+    BoundingBox bb = node.boundingBox();
+    int numSlices = static_cast<int>(node.dataset().sliceInfos()[axis].size());
+    float range = std::abs(bb.max[axis] - bb.min[axis]);
+    int slice = std::min<int>((sliderParameter.depth() - bb.min[axis]) / range * numSlices, numSlices - 1);
+    if (slice < 0 || slice >= numSlices) {
+        return -1;
+    }
+    return slice;
 }
 
 void RenderDispatcher2D::startDraw() {
@@ -72,4 +83,8 @@ void RenderDispatcher2D::finishDraw() {
 
 void RenderDispatcher2D::setRedrawRequired() {
     m_redraw = true;
+}
+
+void RenderDispatcher2D::setPrefetchDepths(std::vector<float> depths) {
+    m_prefetchDepths = std::move(depths);
 }
\ No newline at end of file
@@ -21,10 +21,15 @@ public:
     void render(const std::vector<std::unique_ptr<SceneNode>>& nodes, const MVP2D& mvp, CoordinateAxis axis,
                 const SliderParameter& sliderParameter);
     void setRedrawRequired();
+    // depths whose contours are computed in the background after rendering, e.g. the neighbouring slices
+    void setPrefetchDepths(std::vector<float> depths);
 
     void dispatch(GeometryNode& node);
     void dispatch(VolumeNode& node);
 
+    // the slice of the node's volume at the slider position along axis, -1 if the position is outside of the volume
+    static int sliceIndex(const VolumeNode& node, CoordinateAxis axis, const SliderParameter& sliderParameter);
+
 private:
     void startDraw();
     void finishDraw();
@@ -37,5 +42,6 @@ private:
     const MVP2D* m_mvp;
     CoordinateAxis m_axis;
     SliderParameter m_sliderParameter;
+    std::vector<float> m_prefetchDepths;
     bool m_redraw;
 };
\ No newline at end of file
@@ -14,6 +14,13 @@
 #include <OpenGLES/ES3/gl.h>
 
 #include <algorithm>
+#include <cmath>
+
+namespace {
+// the frame rate controller does not go below this fraction of the slices
+const float minSamplingQuality = 0.1f;
+const float minSlices = 16.0f;
+}
 
 RenderDispatcher3D::RenderDispatcher3D(std::shared_ptr<GLFrameBufferObject> fbo, std::shared_ptr<Settings> settings)
     : m_fbo(fbo)
@@ -21,41 +28,73 @@ RenderDispatcher3D::RenderDispatcher3D(std::shared_ptr<GLFrameBufferObject> fbo,
     , m_volumeRenderer(std::make_unique<VolumeRenderer3D>())
     , m_interleavingRenderer(std::make_unique<InterleavingRenderer3D>())
     , m_settings(settings)
-    , m_redraw(true) {}
+    , m_redraw(true)
+    , m_interacting(false)
+    , m_volumeLevel(0)
+    , m_frameRateController(minSamplingQuality) {}
 
 RenderDispatcher3D::~RenderDispatcher3D() = default;
 
-std::vector<Renderable> RenderDispatcher3D::sortRenderables(const std::vector<Renderable>& renderables) {
-    std::vector<Renderable> result = renderables;
-    auto sorter = [&](const Renderable& lhs, const Renderable& rhs) {
-        IVDA::Vec3f eyePos = m_mvp->eyePos();
-        auto lhsBB = lhs.boundingBox();
-        auto lhsCenterEye = ((lhsBB.min + (lhsBB.max - lhsBB.min) / 2) - eyePos);
-        auto rhsBB = rhs.boundingBox();
-        auto rhsCenterEye = ((rhsBB.min + (rhsBB.max - rhsBB.min) / 2) - eyePos);
-        return lhsCenterEye.sqLength() > rhsCenterEye.sqLength();
-    };
-    std::sort(begin(result), end(result), sorter);
-    return result;
-}
-
-std::vector<Renderable> RenderDispatcher3D::calculateRenderables(const std::vector<std::unique_ptr<SceneNode>>& nodes) {
+RenderDispatcher3D::NodeState RenderDispatcher3D::nodeState(SceneNode* node, GeometryNode* geometryNode, VolumeNode* volumeNode) {
+    NodeState state{node, geometryNode, volumeNode, node->isVisibleInView(View::View3D), 0, 0};
+    if (geometryNode != nullptr) {
+        state.generation = geometryNode->dataset().generation();
+        state.instancesRevision = geometryNode->instancesRevision();
+    } else if (volumeNode != nullptr) {
+        state.generation = volumeNode->dataset().generation();
+    }
+    return state;
+}
+
+bool RenderDispatcher3D::renderablesOutdated(const std::vector<std::unique_ptr<SceneNode>>& nodes) const {
+    if (nodes.size() != m_nodeStates.size()) {
+        return true;
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const NodeState& cached = m_nodeStates[i];
+        if (nodes[i].get() != cached.node) {
+            return true;
+        }
+        const NodeState current = nodeState(cached.node, cached.geometryNode, cached.volumeNode);
+        if (current.visible != cached.visible || current.generation != cached.generation ||
+            current.instancesRevision != cached.instancesRevision) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RenderDispatcher3D::updateRenderables(const std::vector<std::unique_ptr<SceneNode>>& nodes) {
     // separate volume nodes and geometry nodes
+    m_nodeStates.clear();
     std::vector<VolumeNode*> volumeNodes;
     std::vector<GeometryNode*> geometryNodes;
     for (const auto& node : nodes) {
         VolumeNode* volumeNode = dynamic_cast<VolumeNode*>(node.get());
-        if (volumeNode != nullptr && volumeNode->isVisibleInView(View::View3D)) {
+        GeometryNode* geometryNode = dynamic_cast<GeometryNode*>(node.get());
+        m_nodeStates.push_back(nodeState(node.get(), geometryNode, volumeNode));
+        if (!m_nodeStates.back().visible) {
+            continue;
+        }
+        if (volumeNode != nullptr) {
             volumeNodes.push_back(volumeNode);
         }
-        GeometryNode* geometryNode = dynamic_cast<GeometryNode*>(node.get());
-        if (geometryNode != nullptr && geometryNode->isVisibleInView(View::View3D)) {
+        if (geometryNode != nullptr) {
             geometryNodes.push_back(geometryNode);
         }
     }
 
+    // sorters of removed nodes are dropped
+    for (auto it = begin(m_depthSorters); it != end(m_depthSorters);) {
+        const GeometryNode* geometryNode = it->first.first;
+        const bool present =
+            std::any_of(begin(nodes), end(nodes), [&](const std::unique_ptr<SceneNode>& n) { return n.get() == geometryNode; });
+        it = present ? std::next(it) : m_depthSorters.erase(it);
+    }
+
     // group intersecting volume nodes and geometry nodes into IntersectingNodes
-    std::vector<Renderable> result;
+    m_renderables.clear();
+    std::vector<InterleavingRenderer3D::Intersection> intersections;
     auto volIt = begin(volumeNodes);
     while (volIt != end(volumeNodes)) {
         IntersectingNode node;
@@ -67,17 +106,36 @@ std::vector<Renderable> RenderDispatcher3D::calculateRenderables(const std::vect
             std::copy(it, end(geometryNodes), std::back_inserter(node.geometryNodes));
             geometryNodes.erase(it, end(geometryNodes));
             volIt = volumeNodes.erase(volIt);
-            result.push_back(node);
+            m_renderables.push_back(node);
+            for (const GeometryNode* geometryNode : node.geometryNodes) {
+                intersections.emplace_back(volumeNode, geometryNode, geometryNode->instances().size());
+            }
         } else {
             ++volIt;
         }
     }
+    // assignments of hidden or removed nodes, of geometry that left the volume and of dropped instances are released
+    m_interleavingRenderer->releaseUnusedAssignments(intersections);
 
     // insert remaining geometry and volume nodes
-    std::copy(begin(geometryNodes), end(geometryNodes), std::back_inserter(result));
-    std::copy(begin(volumeNodes), end(volumeNodes), std::back_inserter(result));
+    std::copy(begin(geometryNodes), end(geometryNodes), std::back_inserter(m_renderables));
+    std::copy(begin(volumeNodes), end(volumeNodes), std::back_inserter(m_renderables));
 
-    return result;
+    m_renderableCenters.clear();
+    for (const auto& renderable : m_renderables) {
+        auto bb = renderable.boundingBox();
+        m_renderableCenters.push_back(bb.min + (bb.max - bb.min) / 2);
+    }
+}
+
+void RenderDispatcher3D::sortRenderables() {
+    IVDA::Vec3f eyePos = m_mvp->eyePos();
+    m_renderOrder.clear();
+    for (size_t i = 0; i < m_renderableCenters.size(); ++i) {
+        m_renderOrder.emplace_back((m_renderableCenters[i] - eyePos).sqLength(), i);
+    }
+    std::stable_sort(begin(m_renderOrder), end(m_renderOrder),
+                     [](const std::pair<float, size_t>& lhs, const std::pair<float, size_t>& rhs) { return lhs.first > rhs.first; });
 }
 
 void RenderDispatcher3D::render(const std::vector<std::unique_ptr<SceneNode>>& nodes, const MVP3D& mvp) {
@@ -87,32 +145,80 @@ void RenderDispatcher3D::render(const std::vector<std::unique_ptr<SceneNode>>& n
 
     m_mvp = &mvp;
 
-    auto renderables = calculateRenderables(nodes); // FIXME: cache renderables
-    auto sortedRenderables = sortRenderables(renderables);
+    if (renderablesOutdated(nodes)) {
+        updateRenderables(nodes);
+    }
+    sortRenderables();
     startDraw();
-    for (auto& r : sortedRenderables) {
-        r.render(*this);
+    for (const auto& entry : m_renderOrder) {
+        m_renderables[entry.second].render(*this);
     }
     finishDraw();
 }
 
 void RenderDispatcher3D::dispatch(GeometryNode& node) {
-    m_geoRenderer->renderOpaque(node.dataset(), *m_mvp);
+    // instances outside of the view frustum are skipped; their bounding boxes are tested in world space, so that the matrices of an
+    // instance are only derived if it is drawn
+    const BoundingBox datasetBox = node.dataset().boundingBox();
+    std::vector<MVP3D> instanceMvps;
+    std::vector<IVDA::Mat4f> instances;
+    std::vector<size_t> instanceIndices;
+    for (size_t i = 0; i < node.instances().size(); ++i) {
+        const auto& instance = node.instances()[i];
+        if (m_mvp->intersectsFrustum(duality::transformBoundingBox(datasetBox, instance))) {
+            instanceMvps.push_back(m_mvp->instanced(instance));
+            instances.push_back(instance);
+            instanceIndices.push_back(i);
+        }
+    }
+
+    for (const auto& mvp : instanceMvps) {
+        m_geoRenderer->renderOpaque(node, mvp);
+    }
     if (node.isTransparent()) {
-        m_geoRenderer->renderTransparent(node.dataset(), *m_mvp);
+        // transparent instances are blended back to front
+        std::vector<IVDA::Vec3f> centers;
+        for (const auto& instance : instances) {
+            BoundingBox bb = duality::transformBoundingBox(datasetBox, instance);
+            centers.push_back(bb.min + (bb.max - bb.min) / 2);
+        }
+        for (auto index : duality::backToFrontPermutation(centers, m_mvp->eyePos())) {
+            DepthSorter& sorter = m_depthSorters[std::make_pair(&node, instanceIndices[index])];
+            m_geoRenderer->renderTransparent(node, instanceMvps[index], sorter);
+        }
     }
 }
 
 void RenderDispatcher3D::dispatch(VolumeNode& node) {
-    m_volumeRenderer->render(node.dataset(), *m_mvp, node.transferFunction());
+    const size_t level = volumeLevel(node.dataset());
+    m_volumeRenderer->render(node.dataset(), *m_mvp, node.transferFunction(), level, sliceStride(node.dataset(), level));
 }
 
 void RenderDispatcher3D::dispatch(IntersectingNode& node) {
-    std::vector<const GeometryDataset*> geoDatasets;
+    std::vector<GeometryInstance> geoInstances;
     for (auto geoNode : node.geometryNodes) {
-        geoDatasets.push_back(&geoNode->dataset());
+        for (size_t i = 0; i < geoNode->instances().size(); ++i) {
+            geoInstances.push_back(GeometryInstance{geoNode, i, &geoNode->dataset(), geoNode->instances()[i]});
+        }
     }
-    m_interleavingRenderer->render(node.volumeNode->dataset(), geoDatasets, *m_mvp, node.volumeNode->transferFunction());
+    const VolumeDataset& dataset = node.volumeNode->dataset();
+    const size_t level = volumeLevel(dataset);
+    m_interleavingRenderer->render(*node.volumeNode, geoInstances, *m_mvp, level, sliceStride(dataset, level));
+}
+
+size_t RenderDispatcher3D::volumeLevel(const VolumeDataset& dataset) const {
+    return std::min(m_volumeLevel, dataset.numLevels() - 1);
+}
+
+size_t RenderDispatcher3D::sliceStride(const VolumeDataset& dataset, size_t level) const {
+    if (!m_settings->adaptiveSampling()) {
+        return 1;
+    }
+    // more slices than the volume covers pixels on screen add little, fewer are used while interacting if the frame rate is too low
+    const size_t numSlices = dataset.sliceInfos(level)[m_mvp->stackDirection().direction].size();
+    const float quality = m_interacting ? m_frameRateController.quality() : 1.0f;
+    const float targetSlices = std::max(minSlices, m_mvp->screenFootprint(dataset.boundingBox()) * quality);
+    return std::max<size_t>(1, static_cast<size_t>(std::floor(numSlices / targetSlices)));
 }
 
 void RenderDispatcher3D::startDraw() {
@@ -125,12 +231,24 @@ void RenderDispatcher3D::finishDraw() {
     if (m_redraw) {
         m_fbo->Read(0);
         m_redraw = false;
+        if (m_interacting) {
+            m_frameRateController.frameRendered(m_settings->targetFrameRate());
+        }
     }
 }
 void RenderDispatcher3D::setRedrawRequired() {
     m_redraw = true;
 }
 
+void RenderDispatcher3D::setInteraction(bool interacting, size_t volumeLevel) {
+    if (interacting != m_interacting || volumeLevel != m_volumeLevel) {
+        m_interacting = interacting;
+        m_volumeLevel = volumeLevel;
+        m_redraw = true;
+        m_frameRateController.reset();
+    }
+}
+
 void RenderDispatcher3D::IntersectingNode::render(RenderDispatcher3D& dispatcher) {
     dispatcher.dispatch(*this);
 }
@@ -2,13 +2,19 @@
 
 #include "IVDA/Vectors.h"
 #include "duality/Settings.h"
+#include "src/duality/DepthSorter.h"
+#include "src/duality/FrameRateController.h"
 #include "src/duality/RenderableConcept.h"
 
+#include <map>
+#include <utility>
+
 class GLFrameBufferObject;
 class GeometryRenderer3D;
 class VolumeRenderer3D;
 class InterleavingRenderer3D;
 class GeometryNode;
+class VolumeDataset;
 class VolumeNode;
 class SceneNode;
 class MVP3D;
@@ -20,6 +26,9 @@ public:
 
     void render(const std::vector<std::unique_ptr<SceneNode>>& nodes, const MVP3D& mvp);
     void setRedrawRequired();
+    // while interacting, volumes are rendered at the given pyramid level (or the coarsest one they have) and with as many slices as
+    // the target frame rate allows
+    void setInteraction(bool interacting, size_t volumeLevel);
 
     void dispatch(GeometryNode& node);
     void dispatch(VolumeNode& node);
@@ -33,12 +42,26 @@ private:
         BoundingBox boundingBox() const;
     };
 
+    // everything the renderables depend on, to detect when they have to be recalculated
+    struct NodeState {
+        SceneNode* node;
+        GeometryNode* geometryNode;
+        VolumeNode* volumeNode;
+        bool visible;
+        uint64_t generation;
+        uint64_t instancesRevision;
+    };
+
 private:
-    std::vector<Renderable> sortRenderables(const std::vector<Renderable>& renderables);
-    std::vector<Renderable> calculateRenderables(const std::vector<std::unique_ptr<SceneNode>>& nodes);
+    static NodeState nodeState(SceneNode* node, GeometryNode* geometryNode, VolumeNode* volumeNode);
+    bool renderablesOutdated(const std::vector<std::unique_ptr<SceneNode>>& nodes) const;
+    void updateRenderables(const std::vector<std::unique_ptr<SceneNode>>& nodes);
+    void sortRenderables();
     void startDraw();
     void finishDraw();
     void dispatch(IntersectingNode& node);
+    size_t volumeLevel(const VolumeDataset& dataset) const;
+    size_t sliceStride(const VolumeDataset& dataset, size_t level) const;
 
 private:
     std::shared_ptr<GLFrameBufferObject> m_fbo;
@@ -48,4 +71,14 @@ private:
     std::shared_ptr<Settings> m_settings;
     const MVP3D* m_mvp;
     bool m_redraw;
+    bool m_interacting;
+    size_t m_volumeLevel;
+    FrameRateController m_frameRateController;
+    std::vector<NodeState> m_nodeStates;
+    std::vector<Renderable> m_renderables;
+    std::vector<IVDA::Vec3f> m_renderableCenters;
+    // back to front, reused across frames
+    std::vector<std::pair<float, size_t>> m_renderOrder;
+    // the order of the transparent primitives of each instance of a geometry node, kept across frames
+    std::map<std::pair<const GeometryNode*, size_t>, DepthSorter> m_depthSorters;
 };
\ No newline at end of file
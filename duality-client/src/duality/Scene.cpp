@@ -93,6 +93,12 @@ void Scene::initializeDatasets() {
     }
 }
 
+void Scene::releaseMemory() {
+    for (auto& node : m_nodes) {
+        node->releaseMemory();
+    }
+}
+
 void Scene::setUpdateDatasetCallback(std::function<void(int,int,const std::string&)> callback) {
     m_updateDatasetCallback = callback;
 }
@@ -30,6 +30,7 @@ public:
     void setNodeUpdateEnabled(const std::string& name, bool enabled);
     void updateDatasets();
     void initializeDatasets();
+    void releaseMemory();
     void setUpdateDatasetCallback(std::function<void(int,int,const std::string&)> callback);
 
     BoundingBox boundingBox(View view) const;
@@ -35,6 +35,10 @@ void SceneController2D::initializeDatasets() {
     m_impl->initializeDatasets();
 }
 
+void SceneController2D::releaseMemory() {
+    m_impl->releaseMemory();
+}
+
 void SceneController2D::setRedrawRequired() {
     m_impl->setRedrawRequired();
 }
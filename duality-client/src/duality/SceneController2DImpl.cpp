@@ -51,6 +51,10 @@ void SceneController2DImpl::initializeDatasets() {
     m_scene.initializeDatasets();
 }
 
+void SceneController2DImpl::releaseMemory() {
+    m_scene.releaseMemory();
+}
+
 void SceneController2DImpl::setRedrawRequired() {
     m_renderDispatcher->setRedrawRequired();
 }
@@ -86,6 +90,7 @@ void SceneController2DImpl::setSlice(int slice) {
     auto sliderParameter = m_sliderCalculator->parameterForSlice(slice, m_parameters.axis());
     m_parameters.setSliderParameter(sliderParameter);
     m_mvp.updateParameters(m_parameters);
+    updatePrefetchDepths();
     m_renderDispatcher->setRedrawRequired();
 }
 
@@ -97,6 +102,7 @@ void SceneController2DImpl::setDepth(float depth) {
     auto sliderParameter = m_sliderCalculator->parameterForDepth(depth, m_parameters.axis());
     m_parameters.setSliderParameter(sliderParameter);
     m_mvp.updateParameters(m_parameters);
+    updatePrefetchDepths();
     m_renderDispatcher->setRedrawRequired();
 }
 
@@ -107,6 +113,7 @@ SliderParameter SceneController2DImpl::sliderParameter() const {
 void SceneController2DImpl::toggleAxis() {
     m_parameters.toggleAxis();
     m_mvp.updateParameters(m_parameters);
+    updatePrefetchDepths();
     m_renderDispatcher->setRedrawRequired();
 }
 
@@ -148,6 +155,21 @@ void SceneController2DImpl::render() {
     m_renderDispatcher->render(m_scene.nodes(), m_mvp, m_parameters.axis(), m_parameters.sliderParameter());
 }
 
+void SceneController2DImpl::updatePrefetchDepths() {
+    // while scrubbing through slices the neighbouring contours are likely to be needed next
+    std::vector<float> depths;
+    const SliderParameter sliderParameter = m_parameters.sliderParameter();
+    if (supportsSlices() && sliderParameter.hasSlice()) {
+        const int numSlices = numSlicesForCurrentAxis();
+        for (int slice : {sliderParameter.slice() - 1, sliderParameter.slice() + 1}) {
+            if (slice >= 0 && slice < numSlices) {
+                depths.push_back(m_sliderCalculator->parameterForSlice(slice, m_parameters.axis()).depth());
+            }
+        }
+    }
+    m_renderDispatcher->setPrefetchDepths(std::move(depths));
+}
+
 void SceneController2DImpl::updateBoundingBox() {
     m_boundingBox = m_scene.boundingBox(View::View2D);
     m_mvp = MVP2D(m_screenInfo, m_boundingBox, m_parameters);
@@ -30,6 +30,7 @@ public:
     void setNodeUpdateEnabled(const std::string& name, bool enabled);
     void updateDatasets();
     void initializeDatasets();
+    void releaseMemory();
 
     void setRedrawRequired();
     void render();
@@ -53,6 +54,7 @@ public:
     void setVariable(const std::string& objectName, const std::string& variableName, const std::string& value);
 
 private:
+    void updatePrefetchDepths();
     void updateBoundingBox();
 
 private:
@@ -3,6 +3,14 @@
 #include "src/duality/RenderDispatcher3D.h"
 #include "src/duality/Scene.h"
 
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// full resolution is restored when the camera has not moved for this long
+const std::chrono::milliseconds idleDelay(250);
+}
+
 SceneController3DImpl::SceneController3DImpl(Scene& scene, const RenderParameters3D& initialParameters,
                                              std::function<void(int, int, const std::string&)> updateDatasetCallback,
                                              std::shared_ptr<GLFrameBufferObject> fbo, std::shared_ptr<Settings> settings)
@@ -10,7 +18,8 @@ SceneController3DImpl::SceneController3DImpl(Scene& scene, const RenderParameter
     , m_parameters(initialParameters)
     , m_fbo(fbo)
     , m_settings(settings)
-    , m_renderDispatcher(std::make_unique<RenderDispatcher3D>(fbo, settings)) {
+    , m_renderDispatcher(std::make_unique<RenderDispatcher3D>(fbo, settings))
+    , m_interacting(false) {
     m_scene.setUpdateDatasetCallback(updateDatasetCallback);
 }
 
@@ -37,6 +46,10 @@ void SceneController3DImpl::initializeDatasets() {
     m_scene.initializeDatasets();
 }
 
+void SceneController3DImpl::releaseMemory() {
+    m_scene.releaseMemory();
+}
+
 void SceneController3DImpl::setRedrawRequired() {
     m_renderDispatcher->setRedrawRequired();
 }
@@ -44,18 +57,21 @@ void SceneController3DImpl::setRedrawRequired() {
 void SceneController3DImpl::addTranslation(const IVDA::Vec2f& translation) {
     m_parameters.addTranslation(translation);
     m_mvp.updateParameters(m_parameters);
+    startInteraction();
     m_renderDispatcher->setRedrawRequired();
 }
 
 void SceneController3DImpl::addRotation(const IVDA::Mat4f& rotation) {
     m_parameters.addRotation(rotation);
     m_mvp.updateParameters(m_parameters);
+    startInteraction();
     m_renderDispatcher->setRedrawRequired();
 }
 
 void SceneController3DImpl::setZoom(const float zoom) {
     m_parameters.addZoom(zoom);
     m_mvp.updateParameters(m_parameters);
+    startInteraction();
     m_renderDispatcher->setRedrawRequired();
 }
 
@@ -81,6 +97,22 @@ void SceneController3DImpl::setVariable(const std::string& objectName, const std
     m_renderDispatcher->setRedrawRequired();
 }
 
+void SceneController3DImpl::startInteraction() {
+    m_interacting = true;
+    m_lastInteraction = std::chrono::steady_clock::now();
+    // each level halves the resolution
+    const float factor = std::max(1.0f, m_screenInfo.interactiveDownSampleFactor);
+    m_renderDispatcher->setInteraction(true, static_cast<size_t>(std::round(std::log2(factor))));
+}
+
+void SceneController3DImpl::updateInteraction() {
+    if (m_interacting && std::chrono::steady_clock::now() - m_lastInteraction >= idleDelay) {
+        m_interacting = false;
+        m_renderDispatcher->setInteraction(false, 0);
+    }
+}
+
 void SceneController3DImpl::render() {
+    updateInteraction();
     m_renderDispatcher->render(m_scene.nodes(), m_mvp);
 }
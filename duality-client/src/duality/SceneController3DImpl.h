@@ -7,6 +7,7 @@
 
 #include "duality/InputVariable.h"
 
+#include <chrono>
 #include <memory>
 
 class Scene;
@@ -24,6 +25,7 @@ public:
     void setNodeUpdateEnabled(const std::string& name, bool enabled);
     void updateDatasets();
     void initializeDatasets();
+    void releaseMemory();
 
     void setRedrawRequired();
     void render();
@@ -36,6 +38,11 @@ public:
     void setVariable(const std::string& objectName, const std::string& variableName, float value);
     void setVariable(const std::string& objectName, const std::string& variableName, const std::string& value);
 
+private:
+    // volumes are rendered at a coarser level while the camera moves
+    void startInteraction();
+    void updateInteraction();
+
 private:
     Scene& m_scene;
     RenderParameters3D m_parameters;
@@ -45,4 +52,6 @@ private:
     ScreenInfo m_screenInfo;
     BoundingBox m_boundingBox;
     MVP3D m_mvp;
+    bool m_interacting;
+    std::chrono::steady_clock::time_point m_lastInteraction;
 };
\ No newline at end of file
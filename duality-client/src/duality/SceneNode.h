@@ -4,6 +4,8 @@
 #include "src/duality/BoundingBox.h"
 #include "src/duality/RenderDispatcher2D.h"
 #include "src/duality/RenderDispatcher3D.h"
+#include "src/duality/SoftwareRenderer2D.h"
+#include "src/duality/SoftwareRenderer3D.h"
 
 class SceneNode {
 public:
@@ -15,10 +17,14 @@ public:
 
     virtual void render(RenderDispatcher2D& dispatcher) = 0;
     virtual void render(RenderDispatcher3D& dispatcher) = 0;
+    virtual void render(SoftwareRenderer2D& renderer) = 0;
+    virtual void render(SoftwareRenderer3D& renderer) = 0;
     virtual BoundingBox boundingBox() const = 0;
     virtual void setUpdateEnabled(bool enabled) = 0;
     virtual void updateDataset() = 0;
     virtual void initializeDataset() = 0;
+    // frees data that can be recreated on demand
+    virtual void releaseMemory() {}
 
 private:
     std::string m_name;
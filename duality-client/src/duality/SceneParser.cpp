@@ -85,52 +85,97 @@ std::unique_ptr<Scene> SceneParser::parseScene() {
 
 std::unique_ptr<SceneNode> SceneParser::parseGeometryNode(const JsonCpp::Value& node) {
     m_nodeName = node["name"].asString();
+    m_variables[m_nodeName] = std::make_shared<Variables>();
     Visibility visibility = parseVisibility(node);
     auto dataset = parseGeometryDataset(node["dataset"]);
-    return std::make_unique<GeometryNode>(m_nodeName, visibility, std::move(dataset));
-}
-
-std::unique_ptr<GeometryDataset> SceneParser::parseGeometryDataset(const JsonCpp::Value& node) {
-    auto provider = parseProvider(node["source"]);
-    std::vector<Mat4f> transforms;
-    if (node.isMember("transforms")) {
-        for (const auto& transform : node["transforms"]) {
+    std::vector<Mat4f> instances = node.isMember("instances") ? parseInstances(node["instances"]) : std::vector<Mat4f>{Mat4f()};
+    // the transforms of the dataset are applied at render time as well, before the matrix of each instance
+    if (node["dataset"].isMember("transforms")) {
+        std::vector<Mat4f> transforms;
+        for (const auto& transform : node["dataset"]["transforms"]) {
             transforms.push_back(parseTransform(transform));
         }
+        const Mat4f datasetTransform = G3D::collapseTransforms(transforms);
+        for (auto& instance : instances) {
+            instance = instance * datasetTransform;
+        }
     }
+    // the color replaces the vertex colors when the node is rendered, the dataset is left unchanged
     mocca::Nullable<Color> color;
-    if (node.isMember("color")) {
-        color = parseColor(node["color"]);
+    if (node["dataset"].isMember("color")) {
+        color = parseColor(node["dataset"]["color"]);
     }
-    return std::make_unique<GeometryDataset>(std::move(provider), std::move(transforms), std::move(color));
+    return std::make_unique<GeometryNode>(m_nodeName, visibility, std::move(dataset), std::move(instances), std::move(color));
+}
+
+std::shared_ptr<GeometryDataset> SceneParser::parseGeometryDataset(const JsonCpp::Value& node) {
+    // transforms and color are applied per node
+    JsonCpp::Value keyNode;
+    keyNode["source"] = node["source"];
+    if (node.isMember("directionalOrders")) {
+        keyNode["directionalOrders"] = node["directionalOrders"];
+    }
+    std::string key = sharingKey(keyNode);
+    if (m_geometryDatasets.count(key)) {
+        return m_geometryDatasets[key];
+    }
+
+    auto provider = parseProvider(node["source"]);
+    GeometryDataset::DirectionalOrders directionalOrders;
+    if (node.isMember("directionalOrders")) {
+        directionalOrders = parseDirectionalOrders(node["directionalOrders"]);
+    }
+    auto dataset = std::make_shared<GeometryDataset>(std::move(provider), std::move(directionalOrders));
+    m_geometryDatasets[key] = dataset;
+    return dataset;
 }
 
 std::unique_ptr<SceneNode> SceneParser::parseVolumeNode(const JsonCpp::Value& node) {
     m_nodeName = node["name"].asString();
+    m_variables[m_nodeName] = std::make_shared<Variables>();
     Visibility visibility = parseVisibility(node);
     auto dataset = parseVolumeDataset(node["dataset"]);
-    std::unique_ptr<TransferFunction> tf;
+    std::shared_ptr<TransferFunction> tf;
     if (node.isMember("tf")) {
         tf = parseTransferFunction(node["tf"]);
     } else {
-        tf = std::make_unique<TransferFunction>(nullptr);
+        if (!m_transferFunctions.count("")) {
+            m_transferFunctions[""] = std::make_shared<TransferFunction>(nullptr);
+        }
+        tf = m_transferFunctions[""];
     }
     return std::make_unique<VolumeNode>(m_nodeName, visibility, std::move(dataset), std::move(tf));
 }
 
-std::unique_ptr<VolumeDataset> SceneParser::parseVolumeDataset(const JsonCpp::Value& node) {
-    auto provider = parseProvider(node["source"]);
-    return std::make_unique<VolumeDataset>(std::move(provider));
+std::shared_ptr<VolumeDataset> SceneParser::parseVolumeDataset(const JsonCpp::Value& node) {
+    std::string key = sharingKey(node);
+    if (!m_volumeDatasets.count(key)) {
+        auto provider = parseProvider(node["source"]);
+        m_volumeDatasets[key] = std::make_shared<VolumeDataset>(std::move(provider));
+    }
+    return m_volumeDatasets[key];
 }
 
-std::unique_ptr<TransferFunction> SceneParser::parseTransferFunction(const JsonCpp::Value& node) {
-    auto provider = parseProvider(node["source"]);
-    return std::make_unique<TransferFunction>(std::move(provider));
+std::shared_ptr<TransferFunction> SceneParser::parseTransferFunction(const JsonCpp::Value& node) {
+    std::string key = sharingKey(node);
+    if (!m_transferFunctions.count(key)) {
+        auto provider = parseProvider(node["source"]);
+        m_transferFunctions[key] = std::make_shared<TransferFunction>(std::move(provider));
+    }
+    return m_transferFunctions[key];
+}
+
+std::string SceneParser::sharingKey(const JsonCpp::Value& node) const {
+    // python sources depend on the variables of their node and can therefore never be shared
+    std::string key = node.toStyledString();
+    if (node["source"]["type"].asString() == "python") {
+        key += m_nodeName;
+    }
+    return key;
 }
 
 std::unique_ptr<DataProvider> SceneParser::parseProvider(const JsonCpp::Value& node) {
     std::string type = node["type"].asString();
-    m_variables[m_nodeName] = std::make_shared<Variables>();
     if (type == "download") {
         return parseDownload(node);
     } else if (type == "python") {
@@ -193,6 +238,41 @@ Mat4f SceneParser::parseTransform(const JsonCpp::Value& node) {
     }
 }
 
+GeometryDataset::DirectionalOrders SceneParser::parseDirectionalOrders(const JsonCpp::Value& node) {
+    GeometryDataset::DirectionalOrders orders;
+    orders.resolution = node["resolution"].asUInt();
+    if (node.isMember("maxMegabytes")) {
+        orders.maxBytes = static_cast<size_t>(node["maxMegabytes"].asFloat() * 1024 * 1024);
+    }
+    if (node.isMember("maxAngle")) {
+        orders.maxAngle = node["maxAngle"].asFloat();
+    }
+    if (node.isMember("refine")) {
+        orders.refine = node["refine"].asBool();
+    }
+    return orders;
+}
+
+std::vector<Mat4f> SceneParser::parseInstances(const JsonCpp::Value& node) {
+    // every instance is either a single transform or a list of transforms that is applied in order
+    std::vector<Mat4f> instances;
+    for (const auto& instance : node) {
+        if (instance.isString() || (instance.isArray() && instance.size() == 16 && instance[0].isNumeric())) {
+            instances.push_back(parseTransform(instance));
+        } else {
+            std::vector<Mat4f> transforms;
+            for (const auto& transform : instance) {
+                transforms.push_back(parseTransform(transform));
+            }
+            instances.push_back(G3D::collapseTransforms(transforms));
+        }
+    }
+    if (instances.empty()) {
+        throw Error("Geometry node '" + m_nodeName + "' defines no instances", __FILE__, __LINE__);
+    }
+    return instances;
+}
+
 Color SceneParser::parseColor(const JsonCpp::Value& node) {
     if (!node.isArray() || !(node.size() == 4)) {
         throw Error("Invalid color", __FILE__, __LINE__);
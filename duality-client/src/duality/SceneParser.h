@@ -36,11 +36,12 @@ private:
     Visibility parseVisibility(const JsonCpp::Value& node);
 
     std::unique_ptr<SceneNode> parseGeometryNode(const JsonCpp::Value& node);
-    std::unique_ptr<GeometryDataset> parseGeometryDataset(const JsonCpp::Value& node);
+    std::shared_ptr<GeometryDataset> parseGeometryDataset(const JsonCpp::Value& node);
 
     std::unique_ptr<SceneNode> parseVolumeNode(const JsonCpp::Value& node);
-    std::unique_ptr<VolumeDataset> parseVolumeDataset(const JsonCpp::Value& node);
-    std::unique_ptr<TransferFunction> parseTransferFunction(const JsonCpp::Value& node);
+    std::shared_ptr<VolumeDataset> parseVolumeDataset(const JsonCpp::Value& node);
+    std::shared_ptr<TransferFunction> parseTransferFunction(const JsonCpp::Value& node);
+    std::string sharingKey(const JsonCpp::Value& node) const;
 
     std::unique_ptr<DataProvider> parseProvider(const JsonCpp::Value& node);
     std::unique_ptr<DataProvider> parseDownload(const JsonCpp::Value& node);
@@ -50,6 +51,8 @@ private:
     IVDA::Vec2f parseVector2(const JsonCpp::Value& node);
     IVDA::Mat4f parseMatrix(const JsonCpp::Value& node);
     IVDA::Mat4f parseTransform(const JsonCpp::Value& node);
+    std::vector<IVDA::Mat4f> parseInstances(const JsonCpp::Value& node);
+    GeometryDataset::DirectionalOrders parseDirectionalOrders(const JsonCpp::Value& node);
 
     Color parseColor(const JsonCpp::Value& node);
     
@@ -66,4 +69,8 @@ private:
     std::string m_nodeName;
     int m_varIndex;
     std::map<std::string, std::shared_ptr<Variables>> m_variables;
+    // datasets and transfer functions are shared between all nodes that reference the same source
+    std::map<std::string, std::shared_ptr<GeometryDataset>> m_geometryDatasets;
+    std::map<std::string, std::shared_ptr<VolumeDataset>> m_volumeDatasets;
+    std::map<std::string, std::shared_ptr<TransferFunction>> m_transferFunctions;
 };
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "src/duality/SliceOccupancy.h"
+
+#include "src/duality/SliceStackBuilder.h"
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+
+using namespace IVDA;
+
+namespace {
+// the first and last tile a texel belongs to, including the overlap
+std::pair<size_t, size_t> tilesOfTexel(size_t texel, size_t numTiles) {
+    const size_t tileSize = SliceOccupancy::tileSize;
+    const size_t first = texel > 0 ? (texel - 1) / tileSize : 0;
+    return std::make_pair(first, std::min(numTiles - 1, (texel + 1) / tileSize));
+}
+}
+
+SliceOccupancy::VisibleValues SliceOccupancy::visibleValues(const std::array<std::array<uint8_t, 4>, 256>& transferFunction) {
+    VisibleValues visible;
+    visible[0] = 0;
+    for (size_t value = 0; value < 256; ++value) {
+        visible[value + 1] = visible[value] + (transferFunction[value][3] > 0 ? 1 : 0);
+    }
+    return visible;
+}
+
+bool SliceOccupancy::Region::empty() const {
+    return min.x >= max.x || min.y >= max.y;
+}
+
+bool SliceOccupancy::TexelRect::empty() const {
+    return size.x == 0 || size.y == 0;
+}
+
+SliceOccupancy::SliceOccupancy(const I3M::Volume& volume) {
+    for (size_t dir = 0; dir < 3; ++dir) {
+        m_stacks[dir] = computeStack(volume, static_cast<CoordinateAxis>(dir));
+    }
+}
+
+SliceOccupancy::Stack SliceOccupancy::computeStack(const I3M::Volume& volume, CoordinateAxis axis) {
+    Stack stack;
+    stack.sliceSize = SliceStackBuilder::sliceSize(volume.info, axis);
+    stack.tilesU = (stack.sliceSize.x + tileSize - 1) / tileSize;
+    stack.tilesV = (stack.sliceSize.y + tileSize - 1) / tileSize;
+    const size_t numSlices = SliceStackBuilder::numSlices(volume.info, axis);
+    const size_t tilesPerSlice = stack.tilesU * stack.tilesV;
+    stack.ranges.assign(numSlices * tilesPerSlice, Range{255, 0, false});
+
+    const size_t sizeX = volume.info.size.x;
+    const size_t sizeY = volume.info.size.y;
+    const size_t sizeZ = volume.info.size.z;
+    const size_t sizeV = stack.sliceSize.y;
+    auto update = [](Range& range, const std::array<uint8_t, 4>& texel) {
+        range.min = std::min(range.min, texel[3]);
+        range.max = std::max(range.max, texel[3]);
+        range.occupied = range.occupied || (texel[0] | texel[1] | texel[2] | texel[3]) != 0;
+    };
+    // every task owns a row of tiles in all slices and reads the rows of voxels that belong to it, v is y for Z and z otherwise
+    ThreadPool::instance().parallelFor(0, stack.tilesV, 1, [&](size_t firstTileV, size_t lastTileV) {
+        for (size_t tileV = firstTileV; tileV < lastTileV; ++tileV) {
+            const size_t firstV = tileV * tileSize > 0 ? tileV * tileSize - 1 : 0;
+            const size_t lastV = std::min(sizeV, (tileV + 1) * tileSize + 1);
+            for (size_t v = firstV; v < lastV; ++v) {
+                const size_t firstZ = axis == Z_Axis ? 0 : v;
+                const size_t lastZ = axis == Z_Axis ? sizeZ : v + 1;
+                for (size_t z = firstZ; z < lastZ; ++z) {
+                    const size_t firstY = axis == Z_Axis ? v : 0;
+                    const size_t lastY = axis == Z_Axis ? v + 1 : sizeY;
+                    for (size_t y = firstY; y < lastY; ++y) {
+                        const std::array<uint8_t, 4>* row = volume.voxels.data() + (z * sizeY + y) * sizeX;
+                        if (axis == X_Axis) {
+                            // every voxel of the row lies in a different slice, the row is in one or two tiles of each
+                            const auto tiles = tilesOfTexel(y, stack.tilesU);
+                            for (size_t x = 0; x < sizeX; ++x) {
+                                Range* ranges = &stack.ranges[x * tilesPerSlice + tileV * stack.tilesU];
+                                for (size_t tileU = tiles.first; tileU <= tiles.second; ++tileU) {
+                                    update(ranges[tileU], row[x]);
+                                }
+                            }
+                        } else {
+                            // the row is a row of a slice
+                            const size_t slice = axis == Y_Axis ? y : z;
+                            Range* ranges = &stack.ranges[slice * tilesPerSlice + tileV * stack.tilesU];
+                            for (size_t tileU = 0; tileU < stack.tilesU; ++tileU) {
+                                const size_t firstU = tileU * tileSize > 0 ? tileU * tileSize - 1 : 0;
+                                const size_t lastU = std::min(sizeX, (tileU + 1) * tileSize + 1);
+                                for (size_t u = firstU; u < lastU; ++u) {
+                                    update(ranges[tileU], row[u]);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+    return stack;
+}
+
+SliceOccupancy::Region SliceOccupancy::visibleRegion(CoordinateAxis axis, size_t slice1, size_t slice2,
+                                                     const VisibleValues& visible) const {
+    const Stack& stack = m_stacks[axis];
+    const size_t tilesPerSlice = stack.tilesU * stack.tilesV;
+    const Range* ranges1 = &stack.ranges[slice1 * tilesPerSlice];
+    const Range* ranges2 = &stack.ranges[slice2 * tilesPerSlice];
+    size_t minU = stack.tilesU, minV = stack.tilesV, maxU = 0, maxV = 0;
+    for (size_t tileV = 0; tileV < stack.tilesV; ++tileV) {
+        for (size_t tileU = 0; tileU < stack.tilesU; ++tileU) {
+            // interpolated values lie within the union of both ranges
+            const size_t tile = tileV * stack.tilesU + tileU;
+            const uint8_t minValue = std::min(ranges1[tile].min, ranges2[tile].min);
+            const uint8_t maxValue = std::max(ranges1[tile].max, ranges2[tile].max);
+            if (minValue <= maxValue && visible[maxValue + 1] > visible[minValue]) {
+                minU = std::min(minU, tileU);
+                minV = std::min(minV, tileV);
+                maxU = std::max(maxU, tileU + 1);
+                maxV = std::max(maxV, tileV + 1);
+            }
+        }
+    }
+    if (minU >= maxU) {
+        return Region{Vec2f(0, 0), Vec2f(0, 0)};
+    }
+    const Vec2f sliceSize(static_cast<float>(stack.sliceSize.x), static_cast<float>(stack.sliceSize.y));
+    return Region{Vec2f(static_cast<float>(minU * tileSize) / sliceSize.x, static_cast<float>(minV * tileSize) / sliceSize.y),
+                  Vec2f(std::min(1.0f, static_cast<float>(maxU * tileSize) / sliceSize.x),
+                        std::min(1.0f, static_cast<float>(maxV * tileSize) / sliceSize.y))};
+}
+
+SliceOccupancy::TexelRect SliceOccupancy::occupiedTexels(CoordinateAxis axis, size_t slice) const {
+    const Stack& stack = m_stacks[axis];
+    const Range* ranges = &stack.ranges[slice * stack.tilesU * stack.tilesV];
+    size_t minU = stack.tilesU, minV = stack.tilesV, maxU = 0, maxV = 0;
+    for (size_t tileV = 0; tileV < stack.tilesV; ++tileV) {
+        for (size_t tileU = 0; tileU < stack.tilesU; ++tileU) {
+            if (ranges[tileV * stack.tilesU + tileU].occupied) {
+                minU = std::min(minU, tileU);
+                minV = std::min(minV, tileV);
+                maxU = std::max(maxU, tileU + 1);
+                maxV = std::max(maxV, tileV + 1);
+            }
+        }
+    }
+    if (minU >= maxU) {
+        return TexelRect{Vec2ui(0, 0), Vec2ui(0, 0)};
+    }
+    // the texels next to the occupied tiles belong to the overlap of unoccupied tiles, so they are zero
+    const size_t firstU = minU * tileSize > 0 ? minU * tileSize - 1 : 0;
+    const size_t firstV = minV * tileSize > 0 ? minV * tileSize - 1 : 0;
+    const size_t endU = std::min<size_t>(stack.sliceSize.x, maxU * tileSize + 1);
+    const size_t endV = std::min<size_t>(stack.sliceSize.y, maxV * tileSize + 1);
+    return TexelRect{Vec2ui(static_cast<uint32_t>(firstU), static_cast<uint32_t>(firstV)),
+                     Vec2ui(static_cast<uint32_t>(endU - firstU), static_cast<uint32_t>(endV - firstV))};
+}
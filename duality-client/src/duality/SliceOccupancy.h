@@ -0,0 +1,68 @@
+#pragma once
+
+#include "duality/CoordinateSystem.h"
+#include "src/duality/I3M.h"
+
+#include "IVDA/Vectors.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// conservative ranges of the scalar values (alpha channel) within square tiles of the axis aligned slices of a volume; neighbouring
+// tiles overlap by one texel, so that bilinear filtering cannot reach values outside of a tile's range. Together with the opacities of
+// a transfer function, the ranges yield the parts of the slices that can be visible. Tiles that contain only zero texels are tracked
+// as well, so that slices can be stored cropped.
+class SliceOccupancy {
+public:
+    static const size_t tileSize = 16;
+
+    // number of scalar values below each value that are not fully transparent
+    using VisibleValues = std::array<uint32_t, 257>;
+    static VisibleValues visibleValues(const std::array<std::array<uint8_t, 4>, 256>& transferFunction);
+
+    // the part of a slice that has to be drawn, in texture coordinates
+    struct Region {
+        IVDA::Vec2f min;
+        IVDA::Vec2f max;
+
+        bool empty() const;
+    };
+
+    // a rectangle of texels, empty if size is zero
+    struct TexelRect {
+        IVDA::Vec2ui min;
+        IVDA::Vec2ui size;
+
+        bool empty() const;
+    };
+
+    SliceOccupancy() = default;
+    explicit SliceOccupancy(const I3M::Volume& volume);
+
+    // the region of a slice interpolated between two slices of the stack along the axis
+    Region visibleRegion(CoordinateAxis axis, size_t slice1, size_t slice2, const VisibleValues& visible) const;
+    // contains all texels of a slice with a non zero scalar and a ring of zero scalars around them, as far as the slice extends; the
+    // scalars outside are reproduced by clamping to the ring, gradients computed per slice are not zero on the ring yet
+    TexelRect occupiedTexels(CoordinateAxis axis, size_t slice) const;
+
+private:
+    struct Range {
+        uint8_t min;
+        uint8_t max;
+        // any texel has a non zero channel
+        bool occupied;
+    };
+    struct Stack {
+        size_t tilesU;
+        size_t tilesV;
+        IVDA::Vec2ui sliceSize;
+        // slice major, then row major tiles
+        std::vector<Range> ranges;
+    };
+
+    static Stack computeStack(const I3M::Volume& volume, CoordinateAxis axis);
+
+private:
+    std::array<Stack, 3> m_stacks;
+};
@@ -0,0 +1,184 @@
+#include "src/duality/SliceStackBuilder.h"
+
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <vector>
+
+using namespace IVDA;
+using Texel = SliceStackBuilder::Texel;
+
+namespace {
+const size_t maxSlicesPerGroup = 16;
+
+// slices extracted by one task; neighbouring X slices share the cache lines of the volume, so they are extracted together
+size_t slicesPerGroup(CoordinateAxis axis) {
+    return axis == X_Axis ? maxSlicesPerGroup : 4;
+}
+
+// X slices are columns of the volume: every row of the volume is read once per group and scattered to the group's slices, which are
+// all written sequentially
+void extractX(const I3M::Volume& volume, size_t firstSlice, size_t endSlice, Texel* const* slices) {
+    const size_t sizeX = volume.info.size.x;
+    const size_t sizeY = volume.info.size.y;
+    const size_t sizeZ = volume.info.size.z;
+    const size_t count = endSlice - firstSlice;
+    const Texel* voxels = volume.voxels.data();
+    for (size_t z = 0; z < sizeZ; ++z) {
+        for (size_t y = 0; y < sizeY; ++y) {
+            const Texel* row = voxels + (z * sizeY + y) * sizeX + firstSlice;
+            const size_t target = z * sizeY + y;
+            for (size_t s = 0; s < count; ++s) {
+                slices[s][target] = row[s];
+            }
+        }
+    }
+}
+
+// Y slices consist of whole rows of the volume
+void extractY(const I3M::Volume& volume, size_t firstSlice, size_t endSlice, Texel* const* slices) {
+    const size_t sizeX = volume.info.size.x;
+    const size_t sizeY = volume.info.size.y;
+    const size_t sizeZ = volume.info.size.z;
+    for (size_t slice = firstSlice; slice < endSlice; ++slice) {
+        Texel* target = slices[slice - firstSlice];
+        for (size_t z = 0; z < sizeZ; ++z) {
+            std::memcpy(target + z * sizeX, volume.voxels.data() + (z * sizeY + slice) * sizeX, sizeX * sizeof(Texel));
+        }
+    }
+}
+
+// Z slices are contiguous
+void extractZ(const I3M::Volume& volume, size_t firstSlice, size_t endSlice, Texel* const* slices) {
+    const size_t sliceSize = volume.info.size.x * volume.info.size.y;
+    for (size_t slice = firstSlice; slice < endSlice; ++slice) {
+        std::memcpy(slices[slice - firstSlice], volume.voxels.data() + slice * sliceSize, sliceSize * sizeof(Texel));
+    }
+}
+}
+
+Vec2ui SliceStackBuilder::sliceSize(const I3M::VolumeInfo& info, CoordinateAxis axis) {
+    switch (axis) {
+    case X_Axis:
+        return Vec2ui(info.size.y, info.size.z);
+    case Y_Axis:
+        return Vec2ui(info.size.x, info.size.z);
+    default:
+        return Vec2ui(info.size.x, info.size.y);
+    }
+}
+
+size_t SliceStackBuilder::numSlices(const I3M::VolumeInfo& info, CoordinateAxis axis) {
+    return info.size[axis];
+}
+
+void SliceStackBuilder::extractSlices(const I3M::Volume& volume, CoordinateAxis axis, size_t firstSlice, size_t endSlice,
+                                      Texel* const* slices) {
+    switch (axis) {
+    case X_Axis:
+        // keeps the number of write streams small
+        for (size_t first = firstSlice; first < endSlice; first += maxSlicesPerGroup) {
+            extractX(volume, first, std::min(endSlice, first + maxSlicesPerGroup), slices + (first - firstSlice));
+        }
+        break;
+    case Y_Axis:
+        extractY(volume, firstSlice, endSlice, slices);
+        break;
+    case Z_Axis:
+        extractZ(volume, firstSlice, endSlice, slices);
+        break;
+    }
+}
+
+void SliceStackBuilder::build(const I3M::Volume& volume, CoordinateAxis axis, const std::function<void(size_t, const Texel*)>& consume,
+                              const std::function<void(size_t, Texel*)>& prepare) {
+    struct Group {
+        size_t firstSlice;
+        size_t endSlice;
+        std::vector<Texel> texels;
+    };
+
+    const Vec2ui size = sliceSize(volume.info, axis);
+    const size_t texelsPerSlice = static_cast<size_t>(size.x) * size.y;
+    const size_t total = numSlices(volume.info, axis);
+    const size_t groupSize = slicesPerGroup(axis);
+    const size_t numGroups = (total + groupSize - 1) / groupSize;
+    auto& pool = ThreadPool::instance();
+    const size_t maxGroupsInFlight = 2 * pool.numThreads();
+
+    // finished groups are handed back to the calling thread, their buffers are reused for later groups
+    std::mutex mutex;
+    std::condition_variable groupFinished;
+    std::deque<Group> finishedGroups;
+    std::vector<std::vector<Texel>> freeBuffers;
+    std::vector<std::future<void>> tasks;
+
+    size_t nextGroup = 0;
+    size_t groupsInFlight = 0;
+    auto submitGroup = [&] {
+        Group group;
+        group.firstSlice = nextGroup * groupSize;
+        group.endSlice = std::min(total, group.firstSlice + groupSize);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeBuffers.empty()) {
+                group.texels = std::move(freeBuffers.back());
+                freeBuffers.pop_back();
+            }
+        }
+        group.texels.resize((group.endSlice - group.firstSlice) * texelsPerSlice);
+        ++nextGroup;
+        ++groupsInFlight;
+        tasks.push_back(pool.submit([&, group = std::move(group)]() mutable {
+            std::array<Texel*, maxSlicesPerGroup> slices;
+            for (size_t slice = group.firstSlice; slice < group.endSlice; ++slice) {
+                slices[slice - group.firstSlice] = group.texels.data() + (slice - group.firstSlice) * texelsPerSlice;
+            }
+            extractSlices(volume, axis, group.firstSlice, group.endSlice, slices.data());
+            if (prepare) {
+                for (size_t slice = group.firstSlice; slice < group.endSlice; ++slice) {
+                    prepare(slice, slices[slice - group.firstSlice]);
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            finishedGroups.push_back(std::move(group));
+            groupFinished.notify_one();
+        }));
+    };
+
+    auto waitForTasks = [&] {
+        for (auto& task : tasks) {
+            task.wait();
+        }
+    };
+    try {
+        for (size_t consumed = 0; consumed < numGroups; ++consumed) {
+            while (groupsInFlight < maxGroupsInFlight && nextGroup < numGroups) {
+                submitGroup();
+            }
+            Group group;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                groupFinished.wait(lock, [&] { return !finishedGroups.empty(); });
+                group = std::move(finishedGroups.front());
+                finishedGroups.pop_front();
+            }
+            --groupsInFlight;
+            for (size_t slice = group.firstSlice; slice < group.endSlice; ++slice) {
+                consume(slice, group.texels.data() + (slice - group.firstSlice) * texelsPerSlice);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBuffers.push_back(std::move(group.texels));
+        }
+    } catch (...) {
+        // the tasks refer to this stack frame
+        waitForTasks();
+        throw;
+    }
+    waitForTasks();
+}
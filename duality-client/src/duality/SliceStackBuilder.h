@@ -0,0 +1,29 @@
+#pragma once
+
+#include "duality/CoordinateSystem.h"
+#include "src/duality/I3M.h"
+
+#include "IVDA/Vectors.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+// extracts the axis aligned slices of a volume; slice w along an axis is sizeU x sizeV texels with (u, v) = (y, z) for X, (x, z) for Y
+// and (x, y) for Z, stored row by row
+class SliceStackBuilder {
+public:
+    using Texel = std::array<uint8_t, 4>;
+
+    static IVDA::Vec2ui sliceSize(const I3M::VolumeInfo& info, CoordinateAxis axis);
+    static size_t numSlices(const I3M::VolumeInfo& info, CoordinateAxis axis);
+
+    // extracts the slices [firstSlice, endSlice) into the given buffers, one per slice
+    static void extractSlices(const I3M::Volume& volume, CoordinateAxis axis, size_t firstSlice, size_t endSlice, Texel* const* slices);
+
+    // extracts all slices along the axis on the thread pool and calls consume(slice, texels) for each of them on the calling thread,
+    // e.g. to upload them to GL, in no particular order; the number of slices in flight is bounded. If given, prepare(slice, texels) is
+    // called on the pool for every extracted slice before it is consumed
+    static void build(const I3M::Volume& volume, CoordinateAxis axis, const std::function<void(size_t, const Texel*)>& consume,
+                      const std::function<void(size_t, Texel*)>& prepare = nullptr);
+};
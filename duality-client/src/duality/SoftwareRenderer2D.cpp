@@ -0,0 +1,302 @@
+#include "src/duality/SoftwareRenderer2D.h"
+
+#include "src/duality/GeometryNode.h"
+#include "src/duality/GeometryRenderer2D.h"
+#include "src/duality/MVP2D.h"
+#include "src/duality/RenderDispatcher2D.h"
+#include "src/duality/SceneNode.h"
+#include "src/duality/SliceStackBuilder.h"
+#include "src/duality/ThreadPool.h"
+#include "src/duality/VolumeNode.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace IVDA;
+using Pixel = SoftwareRenderer2D::Pixel;
+
+namespace {
+const uint32_t tileSize = 64;
+
+// row vector convention, like the shaders
+Vec4f transform(const Vec4f& p, const GLMatrix& m) {
+    Vec4f result;
+    for (int j = 0; j < 4; ++j) {
+        result[j] = p.x * m[0][j] + p.y * m[1][j] + p.z * m[2][j] + p.w * m[3][j];
+    }
+    return result;
+}
+
+// directions of the slice coordinates (u, v) in model space, see SliceStackBuilder
+std::array<Vec3f, 2> sliceAxes(CoordinateAxis axis) {
+    switch (axis) {
+    case X_Axis:
+        return {{Vec3f(0, 1, 0), Vec3f(0, 0, 1)}};
+    case Y_Axis:
+        return {{Vec3f(1, 0, 0), Vec3f(0, 0, 1)}};
+    default:
+        return {{Vec3f(1, 0, 0), Vec3f(0, 1, 0)}};
+    }
+}
+
+// distances between neighbouring voxels along u, v and the slice axis
+std::array<size_t, 3> sliceStrides(const I3M::VolumeInfo& info, CoordinateAxis axis) {
+    const size_t row = info.size.x;
+    const size_t slice = static_cast<size_t>(info.size.x) * info.size.y;
+    switch (axis) {
+    case X_Axis:
+        return {{row, slice, 1}};
+    case Y_Axis:
+        return {{1, slice, row}};
+    default:
+        return {{1, row, slice}};
+    }
+}
+
+// blending with (src alpha, 1 - src alpha) into an RGBA8 target, color in [0, 1]
+void blend(Pixel& target, const float* color) {
+    const float alpha = color[3];
+    for (int c = 0; c < 4; ++c) {
+        const float value = color[c] * 255.0f * alpha + target[c] * (1.0f - alpha);
+        target[c] = static_cast<uint8_t>(std::min(255.0f, value + 0.5f));
+    }
+}
+}
+
+SoftwareRenderer2D::SoftwareRenderer2D(const Vec2ui& size, std::shared_ptr<Settings> settings)
+    : m_size(size)
+    , m_settings(std::move(settings))
+    , m_image(static_cast<size_t>(size.x) * size.y)
+    , m_mvp(nullptr)
+    , m_axis(CoordinateAxis::X_Axis)
+    , m_sliderParameter(SliderParameter(0.0f)) {}
+
+void SoftwareRenderer2D::render(const std::vector<std::unique_ptr<SceneNode>>& nodes, const MVP2D& mvp, CoordinateAxis axis,
+                                const SliderParameter& sliderParameter) {
+    m_mvp = &mvp;
+    m_axis = axis;
+    m_sliderParameter = sliderParameter;
+
+    clear(m_settings->backgroundColor());
+    for (const auto& node : nodes) {
+        if (node->isVisibleInView(View::View2D)) {
+            node->render(*this);
+        }
+    }
+}
+
+void SoftwareRenderer2D::dispatch(GeometryNode& node) {
+    const float depth = m_sliderParameter.depth();
+    for (const auto& instance : node.instances()) {
+        const GLMatrix mvp = m_mvp->instanced(instance).mvp();
+        auto contour = m_contourCache.contour(node.dataset(), instance, m_axis, depth);
+        const float tolerance = GeometryRenderer2D::simplificationTolerance(mvp, m_settings->lineSimplificationPixels(), m_size);
+        renderLines(*contour->lines(tolerance), mvp, GeometryRenderer2D::lineWidth, node.color());
+    }
+}
+
+void SoftwareRenderer2D::dispatch(VolumeNode& node) {
+    const int slice = RenderDispatcher2D::sliceIndex(node, m_axis, m_sliderParameter);
+    if (slice >= 0) {
+        renderSlice(node.dataset(), m_mvp->mvp(), node.transferFunction(), m_axis, static_cast<size_t>(slice));
+    }
+}
+
+void SoftwareRenderer2D::clear(const std::array<float, 3>& color) {
+    Pixel pixel;
+    for (int c = 0; c < 3; ++c) {
+        pixel[c] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, color[c])) * 255.0f + 0.5f);
+    }
+    pixel[3] = 255;
+    std::fill(begin(m_image), end(m_image), pixel);
+}
+
+void SoftwareRenderer2D::renderSlice(const VolumeDataset& dataset, const GLMatrix& mvp, const TransferFunction& tf, CoordinateAxis axis,
+                                     size_t slice) {
+    const auto& sliceInfo = dataset.sliceInfos()[axis][slice];
+    const I3M::Volume& volume = dataset.volume();
+    const Vec2ui sliceSize = SliceStackBuilder::sliceSize(volume.info, axis);
+    const std::array<size_t, 3> strides = sliceStrides(volume.info, axis);
+    const uint8_t* scalars1 = volume.voxels[sliceInfo.textureIndex1 * strides[2]].data() + 3;
+    const uint8_t* scalars2 = volume.voxels[sliceInfo.textureIndex2 * strides[2]].data() + 3;
+    const float interpolation = sliceInfo.interpolationParam;
+
+    // the quad of VolumeRenderer2D spans [-0.5, 0.5] along u and v; the 2D projection is orthographic, so the texture coordinates are
+    // an affine function of the pixel position
+    const auto axes = sliceAxes(axis);
+    const Vec4f corner = transform(Vec4f(-0.5f * (axes[0] + axes[1]), 1.0f), mvp);
+    const Vec4f du = transform(Vec4f(axes[0], 0.0f), mvp);
+    const Vec4f dv = transform(Vec4f(axes[1], 0.0f), mvp);
+    const float det = du.x * dv.y - du.y * dv.x;
+    if (std::abs(det) < 1e-12f) {
+        return;
+    }
+    // texture coordinates of the center of pixel (x, y): (s0 + x * dsdx + y * dsdy, t0 + x * dtdx + y * dtdy)
+    const float dndx = 2.0f / m_size.x;
+    const float dndy = -2.0f / m_size.y;
+    const float nx0 = 0.5f * dndx - 1.0f - corner.x / corner.w;
+    const float ny0 = 1.0f + 0.5f * dndy - corner.y / corner.w;
+    const float dsdx = dv.y * dndx / det;
+    const float dsdy = -dv.x * dndy / det;
+    const float dtdx = -du.y * dndx / det;
+    const float dtdy = du.x * dndy / det;
+    const float s0 = (nx0 * dv.y - ny0 * dv.x) / det;
+    const float t0 = (du.x * ny0 - du.y * nx0) / det;
+
+    // the transfer function is sampled linearly like its 256 x 1 texture
+    std::array<std::array<float, 4>, 256> tfColors;
+    for (size_t i = 0; i < 256; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            tfColors[i][c] = tf.data()[i][c] / 255.0f;
+        }
+    }
+
+    forEachTile([&](const Vec2ui& min, const Vec2ui& max) {
+        const size_t width = max.x - min.x;
+        std::vector<float> s(width), t(width);
+        for (uint32_t y = min.y; y < max.y; ++y) {
+            // texel positions of the pixels in this row, without branches so that the loop is vectorized
+            const float rowS = s0 + y * dsdy;
+            const float rowT = t0 + y * dtdy;
+            for (size_t i = 0; i < width; ++i) {
+                const float x = static_cast<float>(min.x + i);
+                s[i] = rowS + x * dsdx;
+                t[i] = rowT + x * dtdx;
+            }
+            Pixel* target = m_image.data() + static_cast<size_t>(y) * m_size.x + min.x;
+            for (size_t i = 0; i < width; ++i) {
+                if (s[i] < 0.0f || s[i] > 1.0f || t[i] < 0.0f || t[i] > 1.0f) {
+                    continue;
+                }
+                // bilinear filtering with clamping to the edge
+                const float u = std::max(0.0f, s[i] * sliceSize.x - 0.5f);
+                const float v = std::max(0.0f, t[i] * sliceSize.y - 0.5f);
+                const size_t u0 = std::min<size_t>(static_cast<size_t>(u), sliceSize.x - 1);
+                const size_t v0 = std::min<size_t>(static_cast<size_t>(v), sliceSize.y - 1);
+                const size_t u1 = std::min<size_t>(u0 + 1, sliceSize.x - 1);
+                const size_t v1 = std::min<size_t>(v0 + 1, sliceSize.y - 1);
+                const float fu = std::min(1.0f, u - u0);
+                const float fv = std::min(1.0f, v - v0);
+                const size_t o00 = 4 * (u0 * strides[0] + v0 * strides[1]);
+                const size_t o10 = 4 * (u1 * strides[0] + v0 * strides[1]);
+                const size_t o01 = 4 * (u0 * strides[0] + v1 * strides[1]);
+                const size_t o11 = 4 * (u1 * strides[0] + v1 * strides[1]);
+                auto sample = [&](const uint8_t* scalars) {
+                    const float bottom = scalars[o00] + (scalars[o10] - scalars[o00]) * fu;
+                    const float top = scalars[o01] + (scalars[o11] - scalars[o01]) * fu;
+                    return bottom + (top - bottom) * fv;
+                };
+                const float value = sample(scalars1) * (1.0f - interpolation) + sample(scalars2) * interpolation;
+
+                const float position = std::max(0.0f, std::min(255.0f, value / 255.0f * 256.0f - 0.5f));
+                const size_t index0 = static_cast<size_t>(position);
+                const size_t index1 = std::min<size_t>(index0 + 1, 255);
+                const float f = position - index0;
+                float color[4];
+                for (int c = 0; c < 4; ++c) {
+                    color[c] = tfColors[index0][c] + (tfColors[index1][c] - tfColors[index0][c]) * f;
+                }
+                blend(target[i], color);
+            }
+        }
+    });
+}
+
+void SoftwareRenderer2D::renderLines(const G3D::GeometrySoA& lines, const GLMatrix& mvp, float width, const mocca::Nullable<Color>& color) {
+    if (lines.positions == nullptr || lines.info.numberIndices < 2) {
+        return;
+    }
+    // pixel coordinates of the vertices, y pointing down
+    const size_t numVertices = lines.info.numberVertices;
+    std::vector<Vec2f> points(numVertices);
+    for (size_t i = 0; i < numVertices; ++i) {
+        const Vec4f clip = transform(Vec4f(Vec3f(lines.positions + 3 * i), 1.0f), mvp);
+        points[i] = Vec2f((clip.x / clip.w + 1.0f) * 0.5f * m_size.x, (1.0f - clip.y / clip.w) * 0.5f * m_size.y);
+    }
+
+    // segments by tile, in drawing order
+    const float radius = 0.5f * width;
+    const uint32_t tilesX = (m_size.x + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (m_size.y + tileSize - 1) / tileSize;
+    std::vector<std::vector<uint32_t>> tileSegments(static_cast<size_t>(tilesX) * tilesY);
+    for (uint32_t i = 0; i + 1 < lines.info.numberIndices; i += 2) {
+        const Vec2f& a = points[lines.indices[i]];
+        const Vec2f& b = points[lines.indices[i + 1]];
+        const float minX = std::min(a.x, b.x) - radius;
+        const float maxX = std::max(a.x, b.x) + radius;
+        const float minY = std::min(a.y, b.y) - radius;
+        const float maxY = std::max(a.y, b.y) + radius;
+        if (maxX < 0.0f || maxY < 0.0f || minX >= m_size.x || minY >= m_size.y) {
+            continue;
+        }
+        const uint32_t firstX = static_cast<uint32_t>(std::max(0.0f, minX)) / tileSize;
+        const uint32_t firstY = static_cast<uint32_t>(std::max(0.0f, minY)) / tileSize;
+        const uint32_t lastX = std::min(tilesX - 1, static_cast<uint32_t>(maxX) / tileSize);
+        const uint32_t lastY = std::min(tilesY - 1, static_cast<uint32_t>(maxY) / tileSize);
+        for (uint32_t ty = firstY; ty <= lastY; ++ty) {
+            for (uint32_t tx = firstX; tx <= lastX; ++tx) {
+                tileSegments[ty * tilesX + tx].push_back(i);
+            }
+        }
+    }
+
+    // pixels whose center is at most half the line width away from a segment are covered
+    forEachTile([&](const Vec2ui& min, const Vec2ui& max) {
+        for (uint32_t i : tileSegments[(min.y / tileSize) * tilesX + min.x / tileSize]) {
+            const uint32_t indexA = lines.indices[i];
+            const uint32_t indexB = lines.indices[i + 1];
+            const Vec2f a = points[indexA];
+            const Vec2f ab = points[indexB] - a;
+            const float sqLength = ab.x * ab.x + ab.y * ab.y;
+            const uint32_t firstX = std::max<float>(min.x, std::floor(std::min(a.x, a.x + ab.x) - radius));
+            const uint32_t firstY = std::max<float>(min.y, std::floor(std::min(a.y, a.y + ab.y) - radius));
+            const uint32_t endX = std::min<float>(max.x, std::ceil(std::max(a.x, a.x + ab.x) + radius));
+            const uint32_t endY = std::min<float>(max.y, std::ceil(std::max(a.y, a.y + ab.y) + radius));
+            for (uint32_t y = firstY; y < endY; ++y) {
+                Pixel* row = m_image.data() + static_cast<size_t>(y) * m_size.x;
+                for (uint32_t x = firstX; x < endX; ++x) {
+                    const float px = x + 0.5f - a.x;
+                    const float py = y + 0.5f - a.y;
+                    const float f = sqLength > 0.0f ? std::max(0.0f, std::min(1.0f, (px * ab.x + py * ab.y) / sqLength)) : 0.0f;
+                    const float dx = px - f * ab.x;
+                    const float dy = py - f * ab.y;
+                    if (dx * dx + dy * dy > radius * radius) {
+                        continue;
+                    }
+                    float lineColor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+                    if (!color.isNull()) {
+                        lineColor[0] = color.get().red;
+                        lineColor[1] = color.get().green;
+                        lineColor[2] = color.get().blue;
+                        lineColor[3] = color.get().alpha;
+                    } else if (lines.colors != nullptr) {
+                        for (int c = 0; c < 4; ++c) {
+                            lineColor[c] = lines.colors[4 * indexA + c] + (lines.colors[4 * indexB + c] - lines.colors[4 * indexA + c]) * f;
+                        }
+                    }
+                    blend(row[x], lineColor);
+                }
+            }
+        }
+    });
+}
+
+const Vec2ui& SoftwareRenderer2D::size() const {
+    return m_size;
+}
+
+const std::vector<Pixel>& SoftwareRenderer2D::image() const {
+    return m_image;
+}
+
+void SoftwareRenderer2D::forEachTile(const std::function<void(const Vec2ui&, const Vec2ui&)>& renderTile) const {
+    const uint32_t tilesX = (m_size.x + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (m_size.y + tileSize - 1) / tileSize;
+    ThreadPool::instance().parallelFor(0, static_cast<size_t>(tilesX) * tilesY, 1, [&](size_t first, size_t last) {
+        for (size_t tile = first; tile < last; ++tile) {
+            const Vec2ui min(static_cast<uint32_t>(tile % tilesX) * tileSize, static_cast<uint32_t>(tile / tilesX) * tileSize);
+            const Vec2ui max(std::min(m_size.x, min.x + tileSize), std::min(m_size.y, min.y + tileSize));
+            renderTile(min, max);
+        }
+    });
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "IVDA/GLMatrix.h"
+#include "IVDA/Vectors.h"
+#include "duality/CoordinateSystem.h"
+#include "duality/Settings.h"
+#include "duality/SliderParameter.h"
+#include "src/duality/Color.h"
+#include "src/duality/ContourCache.h"
+#include "src/duality/G3D.h"
+#include "src/duality/TransferFunction.h"
+#include "src/duality/VolumeDataset.h"
+
+#include "mocca/base/Nullable.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class GeometryNode;
+class VolumeNode;
+class SceneNode;
+class MVP2D;
+
+// renders the 2D view into memory without GL, e.g. for thumbnails, batch exports and regression tests; it produces the image of
+// RenderDispatcher2D: the volume slice under the transfer function with bilinear filtering, and the contours of the geometry on top,
+// blended with (src alpha, 1 - src alpha); the image is split into tiles that are rendered on the thread pool
+class SoftwareRenderer2D {
+public:
+    using Pixel = std::array<uint8_t, 4>;
+
+    SoftwareRenderer2D(const IVDA::Vec2ui& size, std::shared_ptr<Settings> settings);
+
+    void render(const std::vector<std::unique_ptr<SceneNode>>& nodes, const MVP2D& mvp, CoordinateAxis axis,
+                const SliderParameter& sliderParameter);
+
+    void dispatch(GeometryNode& node);
+    void dispatch(VolumeNode& node);
+
+    void clear(const std::array<float, 3>& color);
+    // draws a slice (an index into dataset.sliceInfos()) like VolumeRenderer2D
+    void renderSlice(const VolumeDataset& dataset, const GLMatrix& mvp, const TransferFunction& tf, CoordinateAxis axis, size_t slice);
+    // draws line geometry with per vertex colors, or the given color instead, like GeometryRenderer2D
+    void renderLines(const G3D::GeometrySoA& lines, const GLMatrix& mvp, float width,
+                     const mocca::Nullable<Color>& color = mocca::Nullable<Color>());
+
+    const IVDA::Vec2ui& size() const;
+    // RGBA, row by row from the top of the image
+    const std::vector<Pixel>& image() const;
+
+private:
+    // calls renderTile(min, max) for all tiles in parallel, max is exclusive
+    void forEachTile(const std::function<void(const IVDA::Vec2ui&, const IVDA::Vec2ui&)>& renderTile) const;
+
+private:
+    IVDA::Vec2ui m_size;
+    std::shared_ptr<Settings> m_settings;
+    std::vector<Pixel> m_image;
+    ContourCache m_contourCache;
+    const MVP2D* m_mvp;
+    CoordinateAxis m_axis;
+    SliderParameter m_sliderParameter;
+};
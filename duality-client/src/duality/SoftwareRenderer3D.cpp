@@ -0,0 +1,439 @@
+#include "src/duality/SoftwareRenderer3D.h"
+
+#include "src/duality/GeometryNode.h"
+#include "src/duality/GradientEstimator.h"
+#include "src/duality/MVP3D.h"
+#include "src/duality/SceneNode.h"
+#include "src/duality/SliceOccupancy.h"
+#include "src/duality/ThreadPool.h"
+#include "src/duality/VolumeNode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace IVDA;
+using Pixel = SoftwareRenderer3D::Pixel;
+
+namespace {
+const uint32_t tileSize = 32;
+// neighbouring rays that are set up together
+const size_t packetSize = 8;
+const size_t blockSize = 8;
+// rays are not continued once their opacity reaches this
+const float opaqueAlpha = 0.99f;
+// transparent layers of a geometry instance that a ray passes through at most
+const int maxLayers = 32;
+const float infinity = std::numeric_limits<float>::infinity();
+
+// front to back, color holds the premultiplied color and the opacity so far
+void composite(float* color, const float* sample) {
+    const float weight = (1.0f - color[3]) * sample[3];
+    color[0] += weight * sample[0];
+    color[1] += weight * sample[1];
+    color[2] += weight * sample[2];
+    color[3] += weight;
+}
+
+void barycentrics(const G3D::GeometrySoA& geometry, uint32_t primitive, const Vec3f& origin, const Vec3f& direction, float& u, float& v) {
+    const uint32_t* indices = geometry.indices.data() + 3 * primitive;
+    const Vec3f v0(geometry.positions + 3 * indices[0]);
+    const Vec3f e1 = Vec3f(geometry.positions + 3 * indices[1]) - v0;
+    const Vec3f e2 = Vec3f(geometry.positions + 3 * indices[2]) - v0;
+    const Vec3f p = direction % e2;
+    const float invDet = 1.0f / (e1 ^ p);
+    const Vec3f s = origin - v0;
+    u = (s ^ p) * invDet;
+    v = (direction ^ (s % e1)) * invDet;
+}
+
+// the attributes are combined like the shaders that GeometryRenderer3D chooses for them; textures are not sampled
+std::array<float, 4> surfaceColor(const G3D::GeometrySoA& geometry, const mocca::Nullable<Color>& colorOverride, const Mat4f& mvp,
+                                  uint32_t primitive, float u, float v) {
+    const uint32_t* indices = geometry.indices.data() + 3 * primitive;
+    const float weights[3] = {1.0f - u - v, u, v};
+    auto interpolate = [&](const float* attribute, int components, int component) {
+        float result = 0.0f;
+        for (int i = 0; i < 3; ++i) {
+            result += weights[i] * attribute[components * indices[i] + component];
+        }
+        return result;
+    };
+
+    std::array<float, 4> color = {{1.0f, 1.0f, 1.0f, 1.0f}};
+    Vec3f normal;
+    if (geometry.normals) {
+        normal = Vec3f(interpolate(geometry.normals, 3, 0), interpolate(geometry.normals, 3, 1), interpolate(geometry.normals, 3, 2));
+    }
+    const bool hasColors = geometry.colors || !colorOverride.isNull();
+    if (!colorOverride.isNull()) {
+        const Color& nodeColor = colorOverride.get();
+        color = {{nodeColor.red, nodeColor.green, nodeColor.blue, nodeColor.alpha}};
+    } else if (geometry.colors) {
+        for (int c = 0; c < 4; ++c) {
+            color[c] = interpolate(geometry.colors, 4, c);
+        }
+    } else if (geometry.normals && !geometry.texcoords) {
+        color[0] = 0.5f * (normal.x + 1.0f);
+        color[1] = 0.5f * (normal.y + 1.0f);
+        color[2] = 0.5f * (normal.z + 1.0f);
+    }
+    if (geometry.alphas) {
+        color[3] = interpolate(geometry.alphas, 1, 0);
+    }
+    if (geometry.normals && (hasColors || geometry.texcoords)) {
+        const Vec3f n = (Vec4f(normal, 0.0f) * mvp).xyz();
+        const float length = n.length();
+        const float diffuse = 0.2f + (length > 0.0f ? std::min(1.0f, std::abs(n.z) / length) : 0.0f);
+        for (int c = 0; c < 3; ++c) {
+            color[c] *= diffuse;
+        }
+    }
+    return color;
+}
+}
+
+SoftwareRenderer3D::SoftwareRenderer3D(const Vec2ui& size, std::shared_ptr<Settings> settings)
+    : m_size(size)
+    , m_settings(std::move(settings))
+    , m_image(static_cast<size_t>(size.x) * size.y)
+    , m_mvp(nullptr) {}
+
+void SoftwareRenderer3D::render(const std::vector<std::unique_ptr<SceneNode>>& nodes, const MVP3D& mvp) {
+    m_mvp = &mvp;
+    m_volumes.clear();
+    m_geometries.clear();
+    for (const auto& node : nodes) {
+        if (node->isVisibleInView(View::View3D)) {
+            node->render(*this);
+        }
+    }
+
+    const std::array<float, 3> background = m_settings->backgroundColor();
+    // row vector convention: the points on the near and far plane are linear combinations of the rows of the inverse
+    const Mat4f& inverse = mvp.mvpInverse();
+    const Vec4f rowX(inverse.m11, inverse.m12, inverse.m13, inverse.m14);
+    const Vec4f rowY(inverse.m21, inverse.m22, inverse.m23, inverse.m24);
+    const Vec4f rowZ(inverse.m31, inverse.m32, inverse.m33, inverse.m34);
+    const Vec4f rowW(inverse.m41, inverse.m42, inverse.m43, inverse.m44);
+    const Vec4f nearOffset = rowW - rowZ;
+    const Vec4f farOffset = rowW + rowZ;
+    const float dndx = 2.0f / m_size.x;
+    const float dndy = -2.0f / m_size.y;
+
+    // tiles are taken from a shared counter, so threads that finish cheap tiles go on with the remaining ones
+    const uint32_t tilesX = (m_size.x + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (m_size.y + tileSize - 1) / tileSize;
+    ThreadPool::instance().parallelFor(0, static_cast<size_t>(tilesX) * tilesY, 1, [&](size_t firstTile, size_t lastTile) {
+        Ray ray;
+        ray.volumeSpans.resize(m_volumes.size());
+        ray.volumeOrder.reserve(m_volumes.size());
+        std::vector<Hit> hits;
+        std::array<float, packetSize> ox, oy, oz, dx, dy, dz;
+        std::vector<std::array<float, packetSize>> enter(m_volumes.size()), exit(m_volumes.size());
+        for (size_t tile = firstTile; tile < lastTile; ++tile) {
+            const uint32_t minX = static_cast<uint32_t>(tile % tilesX) * tileSize;
+            const uint32_t minY = static_cast<uint32_t>(tile / tilesX) * tileSize;
+            const uint32_t maxX = std::min(m_size.x, minX + tileSize);
+            const uint32_t maxY = std::min(m_size.y, minY + tileSize);
+            for (uint32_t y = minY; y < maxY; ++y) {
+                const float ny = 1.0f + (y + 0.5f) * dndy;
+                for (uint32_t packetX = minX; packetX < maxX; packetX += packetSize) {
+                    // rays from the near to the far plane (t in [0, 1]) of a packet of pixels, in separate arrays and without branches so
+                    // that the loops are vectorized
+                    for (size_t i = 0; i < packetSize; ++i) {
+                        const float nx = (packetX + i + 0.5f) * dndx - 1.0f;
+                        const float nearW = rowX.w * nx + rowY.w * ny + nearOffset.w;
+                        const float farW = rowX.w * nx + rowY.w * ny + farOffset.w;
+                        ox[i] = (rowX.x * nx + rowY.x * ny + nearOffset.x) / nearW;
+                        oy[i] = (rowX.y * nx + rowY.y * ny + nearOffset.y) / nearW;
+                        oz[i] = (rowX.z * nx + rowY.z * ny + nearOffset.z) / nearW;
+                        dx[i] = (rowX.x * nx + rowY.x * ny + farOffset.x) / farW - ox[i];
+                        dy[i] = (rowX.y * nx + rowY.y * ny + farOffset.y) / farW - oy[i];
+                        dz[i] = (rowX.z * nx + rowY.z * ny + farOffset.z) / farW - oz[i];
+                    }
+                    for (size_t v = 0; v < m_volumes.size(); ++v) {
+                        const BoundingBox& bounds = m_volumes[v].bounds;
+                        for (size_t i = 0; i < packetSize; ++i) {
+                            const float tx0 = (bounds.min.x - ox[i]) / dx[i], tx1 = (bounds.max.x - ox[i]) / dx[i];
+                            const float ty0 = (bounds.min.y - oy[i]) / dy[i], ty1 = (bounds.max.y - oy[i]) / dy[i];
+                            const float tz0 = (bounds.min.z - oz[i]) / dz[i], tz1 = (bounds.max.z - oz[i]) / dz[i];
+                            enter[v][i] = std::max(std::max(0.0f, std::min(tx0, tx1)), std::max(std::min(ty0, ty1), std::min(tz0, tz1)));
+                            exit[v][i] = std::min(std::min(1.0f, std::max(tx0, tx1)), std::min(std::max(ty0, ty1), std::max(tz0, tz1)));
+                        }
+                    }
+
+                    const size_t numRays = std::min<size_t>(packetSize, maxX - packetX);
+                    for (size_t i = 0; i < numRays; ++i) {
+                        ray.origin = Vec3f(ox[i], oy[i], oz[i]);
+                        ray.direction = Vec3f(dx[i], dy[i], dz[i]);
+                        for (size_t v = 0; v < m_volumes.size(); ++v) {
+                            ray.volumeSpans[v] = std::make_pair(enter[v][i], exit[v][i]);
+                        }
+                        float color[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                        traceRay(ray, hits, color);
+                        Pixel& pixel = m_image[static_cast<size_t>(y) * m_size.x + packetX + i];
+                        for (int c = 0; c < 3; ++c) {
+                            const float value = color[c] + (1.0f - color[3]) * background[c];
+                            pixel[c] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, value)) * 255.0f + 0.5f);
+                        }
+                        pixel[3] = 255;
+                    }
+                }
+            }
+        }
+    });
+}
+
+void SoftwareRenderer3D::dispatch(GeometryNode& node) {
+    for (const auto& instance : node.instances()) {
+        m_geometries.push_back(
+            GeometryInstance{&node.dataset(), instance.inverse(), static_cast<Mat4f>(m_mvp->instanced(instance).mvp()), node.color()});
+    }
+}
+
+void SoftwareRenderer3D::dispatch(VolumeNode& node) {
+    VolumeInstance volume;
+    volume.grid = &blockGrid(node.dataset());
+    volume.volume = volume.grid->volume;
+    volume.visibleBlocks = &visibleBlocks(node.dataset(), *volume.grid, node.transferFunction());
+    volume.bounds = node.dataset().boundingBox();
+    volume.mvp = static_cast<Mat4f>(m_mvp->mvp());
+    for (size_t i = 0; i < 256; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            volume.tfColors[i][c] = node.transferFunction().data()[i][c] / 255.0f;
+        }
+    }
+    m_volumes.push_back(volume);
+}
+
+const Vec2ui& SoftwareRenderer3D::size() const {
+    return m_size;
+}
+
+const std::vector<Pixel>& SoftwareRenderer3D::image() const {
+    return m_image;
+}
+
+const SoftwareRenderer3D::BlockGrid& SoftwareRenderer3D::blockGrid(const VolumeDataset& dataset) {
+    BlockGrid& grid = m_blockGrids[&dataset];
+    if (grid.generation != dataset.generation() || grid.ranges.empty()) {
+        grid.gradientVolume.reset();
+        if (!dataset.hasGradients()) {
+            grid.gradientVolume = std::make_unique<I3M::Volume>(dataset.volume());
+            GradientEstimator::computeGradients(*grid.gradientVolume);
+        }
+        grid.volume = grid.gradientVolume ? grid.gradientVolume.get() : &dataset.volume();
+        const I3M::Volume& volume = *grid.volume;
+        const Vec3ui size = volume.info.size;
+        grid.numBlocks = Vec3ui((size.x + blockSize - 1) / blockSize, (size.y + blockSize - 1) / blockSize,
+                                (size.z + blockSize - 1) / blockSize);
+        grid.ranges.resize(static_cast<size_t>(grid.numBlocks.x) * grid.numBlocks.y * grid.numBlocks.z);
+        ThreadPool::instance().parallelFor(0, grid.numBlocks.z, 1, [&](size_t firstZ, size_t lastZ) {
+            for (size_t bz = firstZ; bz < lastZ; ++bz) {
+                for (size_t by = 0; by < grid.numBlocks.y; ++by) {
+                    for (size_t bx = 0; bx < grid.numBlocks.x; ++bx) {
+                        // samples in a block interpolate from the voxels up to the first one of the next block
+                        uint8_t minValue = 255;
+                        uint8_t maxValue = 0;
+                        for (size_t z = bz * blockSize; z <= std::min<size_t>((bz + 1) * blockSize, size.z - 1); ++z) {
+                            for (size_t y = by * blockSize; y <= std::min<size_t>((by + 1) * blockSize, size.y - 1); ++y) {
+                                const std::array<uint8_t, 4>* row = volume.voxels.data() + (z * size.y + y) * size.x;
+                                for (size_t x = bx * blockSize; x <= std::min<size_t>((bx + 1) * blockSize, size.x - 1); ++x) {
+                                    minValue = std::min(minValue, row[x][3]);
+                                    maxValue = std::max(maxValue, row[x][3]);
+                                }
+                            }
+                        }
+                        grid.ranges[(bz * grid.numBlocks.y + by) * grid.numBlocks.x + bx] = {{minValue, maxValue}};
+                    }
+                }
+            }
+        });
+        grid.generation = dataset.generation();
+    }
+    return grid;
+}
+
+const std::vector<uint8_t>& SoftwareRenderer3D::visibleBlocks(const VolumeDataset& dataset, const BlockGrid& grid,
+                                                             const TransferFunction& tf) {
+    BlockVisibility& visibility = m_blockVisibilities[std::make_pair(&dataset, &tf)];
+    if (visibility.generation != grid.generation || visibility.tfGeneration != tf.generation() ||
+        visibility.visible.size() != grid.ranges.size()) {
+        // the transfer function is interpolated linearly, so values next to the range contribute as well
+        const auto visibleValues = SliceOccupancy::visibleValues(tf.data());
+        visibility.visible.resize(grid.ranges.size());
+        for (size_t i = 0; i < grid.ranges.size(); ++i) {
+            const size_t first = grid.ranges[i][0] > 0 ? grid.ranges[i][0] - 1 : 0;
+            const size_t last = std::min<size_t>(255, grid.ranges[i][1] + 1);
+            visibility.visible[i] = visibleValues[last + 1] > visibleValues[first];
+        }
+        visibility.generation = grid.generation;
+        visibility.tfGeneration = tf.generation();
+    }
+    return visibility.visible;
+}
+
+void SoftwareRenderer3D::collectHits(const Ray& ray, std::vector<Hit>& hits) const {
+    hits.clear();
+    for (const auto& instance : m_geometries) {
+        const G3D::GeometrySoA& geometry = instance.dataset->geometry();
+        const PrimitiveBVH& bvh = instance.dataset->bvh();
+        if (bvh.empty() || geometry.info.primitiveType != G3D::Triangle) {
+            continue;
+        }
+        // t is the same in the model space of the dataset
+        const Vec3f origin = (instance.inverseModelMatrix * Vec4f(ray.origin, 1.0f)).xyz();
+        const Vec3f direction = (instance.inverseModelMatrix * Vec4f(ray.direction, 0.0f)).xyz();
+        float tStart = 0.0f;
+        for (int layer = 0; layer < maxLayers; ++layer) {
+            float t;
+            uint32_t primitive;
+            if (!bvh.intersectRay(geometry, origin + direction * tStart, direction, t, primitive) || tStart + t > 1.0f) {
+                break;
+            }
+            const float tHit = tStart + t;
+            float u, v;
+            barycentrics(geometry, primitive, origin, direction, u, v);
+            hits.push_back(Hit{tHit, surfaceColor(geometry, instance.color, instance.mvp, primitive, u, v)});
+            if (hits.back().color[3] >= 1.0f) {
+                break;
+            }
+            // continues behind the hit
+            tStart = tHit * (1.0f + 1e-5f) + 1e-6f;
+        }
+    }
+    std::sort(begin(hits), end(hits), [](const Hit& lhs, const Hit& rhs) { return lhs.t < rhs.t; });
+}
+
+void SoftwareRenderer3D::traceRay(Ray& ray, std::vector<Hit>& hits, float* color) const {
+    collectHits(ray, hits);
+    size_t nextHit = 0;
+    // returns false once the ray is opaque
+    auto compositeHits = [&](float tEnd) {
+        for (; nextHit < hits.size() && hits[nextHit].t <= tEnd; ++nextHit) {
+            composite(color, hits[nextHit].color.data());
+            if (color[3] >= opaqueAlpha) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // volumes are composited one after the other in the order in which the ray enters them
+    std::vector<size_t>& volumeOrder = ray.volumeOrder;
+    volumeOrder.clear();
+    for (size_t v = 0; v < m_volumes.size(); ++v) {
+        if (ray.volumeSpans[v].first < ray.volumeSpans[v].second) {
+            volumeOrder.push_back(v);
+        }
+    }
+    std::sort(begin(volumeOrder), end(volumeOrder),
+              [&](size_t lhs, size_t rhs) { return ray.volumeSpans[lhs].first < ray.volumeSpans[rhs].first; });
+    for (size_t v : volumeOrder) {
+        const float tFirst = ray.volumeSpans[v].first;
+        const float tEnd = ray.volumeSpans[v].second;
+        if (!compositeHits(tFirst)) {
+            return;
+        }
+        // the volume is interrupted by the surfaces it contains
+        for (float t = tFirst; t < tEnd;) {
+            const float tStop = nextHit < hits.size() ? std::min(tEnd, hits[nextHit].t) : tEnd;
+            if (!castVolume(m_volumes[v], ray, tFirst, t, tStop, color) || !compositeHits(tStop)) {
+                return;
+            }
+            t = tStop;
+        }
+    }
+    compositeHits(infinity);
+}
+
+bool SoftwareRenderer3D::castVolume(const VolumeInstance& volume, const Ray& ray, float tFirst, float tBegin, float tEnd,
+                                    float* color) const {
+    const Vec3ui size = volume.volume->info.size;
+    const std::array<uint8_t, 4>* voxels = volume.volume->voxels.data();
+    const BlockGrid& grid = *volume.grid;
+    const std::vector<uint8_t>& visible = *volume.visibleBlocks;
+    // voxel coordinates along the ray, with the voxel centers at integer coordinates
+    const Vec3f extent = volume.bounds.max - volume.bounds.min;
+    const Vec3f scale(size.x / extent.x, size.y / extent.y, size.z / extent.z);
+    const Vec3f origin = (ray.origin - volume.bounds.min) * scale - Vec3f(0.5f, 0.5f, 0.5f);
+    const Vec3f direction = ray.direction * scale;
+    const float dt = 1.0f / direction.length();
+    const Vec3f maxCoordinate(size.x - 1.0f, size.y - 1.0f, size.z - 1.0f);
+
+    for (size_t k = static_cast<size_t>(std::max(0.0f, std::ceil((tBegin - tFirst) / dt)));; ++k) {
+        const float t = tFirst + k * dt;
+        if (t >= tEnd) {
+            return true;
+        }
+        Vec3f p = origin + direction * t;
+        p.StoreMax(Vec3f(0.0f, 0.0f, 0.0f));
+        p.StoreMin(maxCoordinate);
+        const Vec3ui p0(static_cast<uint32_t>(p.x), static_cast<uint32_t>(p.y), static_cast<uint32_t>(p.z));
+
+        // blocks that are transparent under the transfer function are left at once; the blocks at the border extend beyond the volume,
+        // since the coordinates are clamped
+        const Vec3ui block(p0.x / blockSize, p0.y / blockSize, p0.z / blockSize);
+        if (!visible[(block.z * grid.numBlocks.y + block.y) * grid.numBlocks.x + block.x]) {
+            float tExit = infinity;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (direction[axis] > 0.0f && block[axis] + 1 < grid.numBlocks[axis]) {
+                    tExit = std::min(tExit, ((block[axis] + 1) * blockSize - origin[axis]) / direction[axis]);
+                } else if (direction[axis] < 0.0f && block[axis] > 0) {
+                    tExit = std::min(tExit, (block[axis] * blockSize - origin[axis]) / direction[axis]);
+                }
+            }
+            if (tExit >= tEnd) {
+                return true;
+            }
+            k = std::max(k + 1, static_cast<size_t>(std::ceil((tExit - tFirst) / dt))) - 1;
+            continue;
+        }
+
+        // trilinear filtering of all channels
+        const Vec3ui p1(std::min(p0.x + 1, size.x - 1), std::min(p0.y + 1, size.y - 1), std::min(p0.z + 1, size.z - 1));
+        const float fx = p.x - p0.x;
+        const float fy = p.y - p0.y;
+        const float fz = p.z - p0.z;
+        auto voxel = [&](uint32_t x, uint32_t y, uint32_t z) { return voxels[(static_cast<size_t>(z) * size.y + y) * size.x + x].data(); };
+        const uint8_t* v000 = voxel(p0.x, p0.y, p0.z);
+        const uint8_t* v100 = voxel(p1.x, p0.y, p0.z);
+        const uint8_t* v010 = voxel(p0.x, p1.y, p0.z);
+        const uint8_t* v110 = voxel(p1.x, p1.y, p0.z);
+        const uint8_t* v001 = voxel(p0.x, p0.y, p1.z);
+        const uint8_t* v101 = voxel(p1.x, p0.y, p1.z);
+        const uint8_t* v011 = voxel(p0.x, p1.y, p1.z);
+        const uint8_t* v111 = voxel(p1.x, p1.y, p1.z);
+        float sample[4];
+        for (int c = 0; c < 4; ++c) {
+            const float y0 = (v000[c] + (v100[c] - v000[c]) * fx) * (1.0f - fy) + (v010[c] + (v110[c] - v010[c]) * fx) * fy;
+            const float y1 = (v001[c] + (v101[c] - v001[c]) * fx) * (1.0f - fy) + (v011[c] + (v111[c] - v011[c]) * fx) * fy;
+            sample[c] = y0 + (y1 - y0) * fz;
+        }
+
+        const float position = std::max(0.0f, std::min(255.0f, sample[3] / 255.0f * 256.0f - 0.5f));
+        const size_t index0 = static_cast<size_t>(position);
+        const size_t index1 = std::min<size_t>(index0 + 1, 255);
+        const float f = position - index0;
+        float sampleColor[4];
+        for (int c = 0; c < 4; ++c) {
+            sampleColor[c] = volume.tfColors[index0][c] + (volume.tfColors[index1][c] - volume.tfColors[index0][c]) * f;
+        }
+        if (sampleColor[3] <= 0.0f) {
+            continue;
+        }
+        // shading of vol_l.fsh, the gradient is normalized in homogeneous clip space
+        const Vec4f normal = Vec4f((sample[0] / 255.0f - 0.5f) * 2.0f, (sample[1] / 255.0f - 0.5f) * 2.0f,
+                                   (sample[2] / 255.0f - 0.5f) * 2.0f, 0.0f) * volume.mvp;
+        const float length = std::sqrt(normal ^ normal);
+        const float phong = 0.2f + (length > 0.0f ? std::abs(normal.z) / length : 0.0f);
+        for (int c = 0; c < 3; ++c) {
+            sampleColor[c] *= phong;
+        }
+        composite(color, sampleColor);
+        if (color[3] >= opaqueAlpha) {
+            return false;
+        }
+    }
+}
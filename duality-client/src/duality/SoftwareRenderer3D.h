@@ -0,0 +1,108 @@
+#pragma once
+
+#include "IVDA/Vectors.h"
+#include "duality/Settings.h"
+#include "src/duality/Color.h"
+#include "src/duality/GeometryDataset.h"
+#include "src/duality/I3M.h"
+#include "src/duality/TransferFunction.h"
+#include "src/duality/VolumeDataset.h"
+
+#include "mocca/base/Nullable.h"
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class GeometryNode;
+class VolumeNode;
+class SceneNode;
+class MVP3D;
+
+// renders the 3D view into memory without GL by ray casting, e.g. for snapshots on a server and image comparisons; volumes are shaded
+// like the lit slice shaders and composited front to back together with the triangles of the geometry, transparent ones included.
+// Rays stop once they are opaque and skip blocks of the volume that are transparent under the transfer function; the image is split
+// into tiles that the threads of the pool take on as they become idle.
+class SoftwareRenderer3D {
+public:
+    using Pixel = std::array<uint8_t, 4>;
+
+    SoftwareRenderer3D(const IVDA::Vec2ui& size, std::shared_ptr<Settings> settings);
+
+    void render(const std::vector<std::unique_ptr<SceneNode>>& nodes, const MVP3D& mvp);
+
+    // collect the nodes of the frame, which are rendered together
+    void dispatch(GeometryNode& node);
+    void dispatch(VolumeNode& node);
+
+    const IVDA::Vec2ui& size() const;
+    // RGBA, row by row from the top of the image
+    const std::vector<Pixel>& image() const;
+
+private:
+    // scalar ranges of blocks of blockSize^3 voxels, including the voxels that samples within a block interpolate from
+    struct BlockGrid {
+        uint64_t generation;
+        // the voxels that are rendered; a copy with gradients if the dataset only carries scalars
+        const I3M::Volume* volume;
+        std::unique_ptr<I3M::Volume> gradientVolume;
+        IVDA::Vec3ui numBlocks;
+        std::vector<std::array<uint8_t, 2>> ranges;
+    };
+    // the blocks of a grid that are not fully transparent under a transfer function; nodes that share a dataset have their own
+    struct BlockVisibility {
+        uint64_t generation;
+        uint64_t tfGeneration;
+        std::vector<uint8_t> visible;
+    };
+    struct VolumeInstance {
+        const I3M::Volume* volume;
+        const BlockGrid* grid;
+        const std::vector<uint8_t>* visibleBlocks;
+        BoundingBox bounds;
+        IVDA::Mat4f mvp;
+        std::array<std::array<float, 4>, 256> tfColors;
+    };
+    struct GeometryInstance {
+        const GeometryDataset* dataset;
+        // model space of the scene to model space of the dataset
+        IVDA::Mat4f inverseModelMatrix;
+        IVDA::Mat4f mvp;
+        // replaces the vertex colors
+        mocca::Nullable<Color> color;
+    };
+    // a point where a ray crosses a triangle
+    struct Hit {
+        float t;
+        std::array<float, 4> color;
+    };
+    struct Ray {
+        IVDA::Vec3f origin;
+        IVDA::Vec3f direction;
+        // the part of the ray within each volume
+        std::vector<std::pair<float, float>> volumeSpans;
+        // scratch for the volumes that the ray enters, in order
+        std::vector<size_t> volumeOrder;
+    };
+
+    const BlockGrid& blockGrid(const VolumeDataset& dataset);
+    const std::vector<uint8_t>& visibleBlocks(const VolumeDataset& dataset, const BlockGrid& grid, const TransferFunction& tf);
+    void collectHits(const Ray& ray, std::vector<Hit>& hits) const;
+    void traceRay(Ray& ray, std::vector<Hit>& hits, float* color) const;
+    // composites the samples of the volume along the ray within [tBegin, tEnd), which are one voxel apart starting at tFirst; returns
+    // false once the ray is opaque
+    bool castVolume(const VolumeInstance& volume, const Ray& ray, float tFirst, float tBegin, float tEnd, float* color) const;
+
+private:
+    IVDA::Vec2ui m_size;
+    std::shared_ptr<Settings> m_settings;
+    std::vector<Pixel> m_image;
+    const MVP3D* m_mvp;
+    std::vector<VolumeInstance> m_volumes;
+    std::vector<GeometryInstance> m_geometries;
+    std::map<const VolumeDataset*, BlockGrid> m_blockGrids;
+    std::map<std::pair<const VolumeDataset*, const TransferFunction*>, BlockVisibility> m_blockVisibilities;
+};
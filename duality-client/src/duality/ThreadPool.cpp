@@ -0,0 +1,108 @@
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+ThreadPool::ThreadPool(size_t numThreads)
+    : m_stop(false) {
+    for (size_t i = 0; i < numThreads; ++i) {
+        m_threads.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(std::max<size_t>(1, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+size_t ThreadPool::numThreads() const {
+    return m_threads.size();
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& body) {
+    if (begin >= end) {
+        return;
+    }
+    grainSize = std::max<size_t>(1, grainSize);
+    const size_t numChunks = (end - begin + grainSize - 1) / grainSize;
+    if (numChunks == 1 || m_threads.empty()) {
+        body(begin, end);
+        return;
+    }
+
+    struct State {
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> finishedChunks{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+
+    // helpers that start after all chunks have been taken return without touching body
+    auto work = [state, begin, end, grainSize, numChunks, &body] {
+        for (size_t chunk = state->nextChunk++; chunk < numChunks; chunk = state->nextChunk++) {
+            const size_t chunkBegin = begin + chunk * grainSize;
+            try {
+                body(chunkBegin, std::min(end, chunkBegin + grainSize));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+            if (++state->finishedChunks == numChunks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    const size_t numHelpers = std::min(m_threads.size(), numChunks - 1);
+    for (size_t i = 0; i < numHelpers; ++i) {
+        enqueue(work);
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->finishedChunks == numChunks; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push(std::move(job));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+            if (m_stop && m_jobs.empty()) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop();
+        }
+        job();
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t numThreads);
+    ~ThreadPool();
+
+    // shared pool with one worker per hardware thread
+    static ThreadPool& instance();
+
+    size_t numThreads() const;
+
+    template <typename Task> std::future<typename std::result_of<Task()>::type> submit(Task task) {
+        using ResultType = typename std::result_of<Task()>::type;
+        auto packagedTask = std::make_shared<std::packaged_task<ResultType()>>(std::move(task));
+        auto future = packagedTask->get_future();
+        enqueue([packagedTask] { (*packagedTask)(); });
+        return future;
+    }
+
+    // calls body(rangeBegin, rangeEnd) for chunks of at most grainSize elements and blocks until all chunks are done; the calling
+    // thread processes chunks as well, so parallelFor may be nested inside pool tasks
+    void parallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+private:
+    void enqueue(std::function<void()> job);
+    void workerLoop();
+
+private:
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop;
+};
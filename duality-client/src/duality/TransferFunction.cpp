@@ -4,9 +4,15 @@
 
 #include "mocca/base/StringTools.h"
 
+#include <atomic>
 #include <cmath>
 #include <string>
 
+namespace {
+std::atomic<uint64_t> nextGeneration(1);
+const float sampleDistanceSteps = 4.0f;
+}
+
 TransferFunctionData duality::defaultTransferFunctionData() {
     TransferFunctionData tf;
     for (int i = 0; i < 256; ++i) {
@@ -19,23 +25,43 @@ TransferFunctionData duality::defaultTransferFunctionData() {
 
 TransferFunction::TransferFunction(std::unique_ptr<DataProvider> provider)
     : m_provider(std::move(provider))
-    , m_initRequired(true) {}
+    , m_initRequired(true)
+    , m_generation(0) {}
 
 void TransferFunction::update() {
     if (m_provider != nullptr) {
         auto data = m_provider->fetch();
         if (data != nullptr) {
             readData(*data);
+            m_generation = nextGeneration++;
             m_initRequired = true;
         }
     } else {
         m_data = duality::defaultTransferFunctionData();
+        m_generation = nextGeneration++;
         m_initRequired = true;
     }
 }
 
-void TransferFunction::bindTexture() const {
-    m_texture->bindWithUnit(0);
+void TransferFunction::bindTexture(float sampleDistance) const {
+    const int key = static_cast<int>(std::round(sampleDistance * sampleDistanceSteps));
+    if (key == static_cast<int>(sampleDistanceSteps) || key <= 0) {
+        m_texture->bindWithUnit(0);
+        return;
+    }
+    auto& texture = m_correctedTextures[key];
+    if (texture == nullptr) {
+        texture = createTexture(key / sampleDistanceSteps);
+    }
+    texture->bindWithUnit(0);
+}
+
+const TransferFunctionData& TransferFunction::data() const {
+    return m_data;
+}
+
+uint64_t TransferFunction::generation() const {
+    return m_generation;
 }
 
 void TransferFunction::readData(const std::vector<uint8_t>& data) {
@@ -63,14 +89,18 @@ void TransferFunction::initTexture() {
         return;
     }
     
+    m_texture = createTexture(1.0f);
+    m_correctedTextures.clear();
+    m_initRequired = false;
+}
+
+std::unique_ptr<GLTexture2D> TransferFunction::createTexture(float sampleDistance) const {
     // apply opacity correction
     TransferFunctionData correctedTf = m_data;
-    float quality = 1.0f;
     for (int i = 0; i < 256; i++) {
         double alpha = correctedTf[i][3] / 255.0;
-        alpha = 1.0 - std::pow(1.0 - alpha, 1.0 / quality);
+        alpha = 1.0 - std::pow(1.0 - alpha, sampleDistance);
         correctedTf[i][3] = static_cast<uint8_t>(255.0 * alpha);
     }
-    m_texture = std::make_unique<GLTexture2D>(correctedTf.data(), GLTexture2D::TextureData::Color, 256, 1);
-    m_initRequired = false;
+    return std::make_unique<GLTexture2D>(correctedTf.data(), GLTexture2D::TextureData::Color, 256, 1);
 }
@@ -4,6 +4,8 @@
 #include "src/duality/GLTexture2D.h"
 
 #include <array>
+#include <cstdint>
+#include <map>
 #include <memory>
 
 using TransferFunctionData = std::array<std::array<uint8_t, 4>, 256>;
@@ -14,16 +16,26 @@ public:
 
     void update();
     void initTexture();
-    void bindTexture() const;
+    // binds the table for samples that are sampleDistance times as far apart as the voxels, with the opacities corrected accordingly;
+    // tables other than the one for a distance of 1 are created on first use
+    void bindTexture(float sampleDistance = 1.0f) const;
+
+    const TransferFunctionData& data() const;
+    // changes whenever the data has changed, unique among all transfer functions
+    uint64_t generation() const;
 
 private:
     void readData(const std::vector<uint8_t>& data);
+    std::unique_ptr<GLTexture2D> createTexture(float sampleDistance) const;
 
 private:
     std::unique_ptr<DataProvider> m_provider;
     bool m_initRequired;
     TransferFunctionData m_data;
+    uint64_t m_generation;
     std::unique_ptr<GLTexture2D> m_texture;
+    // by sample distance in units of 1 / sampleDistanceSteps
+    mutable std::map<int, std::unique_ptr<GLTexture2D>> m_correctedTextures;
 };
 
 
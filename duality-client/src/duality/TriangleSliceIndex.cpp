@@ -0,0 +1,103 @@
+#include "src/duality/TriangleSliceIndex.h"
+
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+const uint32_t trianglesPerBucket = 64;
+const uint32_t maxBuckets = 1 << 16;
+// triangles spanning more buckets go into the spanning list, which bounds the size of the index by maxBucketsPerTriangle entries per
+// triangle
+const uint32_t maxBucketsPerTriangle = 8;
+}
+
+TriangleSliceIndex::TriangleSliceIndex(const G3D::GeometrySoA& geometry, CoordinateAxis axis)
+    : m_min(std::numeric_limits<float>::max())
+    , m_max(-std::numeric_limits<float>::max())
+    , m_bucketScale(0.0f) {
+    const uint32_t numTriangles = geometry.info.numberIndices / 3;
+    if (numTriangles == 0) {
+        return;
+    }
+
+    // extent of every triangle along the axis
+    const float* positions = geometry.positions;
+    const uint32_t* indices = geometry.indices.data();
+    std::vector<std::pair<float, float>> extents(numTriangles);
+    ThreadPool::instance().parallelFor(0, numTriangles, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t triangle = begin; triangle < end; ++triangle) {
+            const float a = positions[3 * indices[3 * triangle] + axis];
+            const float b = positions[3 * indices[3 * triangle + 1] + axis];
+            const float c = positions[3 * indices[3 * triangle + 2] + axis];
+            extents[triangle] = std::make_pair(std::min(a, std::min(b, c)), std::max(a, std::max(b, c)));
+        }
+    });
+    for (const auto& extent : extents) {
+        m_min = std::min(m_min, extent.first);
+        m_max = std::max(m_max, extent.second);
+    }
+
+    const uint32_t numBuckets = std::max<uint32_t>(1, std::min(maxBuckets, numTriangles / trianglesPerBucket));
+    m_bucketScale = m_max > m_min ? numBuckets / (m_max - m_min) : 0.0f;
+    auto bucket = [&](float depth) {
+        return std::min<uint32_t>(numBuckets - 1, static_cast<uint32_t>(std::max(0.0f, (depth - m_min) * m_bucketScale)));
+    };
+
+    // counting sort into the buckets; triangles are appended in ascending order
+    m_bucketOffsets.assign(numBuckets + 1, 0);
+    for (uint32_t triangle = 0; triangle < numTriangles; ++triangle) {
+        const uint32_t first = bucket(extents[triangle].first);
+        const uint32_t last = bucket(extents[triangle].second);
+        if (last - first >= maxBucketsPerTriangle) {
+            m_spanningTriangles.push_back(triangle);
+            m_spanningExtents.push_back(extents[triangle]);
+            continue;
+        }
+        for (uint32_t b = first; b <= last; ++b) {
+            ++m_bucketOffsets[b + 1];
+        }
+    }
+    for (uint32_t b = 0; b < numBuckets; ++b) {
+        m_bucketOffsets[b + 1] += m_bucketOffsets[b];
+    }
+    m_triangles.resize(m_bucketOffsets[numBuckets]);
+    std::vector<size_t> fill(m_bucketOffsets.begin(), m_bucketOffsets.end() - 1);
+    for (uint32_t triangle = 0; triangle < numTriangles; ++triangle) {
+        const uint32_t first = bucket(extents[triangle].first);
+        const uint32_t last = bucket(extents[triangle].second);
+        if (last - first < maxBucketsPerTriangle) {
+            for (uint32_t b = first; b <= last; ++b) {
+                m_triangles[fill[b]++] = triangle;
+            }
+        }
+    }
+}
+
+void TriangleSliceIndex::candidates(float depth, std::vector<uint32_t>& triangles) const {
+    triangles.clear();
+    if (m_bucketOffsets.empty() || depth < m_min || depth > m_max) {
+        return;
+    }
+    const size_t numBuckets = m_bucketOffsets.size() - 1;
+    const size_t b = std::min<size_t>(numBuckets - 1, static_cast<size_t>((depth - m_min) * m_bucketScale));
+    const uint32_t* bucketBegin = m_triangles.data() + m_bucketOffsets[b];
+    const uint32_t* bucketEnd = m_triangles.data() + m_bucketOffsets[b + 1];
+    // both lists are in ascending order
+    triangles.reserve(static_cast<size_t>(bucketEnd - bucketBegin) + m_spanningTriangles.size());
+    size_t spanning = 0;
+    // appends the spanning triangles below limit whose extent contains depth
+    auto mergeSpanning = [&](uint32_t limit) {
+        for (; spanning < m_spanningTriangles.size() && m_spanningTriangles[spanning] < limit; ++spanning) {
+            if (m_spanningExtents[spanning].first <= depth && depth <= m_spanningExtents[spanning].second) {
+                triangles.push_back(m_spanningTriangles[spanning]);
+            }
+        }
+    };
+    for (const uint32_t* it = bucketBegin; it != bucketEnd; ++it) {
+        mergeSpanning(*it);
+        triangles.push_back(*it);
+    }
+    mergeSpanning(std::numeric_limits<uint32_t>::max());
+}
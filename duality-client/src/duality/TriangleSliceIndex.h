@@ -0,0 +1,31 @@
+#pragma once
+
+#include "duality/CoordinateSystem.h"
+#include "src/duality/G3D.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// buckets the triangles of a geometry along one axis, so that the triangles crossing the plane axis = depth can be enumerated
+// without visiting the whole mesh; a triangle is stored in every bucket its extent along the axis overlaps, unless it spans many
+// buckets, which is common for long triangles in CAD models and for surfaces parallel to the axis. Those are kept in a separate list
+// that is checked for every query, so the index stays linear in the number of triangles.
+class TriangleSliceIndex {
+public:
+    TriangleSliceIndex(const G3D::GeometrySoA& geometry, CoordinateAxis axis);
+
+    // replaces triangles with the triangles (primitive indices, i.e. offsets into geometry.indices divided by 3) whose extent may contain
+    // depth, in ascending order
+    void candidates(float depth, std::vector<uint32_t>& triangles) const;
+
+private:
+    float m_min;
+    float m_max;
+    float m_bucketScale;
+    std::vector<size_t> m_bucketOffsets;
+    std::vector<uint32_t> m_triangles;
+    // triangles that span more than maxBucketsPerTriangle buckets, in ascending order, and their extents
+    std::vector<uint32_t> m_spanningTriangles;
+    std::vector<std::pair<float, float>> m_spanningExtents;
+};
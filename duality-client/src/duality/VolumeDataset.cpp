@@ -1,19 +1,88 @@
+#include "duality/Error.h"
 #include "src/duality/AbstractIO.h"
+#include "src/duality/GradientEstimator.h"
+#include "src/duality/ThreadPool.h"
 #include "src/duality/VolumeDataset.h"
+#include "src/duality/VolumePyramid.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 
+namespace {
+std::atomic<uint64_t> nextGeneration(1);
+// coarser levels would not be worth the textures
+const size_t minPyramidSize = 32;
+// transfer functions whose visible regions are cached per stack
+const size_t maxCachedTransferFunctions = 4;
+
+using Texel = SliceStackBuilder::Texel;
+
+void cropSlice(const Texel* texels, size_t sliceWidth, const SliceOccupancy::TexelRect& crop, std::vector<Texel>& cropped) {
+    cropped.resize(static_cast<size_t>(crop.size.x) * crop.size.y);
+    for (size_t v = 0; v < crop.size.y; ++v) {
+        const Texel* row = texels + (crop.min.y + v) * sliceWidth + crop.min.x;
+        std::copy(row, row + crop.size.x, cropped.data() + v * crop.size.x);
+    }
+}
+
+SliceOccupancy::TexelRect unite(const SliceOccupancy::TexelRect& lhs, const SliceOccupancy::TexelRect& rhs) {
+    if (lhs.empty() || rhs.empty()) {
+        return lhs.empty() ? rhs : lhs;
+    }
+    const IVDA::Vec2ui min(std::min(lhs.min.x, rhs.min.x), std::min(lhs.min.y, rhs.min.y));
+    const IVDA::Vec2ui end(std::max(lhs.min.x + lhs.size.x, rhs.min.x + rhs.size.x),
+                           std::max(lhs.min.y + lhs.size.y, rhs.min.y + rhs.size.y));
+    return SliceOccupancy::TexelRect{min, end - min};
+}
+
+SliceOccupancy::TexelRect grow(const SliceOccupancy::TexelRect& rect, const IVDA::Vec2ui& sliceSize) {
+    if (rect.empty()) {
+        return rect;
+    }
+    const IVDA::Vec2ui min(rect.min.x > 0 ? rect.min.x - 1 : 0, rect.min.y > 0 ? rect.min.y - 1 : 0);
+    const IVDA::Vec2ui end(std::min(sliceSize.x, rect.min.x + rect.size.x + 1), std::min(sliceSize.y, rect.min.y + rect.size.y + 1));
+    return SliceOccupancy::TexelRect{min, end - min};
+}
+
+// texture coordinates are relative to texel edges, the single texel of empty slices is sampled in its center
+IVDA::Vec4f texTransform(const SliceOccupancy::TexelRect& crop, const IVDA::Vec2ui& sliceSize) {
+    if (crop.empty()) {
+        return IVDA::Vec4f(0.0f, 0.0f, 0.5f, 0.5f);
+    }
+    return IVDA::Vec4f(static_cast<float>(sliceSize.x) / crop.size.x, static_cast<float>(sliceSize.y) / crop.size.y,
+                       -static_cast<float>(crop.min.x) / crop.size.x, -static_cast<float>(crop.min.y) / crop.size.y);
+}
+}
+
 VolumeDataset::VolumeDataset(std::unique_ptr<DataProvider> provider)
     : m_provider(std::move(provider))
-    , m_initRequired(true) {}
+    , m_initRequired(true)
+    , m_volumesHaveGradients(true)
+    , m_lastBoundLevel(0)
+    , m_lastBoundDir(0)
+    , m_generation(0) {}
 
 void VolumeDataset::updateDataset() {
     auto data = m_provider->fetch();
     if (data != nullptr) {
         ReaderFromMemory reader(reinterpret_cast<const char*>(data->data()), data->size());
-        m_volume = std::make_unique<I3M::Volume>();
-        I3M::read(reader, *m_volume);
+        auto volume = std::make_shared<I3M::Volume>();
+        I3M::read(reader, *volume);
+        // the lit shaders of volumes that only carry scalars get the gradients of each level per stack, when it is extracted
+        m_volumesHaveGradients = GradientEstimator::hasGradients(*volume);
+        m_volumes = VolumePyramid::build(std::move(volume), minPyramidSize);
+        auto fullResolution = m_volumes.front();
+        m_statistics = ThreadPool::instance()
+                           .submit([fullResolution] {
+                               const VolumeStatistics::Options options(true, true);
+                               return std::make_shared<const VolumeStatistics>(VolumeStatistics::compute(*fullResolution, options));
+                           })
+                           .share();
+        m_occupancies.clear();
+        for (const auto& level : m_volumes) {
+            m_occupancies.push_back(std::make_shared<SliceOccupancy>(*level));
+        }
         m_initRequired = true;
     }
 }
@@ -23,28 +92,114 @@ void VolumeDataset::initializeDataset() {
         return;
     }
     
-    initSliceInfos();
-    initTextures();
+    // stacks are built on first use; pending prefetches keep working on the previous volume and are dropped
+    m_levels.clear();
+    m_levels.resize(m_volumes.size());
+    for (size_t i = 0; i < m_volumes.size(); ++i) {
+        m_levels[i].volume = m_volumes[i];
+        m_levels[i].occupancy = m_occupancies[i];
+        m_levels[i].computeGradients = !m_volumesHaveGradients;
+        initSliceInfos(m_levels[i]);
+    }
+    m_lastBoundLevel = 0;
+    m_generation = nextGeneration++;
     m_initRequired = false;
 }
 
-const std::array<std::vector<VolumeDataset::SliceInfo>, 3>& VolumeDataset::sliceInfos() const {
-    return m_sliceInfos;
+size_t VolumeDataset::numLevels() const {
+    return m_levels.size();
+}
+
+const std::array<std::vector<VolumeDataset::SliceInfo>, 3>& VolumeDataset::sliceInfos(size_t level) const {
+    return m_levels[level].sliceInfos;
 }
 
 BoundingBox VolumeDataset::boundingBox() const {
-    return BoundingBox{-0.5f * m_volume->info.scale, 0.5f * m_volume->info.scale};
+    const auto& scale = m_volumes.front()->info.scale;
+    return BoundingBox{-0.5f * scale, 0.5f * scale};
+}
+
+const I3M::Volume& VolumeDataset::volume(size_t level) const {
+    return *m_levels[level].volume;
+}
+
+bool VolumeDataset::hasGradients() const {
+    return m_levels.empty() || !m_levels.front().computeGradients;
+}
+
+uint64_t VolumeDataset::generation() const {
+    return m_generation;
 }
 
-void VolumeDataset::bindTextures(size_t dir, size_t texIndex1, size_t texIndex2) const {
-    m_textures[dir][texIndex1]->bindWithUnit(1);
-    m_textures[dir][texIndex2]->bindWithUnit(2);
+const VolumeStatistics& VolumeDataset::statistics() const {
+    if (!m_statistics.valid()) {
+        throw Error("Volume statistics requested before the volume has been read", __FILE__, __LINE__);
+    }
+    return *m_statistics.get();
 }
 
-void VolumeDataset::initSliceInfos() {
+const SliceOccupancy::Region& VolumeDataset::visibleRegion(size_t dir, size_t slice, const TransferFunction& tf, size_t level) const {
+    Level& l = m_levels[level];
+    auto& cache = l.visibleRegions[dir];
+    const auto& sliceInfos = l.sliceInfos[dir];
+    auto it = std::find_if(begin(cache), end(cache), [&](const VisibleRegions& entry) { return entry.tfGeneration == tf.generation(); });
+    if (it == end(cache)) {
+        // replaces the least recently used entry
+        if (cache.size() < maxCachedTransferFunctions) {
+            cache.emplace_back();
+        }
+        it = end(cache) - 1;
+        VisibleRegions& visibleRegions = *it;
+        const auto visible = SliceOccupancy::visibleValues(tf.data());
+        visibleRegions.regions.resize(sliceInfos.size());
+        ThreadPool::instance().parallelFor(0, sliceInfos.size(), 64, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                visibleRegions.regions[i] = l.occupancy->visibleRegion(static_cast<CoordinateAxis>(dir), sliceInfos[i].textureIndex1,
+                                                                      sliceInfos[i].textureIndex2, visible);
+            }
+        });
+        visibleRegions.tfGeneration = tf.generation();
+    }
+    std::rotate(begin(cache), it, it + 1);
+    return cache.front().regions[slice];
+}
+
+void VolumeDataset::bindTextures(size_t dir, size_t texIndex1, size_t texIndex2, size_t level) const {
+    Level& l = m_levels[level];
+    if (l.textures[dir].empty()) {
+        createTextures(l, dir);
+    }
+    m_lastBoundLevel = level;
+    m_lastBoundDir = dir;
+    l.textures[dir][texIndex1]->bindWithUnit(1);
+    l.textures[dir][texIndex2]->bindWithUnit(2);
+}
+
+void VolumeDataset::initSliceInfos(Level& level) const {
     BoundingBox bb = boundingBox();
-    const auto& volumeInfo = m_volume->info;
+    const auto& volumeInfo = level.volume->info;
+    auto& sliceInfos = level.sliceInfos;
     for (size_t dir = 0; dir < 3; ++dir) {
+        const CoordinateAxis axis = static_cast<CoordinateAxis>(dir);
+        const IVDA::Vec2ui sliceSize = SliceStackBuilder::sliceSize(volumeInfo, axis);
+        auto& crops = level.crops[dir];
+        for (size_t i = 0; i < volumeInfo.size[dir]; ++i) {
+            crops.push_back(level.occupancy->occupiedTexels(axis, i));
+        }
+        if (level.computeGradients) {
+            // the occupancy only knows the scalars, but the gradients of a slice are non zero next to the scalars of its neighbours and
+            // on the zero ring around its own; one more ring keeps the texels that clamping repeats at zero gradients
+            const auto scalarCrops = crops;
+            for (size_t i = 0; i < crops.size(); ++i) {
+                if (i > 0) {
+                    crops[i] = unite(crops[i], scalarCrops[i - 1]);
+                }
+                if (i + 1 < crops.size()) {
+                    crops[i] = unite(crops[i], scalarCrops[i + 1]);
+                }
+                crops[i] = grow(crops[i], sliceSize);
+            }
+        }
         for (size_t i = 0; i < volumeInfo.size[dir]; ++i) {
             float normalizedPosInStack = static_cast<float>(i) / static_cast<float>(volumeInfo.size[dir] - 1);
             float depth = bb.min[dir] * (1.0f - normalizedPosInStack) + bb.max[dir] * normalizedPosInStack;
@@ -52,61 +207,111 @@ void VolumeDataset::initSliceInfos() {
             size_t sliceIndex1 = std::min<size_t>(static_cast<size_t>(sliceIndex), volumeInfo.size[dir] - 1);
             size_t sliceIndex2 = std::min<size_t>(sliceIndex1 + 1, volumeInfo.size[dir] - 1);
             float interpolationParam = sliceIndex - sliceIndex1;
-            m_sliceInfos[dir].push_back(SliceInfo{depth, sliceIndex1, sliceIndex2, interpolationParam});
+            sliceInfos[dir].push_back(SliceInfo{depth, sliceIndex1, sliceIndex2, interpolationParam,
+                                                texTransform(crops[sliceIndex1], sliceSize), texTransform(crops[sliceIndex2], sliceSize)});
         }
     }
 
     for (size_t dir = 0; dir < 3; ++dir) {
-        std::sort(begin(m_sliceInfos[dir]), end(m_sliceInfos[dir]),
+        std::sort(begin(sliceInfos[dir]), end(sliceInfos[dir]),
                   [](const SliceInfo& s1, const SliceInfo& s2) { return s1.depth < s2.depth; });
     }
 }
 
-void VolumeDataset::initTextures() {
-    for (size_t dir = 0; dir < 3; ++dir) {
-        int sizeU = 0, sizeV = 0, sizeW = 0;
-        switch (dir) {
-        case 0:
-            sizeU = m_volume->info.size.y;
-            sizeV = m_volume->info.size.z;
-            sizeW = m_volume->info.size.x;
-            break;
-        case 1:
-            sizeU = m_volume->info.size.x;
-            sizeV = m_volume->info.size.z;
-            sizeW = m_volume->info.size.y;
-            break;
-        case 2:
-            sizeU = m_volume->info.size.x;
-            sizeV = m_volume->info.size.y;
-            sizeW = m_volume->info.size.z;
-            break;
-        }
+void VolumeDataset::prefetchStack(CoordinateAxis axis, size_t level) const {
+    Level& l = m_levels[level];
+    if (!l.textures[axis].empty() || l.prefetchedSlices[axis].valid()) {
+        return;
+    }
+    auto volume = l.volume;
+    const auto& crops = l.crops[axis];
+    const bool computeGradients = l.computeGradients;
+    l.prefetchedSlices[axis] = ThreadPool::instance()
+                                   .submit([volume, crops, axis, computeGradients] {
+                                       return extractStack(*volume, crops, axis, computeGradients);
+                                   })
+                                   .share();
+}
 
-        std::vector<std::array<uint8_t, 4>> pixels(sizeU * sizeV);
-        for (size_t slice = 0; slice < sizeW; ++slice) {
-            for (size_t v = 0; v < sizeV; ++v) {
-                for (size_t u = 0; u < sizeU; ++u) {
-                    size_t index = 0;
-                    switch (dir) {
-                    case 0:
-                        index = texelIndexInVolume(slice, u, v);
-                        break;
-                    case 1:
-                        index = texelIndexInVolume(u, slice, v);
-                        break;
-                    case 2:
-                        index = texelIndexInVolume(u, v, slice);
-                        break;
-                    }
-                    pixels[v * sizeU + u] = m_volume->voxels[index];
+std::shared_ptr<const VolumeDataset::Slices> VolumeDataset::extractStack(const I3M::Volume& volume,
+                                                                         const std::vector<SliceOccupancy::TexelRect>& crops,
+                                                                         CoordinateAxis axis, bool computeGradients) {
+    const IVDA::Vec2ui size = SliceStackBuilder::sliceSize(volume.info, axis);
+    auto slices = std::make_shared<Slices>(SliceStackBuilder::numSlices(volume.info, axis));
+    ThreadPool::instance().parallelFor(0, slices->size(), 16, [&](size_t first, size_t last) {
+        std::vector<Texel> texels((last - first) * size.x * size.y);
+        std::vector<Texel*> targets;
+        for (size_t slice = first; slice < last; ++slice) {
+            targets.push_back(texels.data() + (slice - first) * size.x * size.y);
+        }
+        SliceStackBuilder::extractSlices(volume, axis, first, last, targets.data());
+        for (size_t slice = first; slice < last; ++slice) {
+            if (!crops[slice].empty()) {
+                if (computeGradients) {
+                    GradientEstimator::computeSliceGradients(volume, axis, slice, targets[slice - first]);
                 }
+                cropSlice(targets[slice - first], size.x, crops[slice], (*slices)[slice]);
+            }
+        }
+    });
+    return slices;
+}
+
+void VolumeDataset::evictUnusedStacks() {
+    for (size_t level = 0; level < m_levels.size(); ++level) {
+        for (size_t dir = 0; dir < 3; ++dir) {
+            if (level != m_lastBoundLevel || dir != m_lastBoundDir) {
+                m_levels[level].textures[dir].clear();
+                m_levels[level].prefetchedSlices[dir] = {};
             }
-            m_textures[dir].push_back(std::make_unique<GLTexture2D>(pixels.data(), GLTexture2D::TextureData::Color, sizeU, sizeV));
         }
     }
 }
 
-size_t VolumeDataset::texelIndexInVolume(size_t x, size_t y, size_t z) {
-    return x + y * m_volume->info.size.x + z * m_volume->info.size.x * m_volume->info.size.y;
-}
\ No newline at end of file
+void VolumeDataset::createTextures(Level& level, size_t dir) const {
+    // slices are extracted in parallel (or have been prefetched), the textures are created on the calling thread, which owns the GL
+    // context
+    const CoordinateAxis axis = static_cast<CoordinateAxis>(dir);
+    const IVDA::Vec2ui size = SliceStackBuilder::sliceSize(level.volume->info, axis);
+    const auto& crops = level.crops[dir];
+    auto uploadCropped = [&](size_t slice, const Texel* texels) {
+        if (crops[slice].empty()) {
+            if (m_emptyTexture == nullptr) {
+                const Texel zero = {0, 0, 0, 0};
+                m_emptyTexture = std::make_shared<GLTexture2D>(&zero, GLTexture2D::TextureData::Color, 1, 1);
+            }
+            level.textures[dir][slice] = m_emptyTexture;
+        } else {
+            level.textures[dir][slice] =
+                std::make_shared<GLTexture2D>(texels, GLTexture2D::TextureData::Color, crops[slice].size.x, crops[slice].size.y);
+        }
+    };
+    level.textures[dir].resize(SliceStackBuilder::numSlices(level.volume->info, axis));
+    if (level.prefetchedSlices[dir].valid()) {
+        auto slices = level.prefetchedSlices[dir].get();
+        level.prefetchedSlices[dir] = {};
+        for (size_t slice = 0; slice < slices->size(); ++slice) {
+            uploadCropped(slice, (*slices)[slice].data());
+        }
+    } else {
+        std::vector<Texel> cropped;
+        const I3M::Volume& volume = *level.volume;
+        auto computeGradients = [&](size_t slice, Texel* texels) {
+            if (!crops[slice].empty()) {
+                GradientEstimator::computeSliceGradients(volume, axis, slice, texels);
+            }
+        };
+        SliceStackBuilder::build(
+            volume, axis,
+            [&](size_t slice, const Texel* texels) {
+                const auto& crop = crops[slice];
+                if (crop.empty() || (crop.size.x == size.x && crop.size.y == size.y)) {
+                    uploadCropped(slice, texels);
+                } else {
+                    cropSlice(texels, size.x, crop, cropped);
+                    uploadCropped(slice, cropped.data());
+                }
+            },
+            level.computeGradients ? computeGradients : std::function<void(size_t, Texel*)>());
+    }
+}
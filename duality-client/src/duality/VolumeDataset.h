@@ -1,12 +1,20 @@
 #pragma once
 
+#include "duality/CoordinateSystem.h"
 #include "src/duality/BoundingBox.h"
 #include "src/duality/DataProvider.h"
 #include "src/duality/GLTexture2D.h"
 #include "src/duality/I3M.h"
+#include "src/duality/SliceOccupancy.h"
+#include "src/duality/SliceStackBuilder.h"
 #include "src/duality/TransferFunction.h"
+#include "src/duality/VolumeStatistics.h"
 
 #include <array>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
 
 class VolumeDataset {
 public:
@@ -20,21 +28,74 @@ public:
         size_t textureIndex1;
         size_t textureIndex2;
         float interpolationParam;
+        // textures only store the part of a slice that is not zero; these map the texture coordinates of the whole slice to the
+        // coordinates of the stored part as (scale.x, scale.y, offset.x, offset.y)
+        IVDA::Vec4f texTransform1;
+        IVDA::Vec4f texTransform2;
     };
-    const std::array<std::vector<SliceInfo>, 3>& sliceInfos() const;
+    // level 0 is the full resolution, every further level halves the resolution
+    size_t numLevels() const;
+    const std::array<std::vector<SliceInfo>, 3>& sliceInfos(size_t level = 0) const;
     BoundingBox boundingBox() const;
+    // the voxels of a level, e.g. for rendering on the CPU
+    const I3M::Volume& volume(size_t level = 0) const;
+    // false if the volume only carries scalars; its gradients are then only computed for the slices of a stack when they are extracted
+    bool hasGradients() const;
+    // changes whenever the volume has changed
+    uint64_t generation() const;
+    // histograms of the full resolution volume, e.g. for editing transfer functions; they are computed in the background when the
+    // volume has been read, this blocks until they are available
+    const VolumeStatistics& statistics() const;
 
-    void bindTextures(size_t dir, size_t texIndex1, size_t texIndex2) const;
+    // the part of a slice (an index into sliceInfos) that is not fully transparent under the transfer function; the regions of a stack
+    // are cached for the few most recently used transfer functions, since nodes that share the dataset have their own
+    const SliceOccupancy::Region& visibleRegion(size_t dir, size_t slice, const TransferFunction& tf, size_t level = 0) const;
+
+    // the slice textures along an axis are created when the axis is first bound, which has to happen on the GL thread
+    void bindTextures(size_t dir, size_t texIndex1, size_t texIndex2, size_t level = 0) const;
+    // extracts the slices along the axis in the background, so that creating its textures later only requires the upload
+    void prefetchStack(CoordinateAxis axis, size_t level = 0) const;
+    // deletes the textures and prefetched slices of all stacks but the most recently bound one
+    void evictUnusedStacks();
 
 private:
-    void initSliceInfos();
-    void initTextures();
-    size_t texelIndexInVolume(size_t x, size_t y, size_t z);
+    using Slices = std::vector<std::vector<SliceStackBuilder::Texel>>;
+
+    struct VisibleRegions {
+        uint64_t tfGeneration;
+        std::vector<SliceOccupancy::Region> regions;
+    };
+    struct Level {
+        // shared with prefetch tasks
+        std::shared_ptr<const I3M::Volume> volume;
+        std::shared_ptr<const SliceOccupancy> occupancy;
+        bool computeGradients;
+        std::array<std::vector<SliceInfo>, 3> sliceInfos;
+        // most recently used first
+        std::array<std::vector<VisibleRegions>, 3> visibleRegions;
+        // the stored part of every slice
+        std::array<std::vector<SliceOccupancy::TexelRect>, 3> crops;
+        // empty slices share m_emptyTexture
+        std::array<std::vector<std::shared_ptr<GLTexture2D>>, 3> textures;
+        std::array<std::shared_future<std::shared_ptr<const Slices>>, 3> prefetchedSlices;
+    };
+
+    void initSliceInfos(Level& level) const;
+    static std::shared_ptr<const Slices> extractStack(const I3M::Volume& volume, const std::vector<SliceOccupancy::TexelRect>& crops,
+                                                      CoordinateAxis axis, bool computeGradients);
+    void createTextures(Level& level, size_t dir) const;
 
 private:
     std::unique_ptr<DataProvider> m_provider;
     bool m_initRequired;
-    std::unique_ptr<I3M::Volume> m_volume;
-    std::array<std::vector<SliceInfo>, 3> m_sliceInfos;
-    std::array<std::vector<std::unique_ptr<GLTexture2D>>, 3> m_textures;
+    // the pyramid is built when the volume is read, the levels are set up on initialization
+    std::vector<std::shared_ptr<const I3M::Volume>> m_volumes;
+    std::vector<std::shared_ptr<const SliceOccupancy>> m_occupancies;
+    bool m_volumesHaveGradients;
+    std::shared_future<std::shared_ptr<const VolumeStatistics>> m_statistics;
+    mutable std::vector<Level> m_levels;
+    mutable std::shared_ptr<GLTexture2D> m_emptyTexture;
+    mutable size_t m_lastBoundLevel;
+    mutable size_t m_lastBoundDir;
+    uint64_t m_generation;
 };
\ No newline at end of file
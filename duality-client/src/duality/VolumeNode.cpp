@@ -1,7 +1,7 @@
 #include "src/duality/VolumeNode.h"
 
-VolumeNode::VolumeNode(const std::string& name, Visibility visibility, std::unique_ptr<VolumeDataset> dataset,
-                       std::unique_ptr<TransferFunction> tf)
+VolumeNode::VolumeNode(const std::string& name, Visibility visibility, std::shared_ptr<VolumeDataset> dataset,
+                       std::shared_ptr<TransferFunction> tf)
     : SceneNode(name, visibility)
     , m_dataset(std::move(dataset))
     , m_tf(std::move(tf))
@@ -15,6 +15,14 @@ void VolumeNode::render(RenderDispatcher3D& dispatcher) {
     dispatcher.dispatch(*this);
 }
 
+void VolumeNode::render(SoftwareRenderer2D& renderer) {
+    renderer.dispatch(*this);
+}
+
+void VolumeNode::render(SoftwareRenderer3D& renderer) {
+    renderer.dispatch(*this);
+}
+
 void VolumeNode::setUpdateEnabled(bool enabled) {
     m_updateEnabled = enabled;
 }
@@ -33,6 +41,10 @@ void VolumeNode::initializeDataset() {
     }
 }
 
+void VolumeNode::releaseMemory() {
+    m_dataset->evictUnusedStacks();
+}
+
 BoundingBox VolumeNode::boundingBox() const {
     return m_dataset->boundingBox();
 }
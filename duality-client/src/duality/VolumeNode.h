@@ -10,21 +10,25 @@
 
 class VolumeNode : public SceneNode {
 public:
-    VolumeNode(const std::string& name, Visibility visibility, std::unique_ptr<VolumeDataset> dataset, std::unique_ptr<TransferFunction> tf);
+    VolumeNode(const std::string& name, Visibility visibility, std::shared_ptr<VolumeDataset> dataset,
+               std::shared_ptr<TransferFunction> tf);
 
     void render(RenderDispatcher2D& dispatcher) override;
     void render(RenderDispatcher3D& dispatcher) override;
+    void render(SoftwareRenderer2D& renderer) override;
+    void render(SoftwareRenderer3D& renderer) override;
     
     void setUpdateEnabled(bool enabled) override;
     void updateDataset() override;
     void initializeDataset() override;
+    void releaseMemory() override;
     
     BoundingBox boundingBox() const override;
     const VolumeDataset& dataset() const;
     const TransferFunction& transferFunction() const;
 
 private:
-    std::unique_ptr<VolumeDataset> m_dataset;
-    std::unique_ptr<TransferFunction> m_tf;
+    std::shared_ptr<VolumeDataset> m_dataset;
+    std::shared_ptr<TransferFunction> m_tf;
     bool m_updateEnabled;
 };
\ No newline at end of file
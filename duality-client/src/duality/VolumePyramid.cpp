@@ -0,0 +1,59 @@
+#include "src/duality/VolumePyramid.h"
+
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+
+using namespace IVDA;
+
+std::vector<std::shared_ptr<const I3M::Volume>> VolumePyramid::build(std::shared_ptr<const I3M::Volume> volume, size_t minSize) {
+    std::vector<std::shared_ptr<const I3M::Volume>> levels{volume};
+    while (true) {
+        const Vec3ui& size = levels.back()->info.size;
+        if (std::max(size.x, std::max(size.y, size.z)) <= minSize || std::min(size.x, std::min(size.y, size.z)) < 4) {
+            break;
+        }
+        levels.push_back(downsample(*levels.back()));
+    }
+    return levels;
+}
+
+std::shared_ptr<I3M::Volume> VolumePyramid::downsample(const I3M::Volume& volume) {
+    const Vec3ui& size = volume.info.size;
+    auto result = std::make_shared<I3M::Volume>();
+    result->info.size = Vec3ui((size.x + 1) / 2, (size.y + 1) / 2, (size.z + 1) / 2);
+    result->info.scale = volume.info.scale;
+    const Vec3ui& coarseSize = result->info.size;
+    result->voxels.resize(static_cast<size_t>(coarseSize.x) * coarseSize.y * coarseSize.z);
+
+    auto voxel = [&](size_t x, size_t y, size_t z) -> const std::array<uint8_t, 4>& {
+        return volume.voxels[(std::min<size_t>(z, size.z - 1) * size.y + std::min<size_t>(y, size.y - 1)) * size.x +
+                             std::min<size_t>(x, size.x - 1)];
+    };
+    ThreadPool::instance().parallelFor(0, coarseSize.z, 1, [&](size_t firstZ, size_t lastZ) {
+        for (size_t z = firstZ; z < lastZ; ++z) {
+            for (size_t y = 0; y < coarseSize.y; ++y) {
+                for (size_t x = 0; x < coarseSize.x; ++x) {
+                    int gradient[3] = {0, 0, 0};
+                    int weightSum = 0;
+                    int scalarSum = 0;
+                    for (size_t i = 0; i < 8; ++i) {
+                        const auto& v = voxel(2 * x + (i & 1), 2 * y + ((i >> 1) & 1), 2 * z + (i >> 2));
+                        const int weight = v[3] + 1;
+                        for (int c = 0; c < 3; ++c) {
+                            gradient[c] += weight * v[c];
+                        }
+                        weightSum += weight;
+                        scalarSum += v[3];
+                    }
+                    auto& target = result->voxels[(z * coarseSize.y + y) * coarseSize.x + x];
+                    for (int c = 0; c < 3; ++c) {
+                        target[c] = static_cast<uint8_t>((gradient[c] + weightSum / 2) / weightSum);
+                    }
+                    target[3] = static_cast<uint8_t>((scalarSum + 4) / 8);
+                }
+            }
+        }
+    });
+    return result;
+}
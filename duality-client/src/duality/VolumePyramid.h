@@ -0,0 +1,17 @@
+#pragma once
+
+#include "src/duality/I3M.h"
+
+#include <memory>
+#include <vector>
+
+// successively halved versions of a volume for interactive rendering; all levels cover the same extent
+class VolumePyramid {
+public:
+    // level 0 is the volume itself; levels are added until the largest dimension is at most minSize or a dimension would drop below 2
+    static std::vector<std::shared_ptr<const I3M::Volume>> build(std::shared_ptr<const I3M::Volume> volume, size_t minSize);
+
+    // averages 2x2x2 blocks, the last voxel of an odd dimension is repeated; the gradients (rgb) are weighted by the scalar values
+    // (alpha), so that empty voxels do not bend the gradients of their neighbours
+    static std::shared_ptr<I3M::Volume> downsample(const I3M::Volume& volume);
+};
@@ -54,6 +54,8 @@ void VolumeRenderer2D::render(const VolumeDataset& dataset, const GLMatrix& mvp,
     m_shader->Enable();
     m_shader->SetValue("mvpMatrix", static_cast<IVDA::Mat4f>(mvp));
     m_shader->SetValue("interpolationParameter", sliceInfo.interpolationParam);
+    m_shader->SetValue("texTransform1", sliceInfo.texTransform1);
+    m_shader->SetValue("texTransform2", sliceInfo.texTransform2);
     // FIXME: hardcoded values
     m_shader->SetValue("oc", 1.0f);
     m_shader->SetValue("ignoreAlpha", false);
@@ -35,18 +35,31 @@ VolumeRenderer3D::VolumeRenderer3D() {
 
 VolumeRenderer3D::~VolumeRenderer3D() = default;
 
-void VolumeRenderer3D::render(const VolumeDataset& dataset, const MVP3D& mvp, const TransferFunction& tf) {
-    StackDirection stackDir = duality::determineStackDirection(static_cast<Mat4f>(mvp.mv()));
-    size_t stackSize = dataset.sliceInfos()[stackDir.direction].size();
-    for (size_t slice = 0; slice < stackSize; ++slice) {
-        renderPartial(dataset, mvp, tf, stackDir, slice);
+void VolumeRenderer3D::render(const VolumeDataset& dataset, const MVP3D& mvp, const TransferFunction& tf, size_t level, size_t stride) {
+    const StackDirection& stackDir = mvp.stackDirection();
+    dataset.prefetchStack(mvp.secondaryStackAxis(), level);
+    size_t stackSize = dataset.sliceInfos(level)[stackDir.direction].size();
+    for (size_t slice = 0; slice < stackSize; slice += stride) {
+        renderPartial(dataset, mvp, tf, stackDir, slice, level, stride);
     }
 }
 
-void VolumeRenderer3D::renderPartial(const VolumeDataset& dataset, const MVP3D& mvp, const TransferFunction& tf, const StackDirection& stackDir, size_t slice) {
+void VolumeRenderer3D::renderPartial(const VolumeDataset& dataset, const MVP3D& mvp, const TransferFunction& tf,
+                                     const StackDirection& stackDir, size_t slice, size_t level, size_t stride) {
+    size_t stackSize = dataset.sliceInfos(level)[stackDir.direction].size();
+    size_t index = stackDir.reverse ? (stackSize - 1 - slice) : slice;
+    // slices that are transparent under the transfer function are skipped, the others are cropped to their visible part
+    const auto& region = dataset.visibleRegion(stackDir.direction, index, tf, level);
+    if (region.empty()) {
+        return;
+    }
+    const auto& si = dataset.sliceInfos(level)[stackDir.direction][index];
+
     GLShader& shader = determineActiveShader();
     shader.Enable();
     shader.SetValue("mMVP", static_cast<IVDA::Mat4f>(mvp.mvp()));
+    shader.SetValue("texTransform1", si.texTransform1);
+    shader.SetValue("texTransform2", si.texTransform2);
     
     GL(glDepthMask(GL_FALSE));
     GL(glEnable(GL_BLEND));
@@ -54,34 +67,39 @@ void VolumeRenderer3D::renderPartial(const VolumeDataset& dataset, const MVP3D&
     GL(glEnableVertexAttribArray(0));
     GL(glEnableVertexAttribArray(1));
     
-    size_t stackSize = dataset.sliceInfos()[stackDir.direction].size();
-    size_t index = stackDir.reverse ? (stackSize - 1 - slice) : slice;
-    const auto& si = dataset.sliceInfos()[stackDir.direction][index];
-    
-    tf.bindTexture();
-    dataset.bindTextures(stackDir.direction, si.textureIndex1, si.textureIndex2);
+    tf.bindTexture(sampleDistance(dataset, stackDir.direction, level, stride));
+    dataset.bindTextures(stackDir.direction, si.textureIndex1, si.textureIndex2, level);
     
+    // the texture coordinates (u, v) of a slice map to (y, z), (x, z) and (x, y) along the axes
     BoundingBox bb = dataset.boundingBox();
+    const Vec3f extent = bb.max - bb.min;
+    const int axisU = stackDir.direction == 0 ? 1 : 0;
+    const int axisV = stackDir.direction == 2 ? 1 : 2;
+    const float minU = bb.min[axisU] + extent[axisU] * region.min.x;
+    const float maxU = bb.min[axisU] + extent[axisU] * region.max.x;
+    const float minV = bb.min[axisV] + extent[axisV] * region.min.y;
+    const float maxV = bb.min[axisV] + extent[axisV] * region.max.y;
     switch (stackDir.direction) {
         case 0: {
-            std::array<Vec3f, 4> vertices = {Vec3f(si.depth, bb.min.y, bb.min.z), Vec3f(si.depth, bb.min.y, bb.max.z),
-                Vec3f(si.depth, bb.max.y, bb.min.z), Vec3f(si.depth, bb.max.y, bb.max.z)};
+            std::array<Vec3f, 4> vertices = {Vec3f(si.depth, minU, minV), Vec3f(si.depth, minU, maxV),
+                Vec3f(si.depth, maxU, minV), Vec3f(si.depth, maxU, maxV)};
             GL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, &vertices[0]));
         } break;
         case 1: {
-            std::array<Vec3f, 4> vertices = {Vec3f(bb.min.x, si.depth, bb.min.z), Vec3f(bb.min.x, si.depth, bb.max.z),
-                Vec3f(bb.max.x, si.depth, bb.min.z), Vec3f(bb.max.x, si.depth, bb.max.z)};
+            std::array<Vec3f, 4> vertices = {Vec3f(minU, si.depth, minV), Vec3f(minU, si.depth, maxV),
+                Vec3f(maxU, si.depth, minV), Vec3f(maxU, si.depth, maxV)};
             GL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, &vertices[0]));
             
         } break;
         case 2: {
-            std::array<Vec3f, 4> vertices = {Vec3f(bb.min.x, bb.min.y, si.depth), Vec3f(bb.min.x, bb.max.y, si.depth),
-                Vec3f(bb.max.x, bb.min.y, si.depth), Vec3f(bb.max.x, bb.max.y, si.depth)};
+            std::array<Vec3f, 4> vertices = {Vec3f(minU, minV, si.depth), Vec3f(minU, maxV, si.depth),
+                Vec3f(maxU, minV, si.depth), Vec3f(maxU, maxV, si.depth)};
             GL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, &vertices[0]));
         } break;
     }
     
-    const std::array<Vec2f, 4> texCoords = {Vec2f(0, 0), Vec2f(0, 1), Vec2f(1, 0), Vec2f(1, 1)};
+    const std::array<Vec2f, 4> texCoords = {Vec2f(region.min.x, region.min.y), Vec2f(region.min.x, region.max.y),
+                                            Vec2f(region.max.x, region.min.y), Vec2f(region.max.x, region.max.y)};
     GL(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, &texCoords[0]));
     
     const std::array<GLshort, 6> indices = {0, 1, 2, 2, 1, 3};
@@ -99,46 +117,11 @@ GLShader& VolumeRenderer3D::determineActiveShader() const {
     return *m_shaderL;
 }
 
-StackDirection duality::determineStackDirection(const IVDA::Mat4f& mv) {
-    Vec4f vertex0(-0.5f, -0.5f, 0.5f, 1.0f);
-    Vec4f vertex1(0.5f, -0.5f, 0.5f, 1.0f);
-    Vec4f vertex3(-0.5f, 0.5f, 0.5f, 1.0f);
-    Vec4f vertex4(-0.5f, -0.5f, -0.5f, 1.0f);
-    Vec4f vertex6(0.5f, 0.5f, -0.5f, 1.0f);
-
-    Vec3f center = ((vertex0 * mv).xyz() + (vertex6 * mv).xyz()) / 2.0f;
-    Vec3f viewDir(0, 0, -2);
-
-    vertex0 = vertex0 * mv + viewDir;
-    vertex1 = vertex1 * mv + viewDir;
-    vertex3 = vertex3 * mv + viewDir;
-    vertex4 = vertex4 * mv + viewDir;
-    vertex6 = vertex6 * mv + viewDir;
-    center = center + viewDir;
-
-    Vec3f coordFrame[3] = {(vertex0.xyz() - vertex1.xyz()),  // X
-                           (vertex0.xyz() - vertex4.xyz()),  // Y
-                           (vertex0.xyz() - vertex3.xyz())}; // Z
-
-    for (size_t i = 0; i < 3; ++i) {
-        coordFrame[i].normalize();
+float VolumeRenderer3D::sampleDistance(const VolumeDataset& dataset, size_t dir, size_t level, size_t stride) {
+    const size_t fullSlices = dataset.sliceInfos(0)[dir].size();
+    const size_t levelSlices = dataset.sliceInfos(level)[dir].size();
+    if (levelSlices < 2) {
+        return static_cast<float>(stride);
     }
-
-    float cosX = center ^ coordFrame[0];
-    float cosY = center ^ coordFrame[1];
-    float cosZ = center ^ coordFrame[2];
-
-    StackDirection result{CoordinateAxis::Y_Axis, cosZ < 0};
-
-    if (fabs(cosX) > fabs(cosY) && fabs(cosX) > fabs(cosZ)) {
-        result.direction = CoordinateAxis::X_Axis;
-        result.reverse = cosX < 0;
-    } else {
-        if (fabs(cosY) > fabs(cosX) && fabs(cosY) > fabs(cosZ)) {
-            result.direction = CoordinateAxis::Z_Axis;
-            result.reverse = cosY > 0;
-        }
-    }
-    
-    return result;
-}
\ No newline at end of file
+    return stride * static_cast<float>(fullSlices - 1) / static_cast<float>(levelSlices - 1);
+}
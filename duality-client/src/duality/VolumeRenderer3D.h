@@ -9,25 +9,21 @@
 
 class GLShader;
 
-struct StackDirection {
-    CoordinateAxis direction;
-    bool reverse;
-};
-
-namespace duality {
-StackDirection determineStackDirection(const IVDA::Mat4f& mv);
-}
-
 class VolumeRenderer3D {
 public:
     VolumeRenderer3D();
     ~VolumeRenderer3D();
 
-    void render(const VolumeDataset& dataset, const MVP3D& mvp, const TransferFunction& tf);
-    void renderPartial(const VolumeDataset& dataset, const MVP3D& mvp, const TransferFunction& tf, const StackDirection& stackDir, size_t slice);
+    // level selects the resolution of the volume, see VolumeDataset::numLevels; only every stride-th slice is drawn, with opacities
+    // corrected for the larger distance between the slices
+    void render(const VolumeDataset& dataset, const MVP3D& mvp, const TransferFunction& tf, size_t level, size_t stride);
+    void renderPartial(const VolumeDataset& dataset, const MVP3D& mvp, const TransferFunction& tf, const StackDirection& stackDir,
+                       size_t slice, size_t level, size_t stride);
 
 private:
     GLShader& determineActiveShader() const;
+    // distance between the drawn slices relative to the voxels of the full resolution
+    static float sampleDistance(const VolumeDataset& dataset, size_t dir, size_t level, size_t stride);
 
 private:
     std::unique_ptr<GLShader> m_shaderL;
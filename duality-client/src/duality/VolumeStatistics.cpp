@@ -0,0 +1,177 @@
+#include "src/duality/VolumeStatistics.h"
+
+#include "duality/Error.h"
+#include "src/duality/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace {
+const size_t voxelsPerBlock = 4096;
+const size_t voxelsPerTask = 1024 * 1024;
+const uint32_t maxSqGradient = 3 * 128 * 128;
+
+// gradient magnitude bin by squared length of the gradient
+const std::vector<uint8_t>& magnitudeBins() {
+    static const std::vector<uint8_t> bins = [] {
+        std::vector<uint8_t> result(maxSqGradient + 1);
+        const float scale = (VolumeStatistics::numBins - 1) / std::sqrt(static_cast<float>(maxSqGradient));
+        for (uint32_t sq = 0; sq <= maxSqGradient; ++sq) {
+            result[sq] = static_cast<uint8_t>(std::min(255.0f, std::round(std::sqrt(static_cast<float>(sq)) * scale)));
+        }
+        return result;
+    }();
+    return bins;
+}
+}
+
+VolumeStatistics::VolumeStatistics(const Options& options)
+    : m_options(options)
+    , m_numVoxels(0) {
+    for (auto& histogram : m_histograms) {
+        histogram.fill(0);
+    }
+    if (options.jointHistograms) {
+        for (auto& histogram : m_jointHistograms) {
+            histogram.assign(numJointBins * numJointBins, 0);
+        }
+    }
+    if (options.gradientHistogram) {
+        m_gradientHistogram.assign(numBins * numBins, 0);
+    }
+}
+
+VolumeStatistics VolumeStatistics::compute(const I3M::Volume& volume, const Options& options) {
+    VolumeStatistics result(options);
+    std::mutex mutex;
+    ThreadPool::instance().parallelFor(0, volume.voxels.size(), voxelsPerTask, [&](size_t first, size_t last) {
+        VolumeStatistics partial(options);
+        partial.add(volume.voxels.data() + first, last - first);
+        std::lock_guard<std::mutex> lock(mutex);
+        result.merge(partial);
+    });
+    return result;
+}
+
+void VolumeStatistics::add(const std::array<uint8_t, 4>* voxels, size_t count) {
+    // four interleaved copies of the histograms, so that runs of equal values do not serialize on a single counter
+    std::array<std::array<uint32_t, 4 * numBins>, numChannels> counts;
+    std::array<uint32_t, voxelsPerBlock> sqGradients;
+    const auto& bins = magnitudeBins();
+    for (size_t blockStart = 0; blockStart < count; blockStart += voxelsPerBlock) {
+        const std::array<uint8_t, 4>* block = voxels + blockStart;
+        const size_t blockSize = std::min(voxelsPerBlock, count - blockStart);
+        for (auto& channelCounts : counts) {
+            channelCounts.fill(0);
+        }
+        for (size_t i = 0; i < blockSize; ++i) {
+            const size_t copy = (i & 3) * numBins;
+            for (size_t c = 0; c < numChannels; ++c) {
+                ++counts[c][copy + block[i][c]];
+            }
+        }
+        for (size_t c = 0; c < numChannels; ++c) {
+            for (size_t bin = 0; bin < numBins; ++bin) {
+                m_histograms[c][bin] += counts[c][bin] + counts[c][numBins + bin] + counts[c][2 * numBins + bin] +
+                                        counts[c][3 * numBins + bin];
+            }
+        }
+
+        if (m_options.jointHistograms) {
+            const size_t shift = 2; // 256 values to numJointBins bins
+            for (size_t i = 0; i < blockSize; ++i) {
+                size_t pair = 0;
+                for (size_t c1 = 0; c1 < numChannels; ++c1) {
+                    for (size_t c2 = c1 + 1; c2 < numChannels; ++c2) {
+                        ++m_jointHistograms[pair++][(block[i][c1] >> shift) * numJointBins + (block[i][c2] >> shift)];
+                    }
+                }
+            }
+        }
+
+        if (m_options.gradientHistogram) {
+            // branch free integer arithmetic, vectorized by the compiler
+            for (size_t i = 0; i < blockSize; ++i) {
+                const int32_t dx = static_cast<int32_t>(block[i][0]) - 128;
+                const int32_t dy = static_cast<int32_t>(block[i][1]) - 128;
+                const int32_t dz = static_cast<int32_t>(block[i][2]) - 128;
+                sqGradients[i] = static_cast<uint32_t>(dx * dx + dy * dy + dz * dz);
+            }
+            for (size_t i = 0; i < blockSize; ++i) {
+                ++m_gradientHistogram[block[i][3] * numBins + bins[sqGradients[i]]];
+            }
+        }
+    }
+    m_numVoxels += count;
+}
+
+void VolumeStatistics::merge(const VolumeStatistics& other) {
+    if (other.m_options.jointHistograms != m_options.jointHistograms ||
+        other.m_options.gradientHistogram != m_options.gradientHistogram) {
+        throw Error("Cannot merge volume statistics with different options", __FILE__, __LINE__);
+    }
+    for (size_t c = 0; c < numChannels; ++c) {
+        for (size_t bin = 0; bin < numBins; ++bin) {
+            m_histograms[c][bin] += other.m_histograms[c][bin];
+        }
+    }
+    for (size_t pair = 0; pair < m_jointHistograms.size(); ++pair) {
+        for (size_t bin = 0; bin < m_jointHistograms[pair].size(); ++bin) {
+            m_jointHistograms[pair][bin] += other.m_jointHistograms[pair][bin];
+        }
+    }
+    for (size_t bin = 0; bin < m_gradientHistogram.size(); ++bin) {
+        m_gradientHistogram[bin] += other.m_gradientHistogram[bin];
+    }
+    m_numVoxels += other.m_numVoxels;
+}
+
+uint64_t VolumeStatistics::numVoxels() const {
+    return m_numVoxels;
+}
+
+const VolumeStatistics::Histogram& VolumeStatistics::histogram(size_t channel) const {
+    return m_histograms[channel];
+}
+
+VolumeStatistics::ChannelSummary VolumeStatistics::summary(size_t channel) const {
+    const Histogram& histogram = m_histograms[channel];
+    ChannelSummary result{0, 0, 0.0};
+    if (m_numVoxels == 0) {
+        return result;
+    }
+    const auto first = std::find_if(begin(histogram), end(histogram), [](uint64_t count) { return count > 0; });
+    const auto last = std::find_if(histogram.rbegin(), histogram.rend(), [](uint64_t count) { return count > 0; });
+    result.min = static_cast<uint8_t>(first - begin(histogram));
+    result.max = static_cast<uint8_t>(numBins - 1 - (last - histogram.rbegin()));
+    double sum = 0.0;
+    for (size_t bin = 0; bin < numBins; ++bin) {
+        sum += static_cast<double>(bin) * histogram[bin];
+    }
+    result.mean = sum / m_numVoxels;
+    return result;
+}
+
+const std::vector<uint64_t>& VolumeStatistics::jointHistogram(size_t channel1, size_t channel2) const {
+    if (!m_options.jointHistograms) {
+        throw Error("Joint histograms have not been computed", __FILE__, __LINE__);
+    }
+    return m_jointHistograms[pairIndex(channel1, channel2)];
+}
+
+const std::vector<uint64_t>& VolumeStatistics::gradientHistogram() const {
+    if (!m_options.gradientHistogram) {
+        throw Error("Gradient histogram has not been computed", __FILE__, __LINE__);
+    }
+    return m_gradientHistogram;
+}
+
+size_t VolumeStatistics::pairIndex(size_t channel1, size_t channel2) {
+    if (channel1 >= channel2 || channel2 >= numChannels) {
+        throw Error("Invalid channel pair for joint histogram", __FILE__, __LINE__);
+    }
+    // pairs are enumerated as in add: (0, 1), (0, 2), (0, 3), (1, 2), (1, 3), (2, 3)
+    const size_t offsets[numChannels] = {0, 3, 5, 6};
+    return offsets[channel1] + channel2 - channel1 - 1;
+}
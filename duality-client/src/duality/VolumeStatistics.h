@@ -0,0 +1,65 @@
+#pragma once
+
+#include "src/duality/I3M.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// histograms of the channels of a volume, accumulated incrementally from blocks of voxels; channels 0 to 2 hold the gradient (with 128
+// as zero), channel 3 the scalar value
+class VolumeStatistics {
+public:
+    static const size_t numChannels = 4;
+    static const size_t numBins = 256;
+    // bins per channel of the joint histograms
+    static const size_t numJointBins = 64;
+
+    using Histogram = std::array<uint64_t, numBins>;
+
+    struct Options {
+        Options(bool joint, bool gradient)
+            : jointHistograms(joint)
+            , gradientHistogram(gradient) {}
+
+        // of every pair of channels
+        bool jointHistograms;
+        // of the scalar value and the gradient magnitude
+        bool gradientHistogram;
+    };
+
+    struct ChannelSummary {
+        uint8_t min;
+        uint8_t max;
+        double mean;
+    };
+
+    explicit VolumeStatistics(const Options& options);
+
+    // accumulates the whole volume in parallel
+    static VolumeStatistics compute(const I3M::Volume& volume, const Options& options);
+
+    void add(const std::array<uint8_t, 4>* voxels, size_t count);
+    // adds the voxels counted by other, which must have been created with the same options
+    void merge(const VolumeStatistics& other);
+
+    uint64_t numVoxels() const;
+    const Histogram& histogram(size_t channel) const;
+    // min and max are 0 for an empty volume
+    ChannelSummary summary(size_t channel) const;
+    // numJointBins x numJointBins bins, row major with channel1 selecting the row; channel1 < channel2
+    const std::vector<uint64_t>& jointHistogram(size_t channel1, size_t channel2) const;
+    // numBins x numBins bins, row major with the scalar value selecting the row; the gradient magnitude is scaled so that the longest
+    // encodable gradient falls into the last bin
+    const std::vector<uint64_t>& gradientHistogram() const;
+
+private:
+    static size_t pairIndex(size_t channel1, size_t channel2);
+
+private:
+    Options m_options;
+    uint64_t m_numVoxels;
+    std::array<Histogram, numChannels> m_histograms;
+    std::array<std::vector<uint64_t>, 6> m_jointHistograms;
+    std::vector<uint64_t> m_gradientHistogram;
+};
@@ -5,4 +5,5 @@
 class DataProviderMock : public DataProvider {
 public:
     MOCK_METHOD0(fetch, std::shared_ptr<std::vector<uint8_t>>());
-};
\ No newline at end of file
+    MOCK_METHOD0(notify, void());
+};
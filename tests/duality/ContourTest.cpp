@@ -0,0 +1,81 @@
+#include "gtest/gtest.h"
+
+#include "src/duality/Contour.h"
+
+#include <algorithm>
+
+using namespace ::testing;
+
+class ContourTest : public Test {
+protected:
+    ContourTest() {}
+
+    virtual ~ContourTest() {}
+
+    // unconnected segments between consecutive points, as produced by the clipper
+    std::unique_ptr<G3D::GeometrySoA> createSegments(const std::vector<float>& points, bool closed) {
+        const uint32_t numPoints = static_cast<uint32_t>(points.size() / 3);
+        const uint32_t numSegments = closed ? numPoints : numPoints - 1;
+        std::vector<uint32_t> indices;
+        std::vector<float> positions;
+        for (uint32_t i = 0; i < numSegments; ++i) {
+            for (uint32_t p : {i, (i + 1) % numPoints}) {
+                indices.push_back(static_cast<uint32_t>(indices.size()));
+                positions.insert(end(positions), points.begin() + 3 * p, points.begin() + 3 * p + 3);
+            }
+        }
+        std::vector<float> colors(4 * indices.size(), 1.0f);
+        return G3D::createLineGeometry(std::move(indices), std::move(positions), std::move(colors));
+    }
+};
+
+TEST_F(ContourTest, WeldSquare) {
+    auto segments = createSegments({0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0}, true);
+    Contour contour(*segments);
+    ASSERT_EQ(4u, contour.numPoints());
+    ASSERT_EQ(1u, contour.numPolylines());
+
+    auto lines = contour.lines(0.0f);
+    ASSERT_EQ(4u, lines->info.numberVertices);
+    ASSERT_EQ(8u, lines->info.numberIndices);
+}
+
+TEST_F(ContourTest, SimplifyCollinearPoints) {
+    std::vector<float> points;
+    for (int i = 0; i <= 100; ++i) {
+        points.insert(end(points), {i * 0.01f, 0.0f, 0.0f});
+    }
+    auto segments = createSegments(points, false);
+    Contour contour(*segments);
+    ASSERT_EQ(101u, contour.numPoints());
+    ASSERT_EQ(1u, contour.numPolylines());
+
+    ASSERT_EQ(200u, contour.lines(0.0f)->info.numberIndices);
+    auto simplified = contour.lines(0.001f);
+    ASSERT_EQ(2u, simplified->info.numberVertices);
+    ASSERT_EQ(2u, simplified->info.numberIndices);
+    // the end points remain
+    const float x0 = simplified->positions[3 * simplified->indices[0]];
+    const float x1 = simplified->positions[3 * simplified->indices[1]];
+    ASSERT_FLOAT_EQ(0.0f, std::min(x0, x1));
+    ASSERT_FLOAT_EQ(1.0f, std::max(x0, x1));
+}
+
+TEST_F(ContourTest, SimplifyKeepsDeviations) {
+    // a zigzag with an amplitude of 0.1 survives smaller tolerances and collapses for larger ones
+    std::vector<float> points;
+    for (int i = 0; i <= 10; ++i) {
+        points.insert(end(points), {static_cast<float>(i), (i % 2) * 0.1f, 0.0f});
+    }
+    auto segments = createSegments(points, false);
+    Contour contour(*segments);
+    ASSERT_EQ(11u, contour.lines(0.05f)->info.numberVertices);
+    ASSERT_EQ(2u, contour.lines(0.5f)->info.numberVertices);
+}
+
+TEST_F(ContourTest, SmallLoopVanishes) {
+    auto segments = createSegments({0, 0, 0, 0.01f, 0, 0, 0.01f, 0.01f, 0, 0, 0.01f, 0}, true);
+    Contour contour(*segments);
+    ASSERT_EQ(8u, contour.lines(0.0f)->info.numberIndices);
+    ASSERT_EQ(0u, contour.lines(1.0f)->info.numberIndices);
+}
@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+
+#include "src/duality/DepthSorter.h"
+
+#include <random>
+
+using namespace ::testing;
+
+class DepthSorterTest : public Test {
+protected:
+    DepthSorterTest() {}
+
+    virtual ~DepthSorterTest() {}
+
+    std::vector<IVDA::Vec3f> randomPoints(size_t count) {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+        std::vector<IVDA::Vec3f> points(count);
+        for (auto& p : points) {
+            p = IVDA::Vec3f(coordinate(random), coordinate(random), coordinate(random));
+        }
+        return points;
+    }
+
+    void assertBackToFront(const std::vector<uint32_t>& order, const std::vector<IVDA::Vec3f>& points, const IVDA::Vec3f& refPoint) {
+        ASSERT_EQ(points.size(), order.size());
+        std::vector<bool> seen(points.size(), false);
+        for (size_t i = 0; i < order.size(); ++i) {
+            ASSERT_LT(order[i], points.size());
+            ASSERT_FALSE(seen[order[i]]);
+            seen[order[i]] = true;
+            if (i > 0) {
+                ASSERT_GE((points[order[i - 1]] - refPoint).sqLength(), (points[order[i]] - refPoint).sqLength());
+            }
+        }
+    }
+};
+
+TEST_F(DepthSorterTest, SmallSet) {
+    std::vector<IVDA::Vec3f> points{IVDA::Vec3f(1, 0, 0), IVDA::Vec3f(3, 0, 0), IVDA::Vec3f(0, 2, 0), IVDA::Vec3f(0, 0, -4)};
+    DepthSorter sorter;
+    const auto& order = sorter.backToFront(points, IVDA::Vec3f(0, 0, 0));
+    ASSERT_EQ((std::vector<uint32_t>{3, 1, 2, 0}), order);
+}
+
+TEST_F(DepthSorterTest, MovingReference) {
+    const auto points = randomPoints(20000);
+    DepthSorter sorter;
+    // small steps take the incremental path, the jump at the end a full sort
+    for (int step = 0; step < 10; ++step) {
+        const IVDA::Vec3f refPoint(50.0f, 0.1f * step, 0.0f);
+        assertBackToFront(sorter.backToFront(points, refPoint), points, refPoint);
+    }
+    const IVDA::Vec3f refPoint(-50.0f, 20.0f, 30.0f);
+    assertBackToFront(sorter.backToFront(points, refPoint), points, refPoint);
+}
+
+TEST_F(DepthSorterTest, InitialOrder) {
+    const auto points = randomPoints(1000);
+    std::vector<uint32_t> reversed(points.size());
+    for (size_t i = 0; i < reversed.size(); ++i) {
+        reversed[i] = static_cast<uint32_t>(reversed.size() - 1 - i);
+    }
+    DepthSorter sorter;
+    sorter.setInitialOrder(reversed);
+    const IVDA::Vec3f refPoint(0.0f, 0.0f, 25.0f);
+    assertBackToFront(sorter.backToFront(points, refPoint), points, refPoint);
+}
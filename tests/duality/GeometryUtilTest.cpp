@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+
+#include "src/duality/GeometryUtil.h"
+
+#include <array>
+
+using namespace ::testing;
+
+class GeometryUtilTest : public Test {
+protected:
+    using Segment = std::array<float, 6>;
+
+    GeometryUtilTest() {}
+
+    virtual ~GeometryUtilTest() {}
+
+    // copies of a mesh of five triangles without colors, each shifted by 8 along y, cut by the plane x = 0: a triangle whose edges
+    // cross the plane, one with a vertex on the plane and an edge crossing it, one in the plane, one touching it in a single vertex and
+    // one with an edge in the plane
+    std::unique_ptr<G3D::GeometrySoA> createMesh(uint32_t copies) {
+        const float vertices[] = {-1, 0, 0, 1, 0, 0, 1, 2, 0, 0, 1, 1, 0, 3, 0, 0, 3, 2, 0, 5, 0, 1, 4, 0};
+        const uint32_t triangles[] = {0, 1, 2, 0, 1, 3, 4, 5, 6, 1, 2, 4, 6, 7, 4};
+        std::vector<float> positions;
+        auto geometry = std::make_unique<G3D::GeometrySoA>();
+        for (uint32_t copy = 0; copy < copies; ++copy) {
+            for (size_t i = 0; i < 8; ++i) {
+                positions.insert(end(positions), {vertices[3 * i], vertices[3 * i + 1] + 8.0f * copy, vertices[3 * i + 2]});
+            }
+            for (uint32_t index : triangles) {
+                geometry->indices.push_back(index + 8 * copy);
+            }
+        }
+        geometry->info.primitiveType = G3D::Triangle;
+        geometry->info.numberPrimitives = 5 * copies;
+        geometry->info.numberIndices = 15 * copies;
+        geometry->info.numberVertices = 8 * copies;
+        geometry->vertexAttributes.push_back(std::move(positions));
+        geometry->positions = geometry->vertexAttributes.back().data();
+        return geometry;
+    }
+
+    std::vector<Segment> segments(const G3D::GeometrySoA& lines) {
+        std::vector<Segment> result;
+        for (uint32_t i = 0; i + 1 < lines.info.numberIndices; i += 2) {
+            const float* a = lines.positions + 3 * lines.indices[i];
+            const float* b = lines.positions + 3 * lines.indices[i + 1];
+            result.push_back({{a[0], a[1], a[2], b[0], b[1], b[2]}});
+        }
+        return result;
+    }
+};
+
+TEST_F(GeometryUtilTest, ClipSegmentsInTriangleOrder) {
+    auto mesh = createMesh(1);
+    auto lines = GeometryUtil::clipGeometry(*mesh, X_Axis, 0.0f);
+
+    // points on the plane are emitted once per triangle, vertices before edge points
+    const std::vector<Segment> expected = {
+        {{0, 0, 0, 0, 1, 0}}, {{0, 1, 1, 0, 0, 0}}, {{0, 3, 0, 0, 3, 2}}, {{0, 3, 2, 0, 5, 0}}, {{0, 3, 0, 0, 5, 0}}, {{0, 5, 0, 0, 3, 0}},
+    };
+    ASSERT_EQ(expected, segments(*lines));
+    ASSERT_EQ(9u, lines->info.numberVertices);
+    for (uint32_t i = 0; i < 4 * lines->info.numberVertices; ++i) {
+        ASSERT_EQ(1.0f, lines->colors[i]);
+    }
+}
+
+TEST_F(GeometryUtilTest, ThreadedClipMatchesSingleTask) {
+    auto single = segments(*GeometryUtil::clipGeometry(*createMesh(1), X_Axis, 0.0f));
+
+    // several tasks, with copies split between them
+    const uint32_t copies = 10000;
+    auto lines = GeometryUtil::clipGeometry(*createMesh(copies), X_Axis, 0.0f);
+    std::vector<Segment> expected;
+    for (uint32_t copy = 0; copy < copies; ++copy) {
+        for (Segment segment : single) {
+            segment[1] += 8.0f * copy;
+            segment[4] += 8.0f * copy;
+            expected.push_back(segment);
+        }
+    }
+    ASSERT_EQ(expected, segments(*lines));
+}
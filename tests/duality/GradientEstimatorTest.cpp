@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+
+#include "src/duality/GradientEstimator.h"
+
+#include <cmath>
+#include <functional>
+
+using namespace ::testing;
+
+class GradientEstimatorTest : public Test {
+protected:
+    GradientEstimatorTest() {}
+
+    virtual ~GradientEstimatorTest() {}
+
+    I3M::Volume createVolume(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ,
+                             const std::function<uint8_t(uint32_t, uint32_t, uint32_t)>& scalar) {
+        I3M::Volume volume;
+        volume.info.size = IVDA::Vec3ui(sizeX, sizeY, sizeZ);
+        volume.info.scale = IVDA::Vec3f(1.0f, 0.7f, 1.3f);
+        for (uint32_t z = 0; z < sizeZ; ++z) {
+            for (uint32_t y = 0; y < sizeY; ++y) {
+                for (uint32_t x = 0; x < sizeX; ++x) {
+                    volume.voxels.push_back({{0, 0, 0, scalar(x, y, z)}});
+                }
+            }
+        }
+        return volume;
+    }
+
+    // a ball of radius 9 whose values decrease towards its surface
+    I3M::Volume createBall() {
+        return createVolume(37, 29, 23, [](uint32_t x, uint32_t y, uint32_t z) {
+            const float r = std::sqrt((x - 15.0f) * (x - 15.0f) + (y - 14.0f) * (y - 14.0f) + (z - 12.0f) * (z - 12.0f));
+            return static_cast<uint8_t>(r < 9.0f ? 250.0f - 20.0f * r : 0.0f);
+        });
+    }
+};
+
+TEST_F(GradientEstimatorTest, Ramp) {
+    auto volume = createVolume(16, 8, 8, [](uint32_t x, uint32_t, uint32_t) { return static_cast<uint8_t>(10 * x); });
+    ASSERT_FALSE(GradientEstimator::hasGradients(volume));
+    GradientEstimator::computeGradients(volume);
+    ASSERT_TRUE(GradientEstimator::hasGradients(volume));
+    for (size_t i = 0; i < volume.voxels.size(); ++i) {
+        ASSERT_EQ((std::array<uint8_t, 4>{{255, 128, 128, volume.voxels[i][3]}}), volume.voxels[i]) << i;
+    }
+}
+
+TEST_F(GradientEstimatorTest, EmptyRegionsStayZero) {
+    auto volume = createBall();
+    GradientEstimator::computeGradients(volume);
+    const auto& size = volume.info.size;
+    for (uint32_t z = 0; z < size.z; ++z) {
+        for (uint32_t y = 0; y < size.y; ++y) {
+            for (uint32_t x = 0; x < size.x; ++x) {
+                const auto& voxel = volume.voxels[(z * size.y + y) * size.x + x];
+                const float r = std::sqrt((x - 15.0f) * (x - 15.0f) + (y - 14.0f) * (y - 14.0f) + (z - 12.0f) * (z - 12.0f));
+                if (r > 11.0f) {
+                    ASSERT_EQ((std::array<uint8_t, 4>{{0, 0, 0, 0}}), voxel);
+                } else if (r > 2.0f && r < 8.0f) {
+                    // the gradient points to the center
+                    const float dot =
+                        (voxel[0] - 128.0f) * (x - 15.0f) + (voxel[1] - 128.0f) * (y - 14.0f) + (voxel[2] - 128.0f) * (z - 12.0f);
+                    ASSERT_LT(dot, 0.0f);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(GradientEstimatorTest, SliceGradientsMatchVolume) {
+    const auto volume = createBall();
+    auto reference = volume;
+    GradientEstimator::computeGradients(reference);
+
+    for (auto axis : {X_Axis, Y_Axis, Z_Axis}) {
+        const auto sliceSize = SliceStackBuilder::sliceSize(volume.info, axis);
+        std::vector<SliceStackBuilder::Texel> texels(sliceSize.x * sliceSize.y);
+        std::vector<SliceStackBuilder::Texel> expected(sliceSize.x * sliceSize.y);
+        for (size_t slice = 0; slice < SliceStackBuilder::numSlices(volume.info, axis); ++slice) {
+            SliceStackBuilder::Texel* target = texels.data();
+            SliceStackBuilder::extractSlices(volume, axis, slice, slice + 1, &target);
+            GradientEstimator::computeSliceGradients(volume, axis, slice, target);
+            SliceStackBuilder::Texel* expectedTarget = expected.data();
+            SliceStackBuilder::extractSlices(reference, axis, slice, slice + 1, &expectedTarget);
+            ASSERT_EQ(expected, texels) << "axis " << axis << ", slice " << slice;
+        }
+    }
+}
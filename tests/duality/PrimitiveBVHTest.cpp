@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+
+#include "src/duality/PrimitiveBVH.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace ::testing;
+
+class PrimitiveBVHTest : public Test {
+protected:
+    PrimitiveBVHTest() {}
+
+    virtual ~PrimitiveBVHTest() {}
+
+    // n x n unit squares of two triangles each in the plane z = depth
+    std::unique_ptr<G3D::GeometrySoA> createGrid(uint32_t n, float depth) {
+        std::vector<uint32_t> indices;
+        std::vector<float> positions;
+        for (uint32_t y = 0; y <= n; ++y) {
+            for (uint32_t x = 0; x <= n; ++x) {
+                positions.insert(end(positions), {static_cast<float>(x), static_cast<float>(y), depth});
+            }
+        }
+        for (uint32_t y = 0; y < n; ++y) {
+            for (uint32_t x = 0; x < n; ++x) {
+                const uint32_t v = y * (n + 1) + x;
+                indices.insert(end(indices), {v, v + 1, v + n + 2, v, v + n + 2, v + n + 1});
+            }
+        }
+        auto geometry = std::make_unique<G3D::GeometrySoA>();
+        geometry->info.primitiveType = G3D::Triangle;
+        geometry->info.numberPrimitives = static_cast<uint32_t>(indices.size() / 3);
+        geometry->info.numberIndices = static_cast<uint32_t>(indices.size());
+        geometry->info.numberVertices = static_cast<uint32_t>(positions.size() / 3);
+        geometry->indices = std::move(indices);
+        geometry->vertexAttributes.push_back(std::move(positions));
+        geometry->positions = geometry->vertexAttributes.back().data();
+        return geometry;
+    }
+};
+
+TEST_F(PrimitiveBVHTest, Build) {
+    auto geometry = createGrid(16, 0.0f);
+    PrimitiveBVH bvh;
+    ASSERT_TRUE(bvh.empty());
+    bvh.build(*geometry, 3);
+    ASSERT_FALSE(bvh.empty());
+
+    auto primitives = bvh.primitives();
+    std::sort(begin(primitives), end(primitives));
+    ASSERT_EQ(geometry->info.numberPrimitives, primitives.size());
+    for (uint32_t i = 0; i < primitives.size(); ++i) {
+        ASSERT_EQ(i, primitives[i]);
+    }
+
+    bvh.clear();
+    ASSERT_TRUE(bvh.empty());
+}
+
+TEST_F(PrimitiveBVHTest, IntersectRay) {
+    auto geometry = createGrid(16, 2.0f);
+    PrimitiveBVH bvh;
+    bvh.build(*geometry, 3);
+
+    float t;
+    uint32_t primitive;
+    // the lower right triangle of the square (3, 5)
+    ASSERT_TRUE(bvh.intersectRay(*geometry, IVDA::Vec3f(3.75f, 5.25f, -1.0f), IVDA::Vec3f(0.0f, 0.0f, 1.0f), t, primitive));
+    ASSERT_FLOAT_EQ(3.0f, t);
+    ASSERT_EQ(2u * (5 * 16 + 3), primitive);
+
+    ASSERT_FALSE(bvh.intersectRay(*geometry, IVDA::Vec3f(3.75f, 5.25f, -1.0f), IVDA::Vec3f(0.0f, 0.0f, -1.0f), t, primitive));
+    ASSERT_FALSE(bvh.intersectRay(*geometry, IVDA::Vec3f(20.0f, 5.25f, -1.0f), IVDA::Vec3f(0.0f, 0.0f, 1.0f), t, primitive));
+}
+
+TEST_F(PrimitiveBVHTest, VisitCrossing) {
+    auto geometry = createGrid(32, 0.0f);
+    PrimitiveBVH bvh;
+    bvh.build(*geometry, 3);
+
+    // the plane x = 10.5 crosses both triangles of the squares (10, y)
+    std::set<uint32_t> visited;
+    bvh.visitCrossing(IVDA::Vec4f(1.0f, 0.0f, 0.0f, -10.5f), [&](uint32_t primitive) {
+        visited.insert(primitive);
+        return false;
+    });
+    for (uint32_t y = 0; y < 32; ++y) {
+        ASSERT_EQ(1u, visited.count(2 * (y * 32 + 10)));
+        ASSERT_EQ(1u, visited.count(2 * (y * 32 + 10) + 1));
+    }
+    ASSERT_LT(visited.size(), geometry->info.numberPrimitives / 2);
+
+    // the visit stops when the visitor returns true
+    size_t count = 0;
+    ASSERT_TRUE(bvh.visitCrossing(IVDA::Vec4f(1.0f, 0.0f, 0.0f, -10.5f), [&](uint32_t) { return ++count == 3; }));
+    ASSERT_EQ(3u, count);
+}
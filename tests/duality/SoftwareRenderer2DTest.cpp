@@ -0,0 +1,111 @@
+#include "gtest/gtest.h"
+
+#include "DataProviderMock.h"
+#include "src/duality/SoftwareRenderer2D.h"
+
+#include <string>
+
+using namespace ::testing;
+
+class SoftwareRenderer2DTest : public Test {
+protected:
+    SoftwareRenderer2DTest() {}
+
+    virtual ~SoftwareRenderer2DTest() {}
+
+    // I3M volume of 4 x 4 x 2 voxels that all have the same scalar value
+    std::unique_ptr<VolumeDataset> createConstantVolume(uint8_t value) {
+        auto data = std::make_shared<std::vector<uint8_t>>();
+        auto append = [&](const void* bytes, size_t size) {
+            const uint8_t* begin = reinterpret_cast<const uint8_t*>(bytes);
+            data->insert(end(*data), begin, begin + size);
+        };
+        const uint32_t header[] = {69426942, 1, 4, 4, 2};
+        const float scale[] = {1.0f, 1.0f, 1.0f};
+        append(header, sizeof(header));
+        append(scale, sizeof(scale));
+        for (int i = 0; i < 4 * 4 * 2; ++i) {
+            const uint8_t voxel[] = {128, 128, 128, value};
+            append(voxel, sizeof(voxel));
+        }
+        auto provider = std::make_unique<NiceMock<DataProviderMock>>();
+        EXPECT_CALL(*provider, fetch()).WillOnce(Return(data));
+        auto dataset = std::make_unique<VolumeDataset>(std::move(provider));
+        dataset->updateDataset();
+        dataset->initializeDataset();
+        return dataset;
+    }
+
+    // transfer function that maps every value to the same color
+    std::unique_ptr<TransferFunction> createConstantTransferFunction(const std::string& color) {
+        std::string text;
+        for (int i = 0; i < 256; ++i) {
+            text += color + "\n";
+        }
+        auto data = std::make_shared<std::vector<uint8_t>>(begin(text), end(text));
+        auto provider = std::make_unique<NiceMock<DataProviderMock>>();
+        EXPECT_CALL(*provider, fetch()).WillOnce(Return(data));
+        auto tf = std::make_unique<TransferFunction>(std::move(provider));
+        tf->update();
+        return tf;
+    }
+
+    const SoftwareRenderer2D::Pixel& pixel(const SoftwareRenderer2D& renderer, uint32_t x, uint32_t y) {
+        return renderer.image()[y * renderer.size().x + x];
+    }
+};
+
+TEST_F(SoftwareRenderer2DTest, Clear) {
+    SoftwareRenderer2D renderer(IVDA::Vec2ui(5, 3), std::make_shared<Settings>());
+    renderer.clear({{1.0f, 0.5f, 0.0f}});
+    ASSERT_EQ(15u, renderer.image().size());
+    for (const auto& p : renderer.image()) {
+        ASSERT_EQ((SoftwareRenderer2D::Pixel{{255, 128, 0, 255}}), p);
+    }
+}
+
+TEST_F(SoftwareRenderer2DTest, SliceCoversProjectedQuad) {
+    auto dataset = createConstantVolume(200);
+    auto tf = createConstantTransferFunction("0.4 0.2 0.0 0.4");
+    SoftwareRenderer2D renderer(IVDA::Vec2ui(16, 16), std::make_shared<Settings>());
+    renderer.clear({{0.0f, 0.0f, 0.0f}});
+
+    // the slice quad spans [-0.5, 0.5], i.e. the pixels 4 to 11 with the identity transform
+    renderer.renderSlice(*dataset, GLMatrix(), *tf, Z_Axis, 0);
+
+    // (102, 51, 0, 102) / 255 blended onto opaque black
+    const SoftwareRenderer2D::Pixel slice{{41, 20, 0, 194}};
+    const SoftwareRenderer2D::Pixel background{{0, 0, 0, 255}};
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t x = 0; x < 16; ++x) {
+            const bool inside = x >= 4 && x < 12 && y >= 4 && y < 12;
+            ASSERT_EQ(inside ? slice : background, pixel(renderer, x, y)) << x << ", " << y;
+        }
+    }
+}
+
+TEST_F(SoftwareRenderer2DTest, LineOverSlice) {
+    auto dataset = createConstantVolume(200);
+    auto tf = createConstantTransferFunction("0.4 0.2 0.0 0.4");
+    SoftwareRenderer2D renderer(IVDA::Vec2ui(16, 16), std::make_shared<Settings>());
+    renderer.clear({{0.0f, 0.0f, 0.0f}});
+
+    GLMatrix mvp;
+    mvp.scale(2.0f, 2.0f, 1.0f);
+    renderer.renderSlice(*dataset, mvp, *tf, Z_Axis, 0);
+    // horizontal line through the center of the image, two pixels wide
+    auto line = G3D::createLineGeometry({0, 1}, {-0.25f, 0.0f, 0.0f, 0.25f, 0.0f, 0.0f}, {1, 1, 1, 1, 1, 1, 1, 1});
+    renderer.renderLines(*line, mvp, 2.0f);
+
+    const SoftwareRenderer2D::Pixel slice{{41, 20, 0, 194}};
+    const SoftwareRenderer2D::Pixel white{{255, 255, 255, 255}};
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t x = 0; x < 16; ++x) {
+            const bool onLine = (y == 7 || y == 8) && x >= 4 && x < 12;
+            const bool nearLine = (y == 7 || y == 8) && (x == 3 || x == 12);
+            if (!nearLine) {
+                ASSERT_EQ(onLine ? white : slice, pixel(renderer, x, y)) << x << ", " << y;
+            }
+        }
+    }
+}
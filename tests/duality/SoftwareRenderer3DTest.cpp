@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+
+#include "DataProviderMock.h"
+#include "src/duality/GeometryNode.h"
+#include "src/duality/MVP3D.h"
+#include "src/duality/SoftwareRenderer3D.h"
+#include "src/duality/VolumeNode.h"
+
+#include <functional>
+#include <string>
+
+using namespace ::testing;
+
+namespace {
+// black volumes and colored surfaces are told apart from the background
+class WhiteBackgroundSettings : public Settings {
+public:
+    std::array<float, 3> backgroundColor() const override { return {{1.0f, 1.0f, 1.0f}}; }
+};
+}
+
+class SoftwareRenderer3DTest : public Test {
+protected:
+    SoftwareRenderer3DTest() {}
+
+    virtual ~SoftwareRenderer3DTest() {}
+
+    // I3M volume with unit scale, i.e. the cube [-0.5, 0.5]^3, with the scalars depending on z only
+    std::shared_ptr<VolumeDataset> createVolume(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ,
+                                                const std::function<uint8_t(uint32_t)>& scalar) {
+        auto data = std::make_shared<std::vector<uint8_t>>();
+        auto append = [&](const void* bytes, size_t size) {
+            const uint8_t* begin = reinterpret_cast<const uint8_t*>(bytes);
+            data->insert(end(*data), begin, begin + size);
+        };
+        const uint32_t header[] = {69426942, 1, sizeX, sizeY, sizeZ};
+        const float scale[] = {1.0f, 1.0f, 1.0f};
+        append(header, sizeof(header));
+        append(scale, sizeof(scale));
+        for (uint32_t z = 0; z < sizeZ; ++z) {
+            for (uint32_t i = 0; i < sizeX * sizeY; ++i) {
+                const uint8_t voxel[] = {128, 128, 128, scalar(z)};
+                append(voxel, sizeof(voxel));
+            }
+        }
+        auto provider = std::make_unique<NiceMock<DataProviderMock>>();
+        EXPECT_CALL(*provider, fetch()).WillOnce(Return(data));
+        auto dataset = std::make_shared<VolumeDataset>(std::move(provider));
+        dataset->updateDataset();
+        dataset->initializeDataset();
+        return dataset;
+    }
+
+    // transfer function that maps the values below 128 to the first color and the others to the second
+    std::shared_ptr<TransferFunction> createTransferFunction(const std::string& low, const std::string& high) {
+        std::string text;
+        for (int i = 0; i < 256; ++i) {
+            text += (i < 128 ? low : high) + "\n";
+        }
+        auto data = std::make_shared<std::vector<uint8_t>>(begin(text), end(text));
+        auto provider = std::make_unique<NiceMock<DataProviderMock>>();
+        EXPECT_CALL(*provider, fetch()).WillOnce(Return(data));
+        auto tf = std::make_shared<TransferFunction>(std::move(provider));
+        tf->update();
+        return tf;
+    }
+
+    // a single triangle with positions and colors in G3D format
+    std::shared_ptr<GeometryDataset> createTriangle(const std::vector<float>& positions, const std::vector<float>& colors) {
+        auto data = std::make_shared<std::vector<uint8_t>>();
+        auto append = [&](const void* bytes, size_t size) {
+            const uint8_t* begin = reinterpret_cast<const uint8_t*>(bytes);
+            data->insert(end(*data), begin, begin + size);
+        };
+        const bool isOpaque = true;
+        const uint32_t header[] = {1, G3D::Triangle, 2, 3, sizeof(uint32_t), 3, 7 * sizeof(float), G3D::SoA};
+        const uint32_t semantics[] = {static_cast<uint32_t>(G3D::AttributeSemantic::Position),
+                                      static_cast<uint32_t>(G3D::AttributeSemantic::Color)};
+        const uint32_t indices[] = {0, 1, 2};
+        append(&isOpaque, sizeof(isOpaque));
+        append(header, sizeof(header));
+        append(semantics, sizeof(semantics));
+        append(indices, sizeof(indices));
+        append(positions.data(), positions.size() * sizeof(float));
+        append(colors.data(), colors.size() * sizeof(float));
+        auto provider = std::make_unique<NiceMock<DataProviderMock>>();
+        EXPECT_CALL(*provider, fetch()).WillOnce(Return(data));
+        auto dataset = std::make_shared<GeometryDataset>(std::move(provider));
+        dataset->updateDataset();
+        dataset->initializeDataset();
+        return dataset;
+    }
+
+    // the unit cube 3 units in front of the eye with a vertical field of view of 45 degrees; in a 16 x 16 image its front face covers
+    // the pixels 4 to 11, the plane z = 0 the pixels 5 to 10
+    MVP3D createMVP() {
+        const BoundingBox unitCube{IVDA::Vec3f(-0.5f, -0.5f, -0.5f), IVDA::Vec3f(0.5f, 0.5f, 0.5f)};
+        return MVP3D(ScreenInfo(16, 16, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f), unitCube,
+                     RenderParameters3D(IVDA::Vec3f(0.0f, 0.0f, -3.0f), IVDA::Mat4f()));
+    }
+
+    const SoftwareRenderer3D::Pixel& pixel(const SoftwareRenderer3D& renderer, uint32_t x, uint32_t y) {
+        return renderer.image()[y * renderer.size().x + x];
+    }
+};
+
+TEST_F(SoftwareRenderer3DTest, OpaqueVolume) {
+    std::vector<std::unique_ptr<SceneNode>> nodes;
+    nodes.push_back(std::make_unique<VolumeNode>("volume", Visibility::VisibleBoth, createVolume(4, 4, 2, [](uint32_t) { return 200; }),
+                                                 createTransferFunction("0 0 0 1", "0 0 0 1")));
+    SoftwareRenderer3D renderer(IVDA::Vec2ui(16, 16), std::make_shared<WhiteBackgroundSettings>());
+    renderer.render(nodes, createMVP());
+
+    const SoftwareRenderer3D::Pixel black{{0, 0, 0, 255}};
+    const SoftwareRenderer3D::Pixel white{{255, 255, 255, 255}};
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t x = 0; x < 16; ++x) {
+            const bool inside = x >= 4 && x < 12 && y >= 4 && y < 12;
+            ASSERT_EQ(inside ? black : white, pixel(renderer, x, y)) << x << ", " << y;
+        }
+    }
+}
+
+TEST_F(SoftwareRenderer3DTest, OpaqueTriangleInFrontOfVolume) {
+    std::vector<std::unique_ptr<SceneNode>> nodes;
+    nodes.push_back(std::make_unique<VolumeNode>("volume", Visibility::VisibleBoth, createVolume(4, 4, 2, [](uint32_t) { return 200; }),
+                                                 createTransferFunction("0 0 0 1", "0 0 0 1")));
+    // covers the left half of the image, without normals it is not lit
+    auto triangle = createTriangle({-20.0f, -20.0f, 0.75f, 0.0f, -20.0f, 0.75f, 0.0f, 20.0f, 0.75f},
+                                   {0.2f, 0.4f, 0.6f, 1.0f, 0.2f, 0.4f, 0.6f, 1.0f, 0.2f, 0.4f, 0.6f, 1.0f});
+    nodes.push_back(std::make_unique<GeometryNode>("triangle", Visibility::VisibleBoth, triangle));
+    SoftwareRenderer3D renderer(IVDA::Vec2ui(16, 16), std::make_shared<WhiteBackgroundSettings>());
+    renderer.render(nodes, createMVP());
+
+    // the rays stop at the triangle, nothing behind it shows through
+    const SoftwareRenderer3D::Pixel surface{{51, 102, 153, 255}};
+    const SoftwareRenderer3D::Pixel black{{0, 0, 0, 255}};
+    const SoftwareRenderer3D::Pixel white{{255, 255, 255, 255}};
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t x = 0; x < 16; ++x) {
+            const bool inside = x >= 4 && x < 12 && y >= 4 && y < 12;
+            ASSERT_EQ(x < 8 ? surface : (inside ? black : white), pixel(renderer, x, y)) << x << ", " << y;
+        }
+    }
+}
+
+TEST_F(SoftwareRenderer3DTest, InvisibleBlockIsSkipped) {
+    // two blocks along z: the front one is transparent under the transfer function, the back one is opaque
+    std::vector<std::unique_ptr<SceneNode>> nodes;
+    nodes.push_back(std::make_unique<VolumeNode>("volume", Visibility::VisibleBoth,
+                                                 createVolume(8, 8, 16, [](uint32_t z) { return z < 8 ? 200 : 0; }),
+                                                 createTransferFunction("0 0 0 0", "0 0 0 1")));
+    SoftwareRenderer3D renderer(IVDA::Vec2ui(16, 16), std::make_shared<WhiteBackgroundSettings>());
+    renderer.render(nodes, createMVP());
+
+    // only the rays that reach the back half are black; the outer rays leave the volume through the sides of the front half
+    const SoftwareRenderer3D::Pixel black{{0, 0, 0, 255}};
+    const SoftwareRenderer3D::Pixel white{{255, 255, 255, 255}};
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t x = 0; x < 16; ++x) {
+            const bool behindFrontHalf = x >= 5 && x < 11 && y >= 5 && y < 11;
+            ASSERT_EQ(behindFrontHalf ? black : white, pixel(renderer, x, y)) << x << ", " << y;
+        }
+    }
+}
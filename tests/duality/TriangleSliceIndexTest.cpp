@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+
+#include "src/duality/TriangleSliceIndex.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace ::testing;
+
+class TriangleSliceIndexTest : public Test {
+protected:
+    TriangleSliceIndexTest() {}
+
+    virtual ~TriangleSliceIndexTest() {}
+
+    // small random triangles in the unit cube; every tenth triangle is stretched along z through the whole cube
+    std::unique_ptr<G3D::GeometrySoA> createTriangles(uint32_t count) {
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        std::vector<float> positions(9 * count);
+        for (uint32_t t = 0; t < count; ++t) {
+            const float cx = uniform(random);
+            const float cy = uniform(random);
+            const float cz = uniform(random);
+            const float length = (t % 10 == 0) ? 1.0f : 0.002f;
+            for (int v = 0; v < 3; ++v) {
+                positions[9 * t + 3 * v] = cx + (uniform(random) - 0.5f) * 0.01f;
+                positions[9 * t + 3 * v + 1] = cy + (uniform(random) - 0.5f) * 0.01f;
+                positions[9 * t + 3 * v + 2] = cz + (uniform(random) - 0.5f) * length;
+            }
+        }
+        auto geometry = std::make_unique<G3D::GeometrySoA>();
+        geometry->info.primitiveType = G3D::Triangle;
+        geometry->info.numberPrimitives = count;
+        geometry->info.numberIndices = 3 * count;
+        geometry->info.numberVertices = 3 * count;
+        geometry->indices.resize(3 * count);
+        for (uint32_t i = 0; i < 3 * count; ++i) {
+            geometry->indices[i] = i;
+        }
+        geometry->vertexAttributes.push_back(std::move(positions));
+        geometry->positions = geometry->vertexAttributes.back().data();
+        return geometry;
+    }
+};
+
+TEST_F(TriangleSliceIndexTest, CandidatesContainCrossingTriangles) {
+    const uint32_t count = 20000;
+    auto geometry = createTriangles(count);
+    TriangleSliceIndex index(*geometry, Z_Axis);
+
+    std::vector<uint32_t> candidates;
+    for (float depth : {-0.1f, 0.0f, 0.13f, 0.5f, 0.77f, 1.0f, 1.1f}) {
+        index.candidates(depth, candidates);
+        ASSERT_TRUE(std::is_sorted(begin(candidates), end(candidates)));
+        ASSERT_TRUE(std::adjacent_find(begin(candidates), end(candidates)) == end(candidates));
+        for (uint32_t t = 0; t < count; ++t) {
+            const float* p = geometry->positions + 9 * t;
+            const float minZ = std::min({p[2], p[5], p[8]});
+            const float maxZ = std::max({p[2], p[5], p[8]});
+            if (minZ <= depth && depth <= maxZ) {
+                ASSERT_TRUE(std::binary_search(begin(candidates), end(candidates), t)) << t << " at " << depth;
+            }
+        }
+        // the index has to prune most of the small triangles
+        ASSERT_LT(candidates.size(), count / 4);
+    }
+}
+
+TEST_F(TriangleSliceIndexTest, OtherAxes) {
+    const uint32_t count = 1000;
+    auto geometry = createTriangles(count);
+    for (auto axis : {X_Axis, Y_Axis}) {
+        TriangleSliceIndex index(*geometry, axis);
+        std::vector<uint32_t> candidates;
+        index.candidates(0.5f, candidates);
+        for (uint32_t t = 0; t < count; ++t) {
+            const float* p = geometry->positions + 9 * t + axis;
+            if (std::min({p[0], p[3], p[6]}) <= 0.5f && 0.5f <= std::max({p[0], p[3], p[6]})) {
+                ASSERT_TRUE(std::binary_search(begin(candidates), end(candidates), t));
+            }
+        }
+    }
+}
+
+TEST_F(TriangleSliceIndexTest, Empty) {
+    auto geometry = createTriangles(0);
+    TriangleSliceIndex index(*geometry, Z_Axis);
+    std::vector<uint32_t> candidates{1, 2, 3};
+    index.candidates(0.5f, candidates);
+    ASSERT_TRUE(candidates.empty());
+}
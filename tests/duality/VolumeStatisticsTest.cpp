@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+
+#include "duality/Error.h"
+#include "src/duality/VolumeStatistics.h"
+
+using namespace ::testing;
+
+class VolumeStatisticsTest : public Test {
+protected:
+    VolumeStatisticsTest() {}
+
+    virtual ~VolumeStatisticsTest() {}
+
+    // gradient channels (x, 128, 128), scalar (x + y + z) % 256
+    I3M::Volume createVolume(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ) {
+        I3M::Volume volume;
+        volume.info.size = IVDA::Vec3ui(sizeX, sizeY, sizeZ);
+        volume.info.scale = IVDA::Vec3f(1.0f, 1.0f, 1.0f);
+        for (uint32_t z = 0; z < sizeZ; ++z) {
+            for (uint32_t y = 0; y < sizeY; ++y) {
+                for (uint32_t x = 0; x < sizeX; ++x) {
+                    volume.voxels.push_back({{static_cast<uint8_t>(x), 128, 128, static_cast<uint8_t>((x + y + z) % 256)}});
+                }
+            }
+        }
+        return volume;
+    }
+};
+
+TEST_F(VolumeStatisticsTest, Histograms) {
+    const auto volume = createVolume(100, 90, 80);
+    const auto statistics = VolumeStatistics::compute(volume, VolumeStatistics::Options(true, true));
+    ASSERT_EQ(volume.voxels.size(), statistics.numVoxels());
+
+    std::array<VolumeStatistics::Histogram, VolumeStatistics::numChannels> expected{};
+    for (const auto& voxel : volume.voxels) {
+        for (size_t c = 0; c < VolumeStatistics::numChannels; ++c) {
+            ++expected[c][voxel[c]];
+        }
+    }
+    for (size_t c = 0; c < VolumeStatistics::numChannels; ++c) {
+        ASSERT_EQ(expected[c], statistics.histogram(c));
+    }
+
+    const auto gradient = statistics.summary(0);
+    ASSERT_EQ(0, gradient.min);
+    ASSERT_EQ(99, gradient.max);
+    ASSERT_DOUBLE_EQ(49.5, gradient.mean);
+    const auto constant = statistics.summary(1);
+    ASSERT_EQ(128, constant.min);
+    ASSERT_EQ(128, constant.max);
+    ASSERT_DOUBLE_EQ(128.0, constant.mean);
+    const auto scalar = statistics.summary(3);
+    ASSERT_EQ(0, scalar.min);
+    ASSERT_EQ(255, scalar.max);
+}
+
+TEST_F(VolumeStatisticsTest, JointAndGradientHistograms) {
+    const auto volume = createVolume(64, 32, 16);
+    const auto statistics = VolumeStatistics::compute(volume, VolumeStatistics::Options(true, true));
+
+    // channel 0 holds x, which falls into bin x / 4 of the joint histograms, while channel 1 is constant
+    const auto& joint = statistics.jointHistogram(0, 1);
+    ASSERT_EQ(VolumeStatistics::numJointBins * VolumeStatistics::numJointBins, joint.size());
+    for (size_t bin = 0; bin < VolumeStatistics::numJointBins; ++bin) {
+        ASSERT_EQ(bin < 16 ? 4u * 32 * 16 : 0u, joint[bin * VolumeStatistics::numJointBins + 128 / 4]);
+    }
+
+    // the rows belong to the scalar values; the gradients have length 128 - x, so only x = 0 reaches the bin of length 128, which is
+    // 255 * 128 / (sqrt(3) * 128) = 147
+    const auto& gradient = statistics.gradientHistogram();
+    uint64_t lengthCount = 0;
+    for (size_t value = 0; value < VolumeStatistics::numBins; ++value) {
+        uint64_t valueCount = 0;
+        for (size_t bin = 0; bin < VolumeStatistics::numBins; ++bin) {
+            valueCount += gradient[value * VolumeStatistics::numBins + bin];
+        }
+        ASSERT_EQ(statistics.histogram(3)[value], valueCount);
+        lengthCount += gradient[value * VolumeStatistics::numBins + 147];
+    }
+    ASSERT_EQ(32u * 16, lengthCount);
+}
+
+TEST_F(VolumeStatisticsTest, Merge) {
+    const auto volume = createVolume(40, 30, 20);
+    const VolumeStatistics::Options options(true, true);
+    const auto expected = VolumeStatistics::compute(volume, options);
+
+    const size_t half = volume.voxels.size() / 2;
+    VolumeStatistics first(options);
+    first.add(volume.voxels.data(), half);
+    VolumeStatistics second(options);
+    second.add(volume.voxels.data() + half, volume.voxels.size() - half);
+    first.merge(second);
+
+    ASSERT_EQ(expected.numVoxels(), first.numVoxels());
+    for (size_t c = 0; c < VolumeStatistics::numChannels; ++c) {
+        ASSERT_EQ(expected.histogram(c), first.histogram(c));
+    }
+    ASSERT_EQ(expected.jointHistogram(1, 3), first.jointHistogram(1, 3));
+    ASSERT_EQ(expected.gradientHistogram(), first.gradientHistogram());
+
+    ASSERT_THROW(first.merge(VolumeStatistics(VolumeStatistics::Options(false, false))), Error);
+}
+
+TEST_F(VolumeStatisticsTest, MissingOptions) {
+    const auto volume = createVolume(4, 4, 4);
+    const auto statistics = VolumeStatistics::compute(volume, VolumeStatistics::Options(false, false));
+    ASSERT_EQ(64u, statistics.numVoxels());
+    ASSERT_THROW(statistics.jointHistogram(0, 3), Error);
+    ASSERT_THROW(statistics.gradientHistogram(), Error);
+}